@@ -0,0 +1,110 @@
+// sam11 host build: just enough of the Arduino core for the firmware to run
+// on Linux or macOS. Serial is the terminal (or a script, see host.cpp), and
+// the serial ports for the DL11 and DH11 lines are ptys (pty.cpp).
+
+#ifndef H_HOST_ARDUINO
+#define H_HOST_ARDUINO
+
+#include <ctype.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define OCT 8
+#define DEC 10
+#define HEX 16
+
+#define HIGH   1
+#define LOW    0
+#define OUTPUT 1
+#define INPUT  0
+
+#define F(x) (x)
+#define EXTMEM
+
+struct String
+{
+    const char* c_str() const { return ""; }
+};
+
+class Stream
+{
+public:
+    int available();
+    int read();
+    int peek() { return -1; }
+    int availableForWrite();
+    size_t write(uint8_t c);
+    size_t write(const uint8_t* b, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+            write(b[i]);
+        return n;
+    }
+    size_t write(const char* b, size_t n) { return write((const uint8_t*)b, n); }
+
+    size_t print(const char* s) { return write(s, strlen(s)); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(long v, int base = DEC)
+    {
+        char s[24];
+        snprintf(s, sizeof(s), base == OCT ? "%lo" : base == HEX ? "%lx" : "%ld", v);
+        return print(s);
+    }
+    size_t print(int v, int base = DEC) { return print((long)v, base); }
+    size_t print(unsigned v, int base = DEC) { return print((long)v, base); }
+    size_t print(unsigned long v, int base = DEC) { return print((long)v, base); }
+    size_t print(double v)
+    {
+        char s[32];
+        snprintf(s, sizeof(s), "%.2f", v);
+        return print(s);
+    }
+    template <class T>
+    size_t println(T v, int base) { return print(v, base) + println(); }
+    template <class T>
+    size_t println(T v) { return print(v) + println(); }
+    size_t println() { return print("\r\n"); }
+    int printf(const char* f, ...)
+    {
+        char s[256];
+        va_list a;
+        va_start(a, f);
+        const int n = vsnprintf(s, sizeof(s), f, a);
+        va_end(a);
+        print(s);
+        return n;
+    }
+
+    void begin(long);
+    void flush();
+    operator bool() { return true; }
+    String readStringUntil(char) { return String(); }
+};
+
+typedef Stream HardwareSerial;
+typedef Stream Uart;
+
+#define HOST_TTYS 32  // serial ports, enough for 16 DL11 lines and the DH11's 16
+
+extern Stream Serial, tty[HOST_TTYS];
+
+// TTY_PORTS in platform.h
+#define HOST_TTY_PORTS                                                              \
+    &tty[0], &tty[1], &tty[2], &tty[3], &tty[4], &tty[5], &tty[6], &tty[7],         \
+    &tty[8], &tty[9], &tty[10], &tty[11], &tty[12], &tty[13], &tty[14], &tty[15],   \
+    &tty[16], &tty[17], &tty[18], &tty[19], &tty[20], &tty[21], &tty[22], &tty[23], \
+    &tty[24], &tty[25], &tty[26], &tty[27], &tty[28], &tty[29], &tty[30], &tty[31]
+
+static inline void pinMode(int, int) { }
+static inline void digitalWrite(int, int) { }
+static inline void delayMicroseconds(unsigned int) { }
+static inline void yield() { }
+void delay(unsigned long ms);
+unsigned long micros();
+unsigned long millis();
+
+#endif
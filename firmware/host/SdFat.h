@@ -0,0 +1,138 @@
+// sam11 host build: SdFat on top of stdio. The "card" is the directory set by
+// host::card(), or named by $SAMDIR, or the current directory. A file that's
+// been share()d is kept in memory from then on, on top of the card (cow.cpp).
+
+#ifndef H_HOST_SDFAT
+#define H_HOST_SDFAT
+
+#include "Arduino.h"
+
+#define O_READ   0x00
+#define O_RDONLY 0x00
+#define O_WRITE  0x01
+#define O_WRONLY 0x01
+#define O_RDWR   0x02
+#define O_CREAT  0x40
+#define O_TRUNC  0x200
+
+#define FIFO_SDIO        0
+#define SD_SCK_MHZ(mhz)  (mhz)
+
+// path of a file on the card
+const char* sdpath(const char* name);
+
+// a file shared by SdFile::share(), and its blocks (cow.cpp)
+struct cow;
+int cowread(cow* c, void* buf, size_t n);
+size_t cowwrite(cow* c, const void* buf, size_t n);
+void cowclose(cow* c);
+bool cowseek(cow* c, uint32_t pos);
+uint32_t cowtell(cow* c);
+uint32_t cowsize(cow* c);
+
+struct SdioConfig
+{
+    SdioConfig(int) { }
+};
+
+class SdFile
+{
+    FILE* f = NULL;
+    cow* c = NULL;  // shared, so the card is only read from, and writes are kept in memory
+
+public:
+    bool open(const char* name, int mode)
+    {
+        const char* p = sdpath(name);
+        f = fopen(p, (mode & O_TRUNC) ? "w+b" : (mode & (O_WRITE | O_RDWR)) ? "r+b" : "rb");
+        if (!f && (mode & O_CREAT))
+            f = fopen(p, "w+b");
+        return f != NULL;
+    }
+    // the n bytes at buf as a file, rather than one on the card
+    bool open(void* buf, size_t n, int mode)
+    {
+        f = fmemopen(buf, n, (mode & (O_WRITE | O_RDWR)) ? "r+b" : "rb");
+        return f != NULL;
+    }
+    bool close()
+    {
+        if (f)
+            fclose(f);
+        if (c)
+            cowclose(c);
+        f = NULL;
+        c = NULL;
+        return true;
+    }
+    bool isOpen() { return f || c; }
+    operator bool() { return f || c; }
+
+    // Make to a copy of this file, sharing its blocks copy-on-write: from now
+    // on neither of them writes to the card, what they write is kept in memory
+    // a block at a time, and a block is copied by the first of them to write
+    // to it while the other still has it. For forks (host.h)
+    bool share(SdFile& to);
+    // how many bytes of blocks this file has to itself since it was shared
+    uint32_t own();
+
+    bool seekSet(uint32_t pos) { return c ? cowseek(c, pos) : fseek(f, pos, SEEK_SET) == 0; }
+    bool seek(uint32_t pos) { return seekSet(pos); }
+    uint32_t curPosition() { return c ? cowtell(c) : ftell(f); }
+    uint32_t fileSize()
+    {
+        if (c)
+            return cowsize(c);
+        const long at = ftell(f);
+        fseek(f, 0, SEEK_END);
+        const long size = ftell(f);
+        fseek(f, at, SEEK_SET);
+        return size;
+    }
+    int available() { return isOpen() && curPosition() < fileSize(); }
+
+    int read()
+    {
+        uint8_t b;
+        if (c)
+            return cowread(c, &b, 1) == 1 ? b : -1;
+        const int ch = fgetc(f);
+        return ch == EOF ? -1 : ch;
+    }
+    int read(void* buf, size_t n) { return c ? cowread(c, buf, n) : fread(buf, 1, n, f); }
+    size_t write(uint8_t b) { return c ? cowwrite(c, &b, 1) : fputc(b, f) == EOF ? 0 : 1; }
+    size_t write(const void* buf, size_t n) { return c ? cowwrite(c, buf, n) : fwrite(buf, 1, n, f); }
+    bool sync() { return c || fflush(f) == 0; }
+    String readStringUntil(char) { return String(); }
+};
+
+typedef SdFile File;
+
+class SdFat
+{
+public:
+    template <class... T>
+    bool begin(T...) { return true; }
+    void initErrorHalt() { }
+    void errorHalt(const char* msg)
+    {
+        fprintf(stderr, "%s\n", msg);
+        exit(1);
+    }
+    bool exists(const char* name)
+    {
+        FILE* f = fopen(sdpath(name), "rb");
+        if (f)
+            fclose(f);
+        return f != NULL;
+    }
+    bool remove(const char* name) { return ::remove(sdpath(name)) == 0; }
+    bool rename(const char* from, const char* to)
+    {
+        char p[512];
+        snprintf(p, sizeof(p), "%s", sdpath(from));
+        return ::rename(p, sdpath(to)) == 0;
+    }
+};
+
+#endif
@@ -0,0 +1,198 @@
+// sam11 host build: files shared copy-on-write by SdFile::share(), e.g. the
+// disk images of a machine and its forks (host.h).
+//
+// Once a file's shared, the copy on the card is only ever read from, with
+// pread() so the machines sharing it don't move each other's position. What
+// each SdFile writes is kept in blocks in memory, on top of the card, and a
+// block is shared in turn when its SdFile is: one that more than one SdFile
+// has is copied by the first of them to write to it. Reads, and writes to a
+// block an SdFile has to itself, never wait for the others.
+
+#include "SdFat.h"
+
+#include <atomic>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#define COW_BLOCK (512)  // bytes in a block, a disk sector
+
+struct block
+{
+    std::atomic<uint32_t> users;
+    uint8_t d[COW_BLOCK];
+};
+
+// the file on the card
+struct base
+{
+    int fd;
+    std::atomic<uint32_t> users;
+};
+
+// one SdFile's view of a shared file
+struct cow
+{
+    base* b;
+    uint32_t at, size;
+    std::vector<block*> blocks;  // NULL for the ones still on the card
+};
+
+static void let_go(block* k)
+{
+    if (k && k->users.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        free(k);
+}
+
+// block n of the file to write to, copying it if it's shared
+static block* own(cow* c, uint32_t n)
+{
+    if (n >= c->blocks.size())
+        c->blocks.resize(n + 1, NULL);
+    block* k = c->blocks[n];
+    if (k && k->users.load(std::memory_order_acquire) == 1)
+        return k;
+
+    block* m = (block*)malloc(sizeof(block));
+    if (!m)
+        return NULL;
+    m->users.store(1, std::memory_order_relaxed);
+    if (k)
+        memcpy(m->d, k->d, COW_BLOCK);
+    else
+    {
+        memset(m->d, 0, COW_BLOCK);  // past the end of the card's copy
+        if (pread(c->b->fd, m->d, COW_BLOCK, (off_t)n * COW_BLOCK) < 0)
+        {
+            free(m);
+            return NULL;
+        }
+    }
+    let_go(k);
+    c->blocks[n] = m;
+    return m;
+}
+
+int cowread(cow* c, void* buf, size_t n)
+{
+    if (c->at >= c->size)
+        return 0;
+    if (n > c->size - c->at)
+        n = c->size - c->at;
+
+    uint8_t* p = (uint8_t*)buf;
+    for (size_t left = n; left;)
+    {
+        const uint32_t k = c->at / COW_BLOCK, o = c->at % COW_BLOCK;
+        const size_t len = left < COW_BLOCK - o ? left : COW_BLOCK - o;
+        if (k < c->blocks.size() && c->blocks[k])
+            memcpy(p, c->blocks[k]->d + o, len);
+        else
+        {
+            // past the end of the card's copy is what was written there, or
+            // zeros in between
+            const ssize_t got = pread(c->b->fd, p, len, c->at);
+            if (got < 0)
+                return n - left;
+            memset(p + got, 0, len - got);
+        }
+        p += len;
+        c->at += len;
+        left -= len;
+    }
+    return n;
+}
+
+size_t cowwrite(cow* c, const void* buf, size_t n)
+{
+    const uint8_t* p = (const uint8_t*)buf;
+    for (size_t left = n; left;)
+    {
+        const uint32_t k = c->at / COW_BLOCK, o = c->at % COW_BLOCK;
+        const size_t len = left < COW_BLOCK - o ? left : COW_BLOCK - o;
+        block* m = own(c, k);
+        if (!m)
+            return n - left;
+        memcpy(m->d + o, p, len);
+        p += len;
+        c->at += len;
+        left -= len;
+        if (c->at > c->size)
+            c->size = c->at;
+    }
+    return n;
+}
+
+bool cowseek(cow* c, uint32_t pos)
+{
+    c->at = pos;
+    return true;
+}
+
+uint32_t cowtell(cow* c)
+{
+    return c->at;
+}
+
+uint32_t cowsize(cow* c)
+{
+    return c->size;
+}
+
+void cowclose(cow* c)
+{
+    for (block* k : c->blocks)
+        let_go(k);
+    if (c->b->users.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        close(c->b->fd);
+        delete c->b;
+    }
+    delete c;
+}
+
+bool SdFile::share(SdFile& to)
+{
+    if (!c)
+    {
+        // from here on the card's copy is only read
+        if (!f || fflush(f))
+            return false;
+        base* b = new base;
+        b->fd = dup(fileno(f));
+        if (b->fd < 0)
+        {
+            delete b;
+            return false;
+        }
+        b->users.store(1, std::memory_order_relaxed);
+        c = new cow{b, (uint32_t)ftell(f), fileSize(), {}};
+        fclose(f);
+        f = NULL;
+    }
+
+    to.close();
+    to.c = new cow{c->b, c->at, c->size, c->blocks};
+    c->b->users.fetch_add(1, std::memory_order_relaxed);
+    for (block* k : c->blocks)
+    {
+        if (k)
+            k->users.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+uint32_t SdFile::own()
+{
+    uint32_t n = 0;
+    if (c)
+    {
+        for (block* k : c->blocks)
+        {
+            if (k && k->users.load(std::memory_order_relaxed) == 1)
+                n += COW_BLOCK;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,36 @@
+// sam11 host build: the Teensy's elapsedMillis and elapsedMicros
+
+#ifndef H_HOST_ELAPSEDMILLIS
+#define H_HOST_ELAPSEDMILLIS
+
+#include "Arduino.h"
+
+class elapsedMillis
+{
+    unsigned long ms;
+
+public:
+    elapsedMillis() { ms = millis(); }
+    operator unsigned long() const { return millis() - ms; }
+    elapsedMillis& operator=(unsigned long v)
+    {
+        ms = millis() - v;
+        return *this;
+    }
+};
+
+class elapsedMicros
+{
+    unsigned long us;
+
+public:
+    elapsedMicros() { us = micros(); }
+    operator unsigned long() const { return micros() - us; }
+    elapsedMicros& operator=(unsigned long v)
+    {
+        us = micros() - v;
+        return *this;
+    }
+};
+
+#endif
@@ -0,0 +1,137 @@
+// sam11 host build: forking a running machine, and cloning the fork into as
+// many machines as are wanted (USE_FORK, see host.h).
+//
+// A fork is the processor and device state, saved the way a checkpoint saves
+// it (ckpt.h), and a share of the machine's memory pages and disk images. A
+// clone gets a share of them in turn, and loads the state, so nothing is
+// copied until one of them writes to a page or a disk block.
+
+#include "host.h"
+
+#include "pdp1140.h"
+
+#if USE_FORK
+
+#include "ckpt.h"
+#include "kb11.h"  // 11/45
+#include "kd11.h"  // 11/40
+#include "ms11.h"
+#include "rk11.h"
+#include "sam11.h"
+
+#include <Arduino.h>
+#include <SdFat.h>
+
+#if USE_11_45 && !STRICT_11_40
+#define procNS kb11
+#else
+#define procNS kd11
+#endif
+
+#define FORK_STATE (4096)  // bytes for the processor and device state, well over what they save
+
+namespace host {
+
+struct image
+{
+    ms11::page* pages[MS11_PAGES];
+    SdFile disks[NUM_RK_DRIVES];
+    bool attached[NUM_RK_DRIVES];
+    uint8_t state[FORK_STATE];
+    uint32_t n;  // how much of state there is
+};
+
+static void close(image* i)
+{
+    ms11::release(i->pages);
+    for (int d = 0; d < NUM_RK_DRIVES; d++)
+        i->disks[d].close();
+    delete i;
+}
+
+image* fork()
+{
+    image* i = new image();
+    ms11::release(i->pages);  // the zero page, until share()
+    SdFile f;
+    f.open(i->state, sizeof(i->state), O_RDWR);
+    ckpt::failed = false;
+    ckpt::state(f, true);
+    i->n = f.curPosition();
+    f.close();
+
+    for (int d = 0; d < NUM_RK_DRIVES && !ckpt::failed; d++)
+    {
+        i->attached[d] = rk11::attached_drives[d];
+        if (i->attached[d] && !rk11::rkdata[d].share(i->disks[d]))
+            ckpt::failed = true;
+    }
+    if (ckpt::failed)
+    {
+        if (PRINTSIMLINES)
+            Serial.println(F("%% fork: failed to save the machine"));
+        close(i);
+        return NULL;
+    }
+
+    ms11::share(i->pages);
+    return i;
+}
+
+void clone(image* i)
+{
+    // the machine as it is at power on, which the fork's state goes on top of
+    ms11::begin();
+    procNS::reset();
+    ms11::adopt(i->pages);
+
+    for (int d = 0; d < NUM_RK_DRIVES; d++)
+    {
+        rk11::rkdata[d].close();
+        rk11::attached_drives[d] = i->attached[d] && i->disks[d].share(rk11::rkdata[d]);
+    }
+
+    SdFile f;
+    f.open(i->state, i->n, O_READ);
+    ckpt::failed = false;
+    ckpt::state(f, false);
+    f.close();
+    if (ckpt::failed)
+    {
+        if (PRINTSIMLINES)
+            Serial.println(F("%% fork: failed to load the machine"));
+        panic();
+    }
+}
+
+void drop(image* i)
+{
+    close(i);
+}
+
+void scrap()
+{
+    ms11::end();
+    for (int d = 0; d < NUM_RK_DRIVES; d++)
+    {
+        rk11::rkdata[d].close();
+        rk11::attached_drives[d] = false;
+    }
+}
+
+size_t footprint()
+{
+    size_t n = 0;
+    for (uint16_t p = 0; p < MS11_PAGES; p++)
+    {
+        if (ms11::is_dirty(p))
+            n += MS11_PAGE_SIZE;
+    }
+    for (int d = 0; d < NUM_RK_DRIVES; d++)
+        n += rk11::rkdata[d].own();
+    return n;
+}
+
+};  // namespace host
+
+#endif
@@ -0,0 +1,79 @@
+#!/bin/sh
+# Redo FUSED_OPS in ../include/cpu/cpu_fused.h from the instruction pairs a
+# UNIX V6 session runs most, as a PAIR_STATS build of the threaded core
+# prints them on exit (pairstats()). Pairs starting with a control flow
+# instruction can't be fused, and ones with an instruction that only some
+# builds have (USE_FP, USE_FIS) wouldn't compile in the others, so both are
+# left out.
+#
+#   fused_ops.sh build/pairs/sam11 [count]    run the session (make fused)
+#   fused_ops.sh - [count] < output           use the output of another run
+#
+# count is how many pairs to keep, 12 by default.
+
+here=$(cd "$(dirname "$0")" && pwd)
+count=${2:-12}
+ops="$here/../include/cpu/cpu_threaded.cpp.h"
+out="$here/../include/cpu/cpu_fused.h"
+
+if [ "$1" = - ]; then
+    stats=$(cat)
+else
+    sam11=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+    dir=$(mktemp -d)
+    trap 'rm -rf "$dir"' EXIT
+    cp "$here/../../resources/OS Images/unixv6.dsk" "$dir/" || exit 1
+    script=$(printf 'unix\r~~root\r~ls -l /bin /usr/bin\r~~sort /etc/passwd\r~ed /etc/passwd\r1,$p\rq\r~cat >x.c\rmain(){int i,s;s=0;for(i=0;i<1000;i++)s=+i*3%%7;printf("%%d\\n",s);}\r\004~cc x.c\r~~~~~~~~~a.out\r~~')
+    stats=$(SAMDIR="$dir" "$sam11" -t 45 "$script")
+fi
+
+# the ops every build has, straight then flow, from their lists in ops
+names=$(awk '
+    /^#define STRAIGHT_OPS\(X\)/ { list = "straight" }
+    /^#define FLOW_OPS\(X\)/ { list = "flow" }
+    list && match($0, /X\([A-Za-z_]+\)/) { print list, substr($0, RSTART + 2, RLENGTH - 3) }
+    list && !/\\$/ { list = "" }
+' "$ops")
+
+pairs=$(echo "$stats" | tr -d '\r' | awk -v names="$names" -v count="$count" '
+    BEGIN {
+        n = split(names, w, /[ \n]/)
+        for (i = 1; i < n; i += 2)
+            kind[w[i + 1]] = w[i]
+    }
+    match($0, /X\([A-Za-z_]+, [A-Za-z_]+\)/) {
+        split(substr($0, RSTART + 2, RLENGTH - 3), p, ", ")
+        if (kind[p[1]] == "straight" && kind[p[2]] != "" && kept < count) {
+            print "X(" p[1] ", " p[2] ")"
+            kept++
+        }
+    }
+')
+
+if [ -z "$pairs" ]; then
+    echo "$stats"
+    echo "fused_ops: no pairs found, is it a THREADED_CORE and PAIR_STATS build?"
+    exit 1
+fi
+
+{
+    printf '%s\n' \
+        '// Pairs of instructions the threaded core fuses (see cpu_threaded.cpp.h),' \
+        '// most common first. Written by host/fused_ops.sh from a UNIX V6 session' \
+        '// (booting, ls, sort, ed, cc) on a PAIR_STATS build: the pairs it ran most,' \
+        '// less those starting with a control flow instruction. Run it again to' \
+        '// redo them for another workload.' \
+        ''
+    echo "$pairs" | awk '
+        { line[NR] = $0; if (length($0) > width) width = length($0) }
+        END {
+            if (width < 17)
+                width = 17
+            printf "%-" width + 4 "s\\\n", "#define FUSED_OPS(X)"
+            for (i = 1; i < NR; i++)
+                printf "    %-" width "s\\\n", line[i]
+            printf "    %s\n", line[NR]
+        }
+    '
+} > "$out"
+echo "fused_ops: wrote $(echo "$pairs" | wc -l) pairs to $out"
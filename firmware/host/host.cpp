@@ -0,0 +1,222 @@
+// sam11 host build: the Arduino and SdFat pieces that need more than a stub.
+// With MULTI_MACHINE, the console and the card are each thread's own, like the
+// rest of its machine, and the terminal is the process's.
+
+#include "host.h"
+
+#include "pdp1140.h"
+
+#include "Arduino.h"
+#include "SdFat.h"
+
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+Stream Serial;
+
+namespace host {
+
+static PERMACHINE const char* feed;        // script for the console, or NULL for stdin
+static PERMACHINE uint32_t feedgap;        // us between script characters
+static PERMACHINE uint64_t feednext;       // when the next script character is available
+static PERMACHINE uint64_t until;          // deadline() in us, 0 for none
+static PERMACHINE int ahead = -1;          // stdin byte read by available(), or -1
+static PERMACHINE bool eof;                // stdin has run out, e.g. /dev/null
+static PERMACHINE bool quiet;
+static PERMACHINE void (*put)(uint8_t c);  // console() output, or NULL for stdout
+static PERMACHINE const char* dir;         // card(), or NULL for $SAMDIR
+static bool raw;
+static struct termios cooked;
+
+static uint64_t now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+static const uint64_t epoch = now();
+
+void script(const char* s, uint32_t gap, uint32_t start)
+{
+    feed = s;
+    feedgap = gap;
+    feednext = now() + start;
+}
+
+void deadline(uint32_t ms)
+{
+    until = ms ? now() + (uint64_t)ms * 1000 : 0;
+}
+
+void echo(bool on)
+{
+    quiet = !on;
+}
+
+void console(void (*fn)(uint8_t c))
+{
+    put = fn;
+}
+
+void card(const char* d)
+{
+    dir = d;
+}
+
+void sleep()
+{
+    if (feed || eof)
+    {
+        usleep(1000);
+        return;
+    }
+    struct pollfd p = {0, POLLIN, 0};
+    poll(&p, 1, 1);
+}
+
+static void restore()
+{
+    if (raw)
+        tcsetattr(0, TCSANOW, &cooked);
+    raw = false;
+}
+
+static void interrupted(int)
+{
+    exit(1);  // through restore()
+}
+
+// characters straight through from the terminal, but with ^C still stopping it
+static void makeraw()
+{
+    static bool tried;
+    if (tried)
+        return;
+    tried = true;
+    if (!isatty(0) || tcgetattr(0, &cooked))
+        return;
+    struct termios t = cooked;
+    t.c_iflag &= ~(ICRNL | INLCR | IXON);
+    t.c_lflag &= ~(ICANON | ECHO);
+    t.c_cc[VMIN] = 1;
+    t.c_cc[VTIME] = 0;
+    if (tcsetattr(0, TCSANOW, &t))
+        return;
+    raw = true;
+    atexit(restore);
+    signal(SIGINT, interrupted);
+    signal(SIGTERM, interrupted);
+}
+
+};  // namespace host
+
+using namespace host;
+
+int Stream::available()
+{
+    if (this != &Serial)
+        return ptyavailable(this);
+    if (feed)
+    {
+        if (!*feed || now() < feednext)
+            return 0;
+        if (*feed == '~')
+        {
+            feednext = now() + 2000000;
+            feed++;
+            return 0;
+        }
+        return 1;
+    }
+    makeraw();
+    if (ahead >= 0)
+        return 1;
+    struct pollfd p = {0, POLLIN, 0};
+    if (eof || poll(&p, 1, 0) != 1 || !(p.revents & (POLLIN | POLLHUP)))
+        return 0;
+    uint8_t c;  // readable at the end of the input too, so see which
+    const ssize_t n = ::read(0, &c, 1);
+    if (n == 1)
+        ahead = c;
+    eof = n == 0;
+    return n == 1;
+}
+
+int Stream::read()
+{
+    if (this != &Serial)
+        return ptyread(this);
+    if (!available())
+        return -1;
+    if (feed)
+    {
+        feednext = now() + feedgap;
+        return (uint8_t)*feed++;
+    }
+    const int c = ahead;
+    ahead = -1;
+    return c;
+}
+
+int Stream::availableForWrite()
+{
+    if (this != &Serial)
+        return ptyroom(this);
+    return 64;
+}
+
+size_t Stream::write(uint8_t c)
+{
+    if (this != &Serial)
+        return ptywrite(this, c);
+    if (put)
+        put(c);
+    else if (!quiet)
+        fputc(c, stdout);
+    return 1;
+}
+
+void Stream::flush()
+{
+    if (this == &Serial)
+        fflush(stdout);
+}
+
+unsigned long micros()
+{
+    return now() - epoch;
+}
+
+unsigned long millis()
+{
+    return (now() - epoch) / 1000;
+}
+
+void delay(unsigned long ms)
+{
+    if (until && now() >= until)
+    {
+#if MULTI_MACHINE
+        pthread_exit(0);  // only this machine stops
+#else
+        fflush(stdout);
+        exit(0);
+#endif
+    }
+    usleep(ms * 1000);
+}
+
+const char* sdpath(const char* name)
+{
+    static PERMACHINE char p[2][512];
+    static PERMACHINE uint8_t n;
+    const char* d = dir ? dir : getenv("SAMDIR");
+    n ^= 1;
+    snprintf(p[n], sizeof(p[n]), "%s/%s", d ? d : ".", name);
+    return p[n];
+}
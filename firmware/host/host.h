@@ -0,0 +1,75 @@
+// sam11 host build: the console, the serial ports and the clock
+
+#ifndef H_HOST
+#define H_HOST
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Stream;
+
+namespace host {
+
+// Feed the console from script instead of stdin. A character is only
+// available gap microseconds after the last one was read, the first after
+// start microseconds, and each '~' in the script is a two second pause.
+void script(const char* s, uint32_t gap, uint32_t start);
+
+// stop at the first delay() after this many milliseconds, e.g. once halted
+void deadline(uint32_t ms);
+
+// wait for console input, or a millisecond, whichever comes first
+void sleep();
+
+// copy the console output to stdout, or drop it
+void echo(bool on);
+
+// With MULTI_MACHINE (pdp1140.h) each thread runs a machine of its own, and
+// all of the above is for the calling thread's. Give each one its own disk
+// images before its setup(), and somewhere its console output goes.
+
+// pass the console output to fn a character at a time, rather than stdout,
+// or stdout again for NULL
+void console(void (*fn)(uint8_t c));
+
+// the directory the card is, rather than $SAMDIR (SdFat.h), or NULL for $SAMDIR
+void card(const char* d);
+
+// With USE_FORK (pdp1140.h) the calling thread's machine can be forked, e.g.
+// once UNIX is up, and the fork cloned into as many machines as are wanted,
+// each on a thread of its own. A fork and its clones share the memory pages
+// (ram_cow.cpp.h) and the disk blocks (cow.cpp) copy-on-write, so making a
+// clone copies nothing, and each only grows with what it writes.
+struct image;
+
+// the calling thread's machine as it is now, which carries on from there as
+// before. Call it between loop()s
+image* fork();
+
+// make the calling thread's machine a copy of i, instead of its setup()
+void clone(image* i);
+
+// let go of i once it's cloned as many times as it's going to be, the clones
+// keep what they share with it
+void drop(image* i);
+
+// let go of the calling thread's memory and disks, e.g. before it ends
+void scrap();
+
+// the bytes of memory and disk the calling thread's machine has to itself,
+// since it was forked or cloned
+size_t footprint();
+
+// The serial ports in TTY_PORTS are ptys (pty.cpp), opened as they're
+// begun. The name of port n's, e.g. /dev/pts/3, or NULL if it isn't open
+const char* ptyname(uint8_t n);
+
+// Stream's available(), read(), availableForWrite() and write() for them
+int ptyavailable(Stream* s);
+int ptyread(Stream* s);
+int ptyroom(Stream* s);
+size_t ptywrite(Stream* s, uint8_t c);
+
+};  // namespace host
+
+#endif
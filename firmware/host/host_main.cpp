@@ -0,0 +1,79 @@
+// sam11 host build: runs the emulator in a terminal
+//
+//   sam11 [-t seconds] [-g gap_us] [-d delay_ms] [script]
+//
+// The disks are read from $SAMDIR (see SdFat.h), the same names as on the SD
+// card. With a script the console input comes from it rather than the
+// terminal, a character at a time, e.g. 'unix\r~~root\r' (see host.h). -t
+// stops after that many seconds, so a scripted run can be timed. The DL11 and
+// DH11 lines, if they're configured, are ptys, listed on stderr at the start.
+
+#include "host.h"
+
+#include "pdp1140.h"
+
+#include "kb11.h"
+#include "kd11.h"
+#include "rr.h"
+
+#include <Arduino.h>
+#include <unistd.h>
+
+#if USE_11_45 && !STRICT_11_40
+#define procNS kb11
+#else
+#define procNS kd11
+#endif
+
+void setup();
+void loop();
+
+int main(int argc, char** argv)
+{
+    uint32_t secs = 0;
+    uint32_t gap = 20000;
+    uint32_t start = 2000;
+    int c;
+    while ((c = getopt(argc, argv, "t:g:d:")) != -1)
+    {
+        switch (c)
+        {
+        case 't':
+            secs = atol(optarg);
+            break;
+        case 'g':
+            gap = atol(optarg);
+            break;
+        case 'd':
+            start = atol(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t seconds] [-g gap_us] [-d delay_ms] [script]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind < argc)
+    {
+        host::script(argv[optind], gap, start * 1000);
+    }
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+    host::deadline(secs * 1000);
+#if USE_RR
+    atexit(rr::end);  // -t exits from delay() too
+#endif
+    setup();
+    for (uint8_t n = 0; n < HOST_TTYS; n++)
+    {
+        if (host::ptyname(n))
+            fprintf(stderr, "sam11: serial port %u is %s\n", n, host::ptyname(n));
+    }
+    while (!secs || millis() < secs * 1000)
+    {
+        loop();
+    }
+#if THREADED_CORE && PAIR_STATS
+    procNS::pairstats();
+#endif
+    return 0;
+}
@@ -0,0 +1,309 @@
+// sam11 host build: the serial ports in TTY_PORTS, the DL11 and DH11 lines,
+// each a pty. Connect to one with e.g. 'screen /dev/pts/3'.
+//
+// The processor never makes a system call for them. Each port has a buffer
+// each way, and one thread waits on all the ptys at once (epoll, or poll()
+// off Linux) to fill and empty them, so an idle line costs nothing and a busy
+// one costs the same however many others there are.
+
+#include "host.h"
+
+#include "Arduino.h"
+
+#include <atomic>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#define PTY_BUF 4096 // bytes buffered each way per port (must be a power of 2)
+
+Stream tty[HOST_TTYS];
+
+namespace host {
+
+struct pty
+{
+    int fd = -1;     // the master side, -1 until it's begun
+    int slave = -1;  // held open so the master doesn't hang up between users
+    char name[32];
+
+    // free running indexes, the processor adds to out and takes from in
+    uint8_t in[PTY_BUF];
+    std::atomic<uint32_t> inhead{0}, intail{0};
+    uint8_t out[PTY_BUF];
+    std::atomic<uint32_t> outhead{0}, outtail{0};
+
+    // the thread's own
+    bool stalled;  // the pty took only part of out, wait until it takes more
+    uint32_t want;  // what the thread is waiting for, POLLIN and POLLOUT
+};
+
+static pty ptys[HOST_TTYS];
+static int wake[2] = {-1, -1};  // a pipe, written to when the thread has to look again
+static pthread_t thread;
+
+#ifdef __linux__
+static int ep = -1;
+#endif
+
+// tell the thread one of the buffers has changed from full or empty
+static void poke()
+{
+    const char c = 0;
+    if (write(wake[1], &c, 1) < 0)
+    {
+        // it's full, so it'll be looked at anyway
+    }
+}
+
+// copy what the pty has into in, as far as there's room
+static void fill(pty& p)
+{
+    const uint32_t head = p.inhead.load(std::memory_order_relaxed);
+    const uint32_t tail = p.intail.load(std::memory_order_acquire);
+    const uint32_t room = PTY_BUF - (head - tail);
+    const uint32_t at = head & (PTY_BUF - 1);
+    const uint32_t n = room < PTY_BUF - at ? room : PTY_BUF - at;
+    if (!n)
+        return;
+    const ssize_t got = read(p.fd, p.in + at, n);
+    if (got > 0)
+        p.inhead.store(head + got, std::memory_order_release);
+}
+
+// copy out to the pty, as far as it takes it
+static void flush(pty& p)
+{
+    for (;;)
+    {
+        const uint32_t head = p.outhead.load(std::memory_order_acquire);
+        const uint32_t tail = p.outtail.load(std::memory_order_relaxed);
+        const uint32_t at = tail & (PTY_BUF - 1);
+        const uint32_t n = head - tail < PTY_BUF - at ? head - tail : PTY_BUF - at;
+        p.stalled = false;
+        if (!n)
+            return;
+        const ssize_t put = write(p.fd, p.out + at, n);
+        if (put <= 0)
+        {
+            p.stalled = true;
+            return;
+        }
+        p.outtail.store(tail + put, std::memory_order_release);
+    }
+}
+
+// what to wait for on p: input while there's room for it, and room in the
+// pty while there's output it didn't take
+static void arm(uint8_t t)
+{
+    pty& p = ptys[t];
+    const uint32_t head = p.inhead.load(std::memory_order_relaxed);
+    const uint32_t want = (head - p.intail.load(std::memory_order_acquire) < PTY_BUF ? POLLIN : 0) | (p.stalled ? POLLOUT : 0);
+    if (want == p.want)
+        return;
+    p.want = want;
+#ifdef __linux__
+    struct epoll_event e = {};
+    e.events = (want & POLLIN ? EPOLLIN : 0) | (want & POLLOUT ? EPOLLOUT : 0);
+    e.data.u32 = t;
+    epoll_ctl(ep, EPOLL_CTL_MOD, p.fd, &e);
+#endif
+}
+
+// look at every port, after a poke or when one's been begun
+static void all()
+{
+    char c[64];
+    while (read(wake[0], c, sizeof(c)) > 0)
+    {
+    }
+    for (uint8_t t = 0; t < HOST_TTYS; t++)
+    {
+        if (ptys[t].fd < 0)
+            continue;
+        flush(ptys[t]);
+        arm(t);
+    }
+}
+
+static void* service(void*)
+{
+    for (;;)
+    {
+#ifdef __linux__
+        struct epoll_event e[HOST_TTYS + 1];
+        const int n = epoll_wait(ep, e, HOST_TTYS + 1, -1);
+        for (int i = 0; i < n; i++)
+        {
+            const uint32_t t = e[i].data.u32;
+            if (t == HOST_TTYS)
+            {
+                all();
+                continue;
+            }
+            if (e[i].events & EPOLLIN)
+                fill(ptys[t]);
+            if (e[i].events & EPOLLOUT)
+                flush(ptys[t]);
+            arm(t);
+        }
+#else
+        struct pollfd f[HOST_TTYS + 1];
+        uint8_t line[HOST_TTYS];
+        int n = 0;
+        for (uint8_t t = 0; t < HOST_TTYS; t++)
+        {
+            if (ptys[t].fd >= 0 && ptys[t].want)
+            {
+                f[n] = {ptys[t].fd, (short)ptys[t].want, 0};
+                line[n++] = t;
+            }
+        }
+        f[n] = {wake[0], POLLIN, 0};
+        poll(f, n + 1, -1);
+        for (int i = 0; i < n; i++)
+        {
+            const uint8_t t = line[i];
+            if (f[i].revents & POLLIN)
+                fill(ptys[t]);
+            if (f[i].revents & POLLOUT)
+                flush(ptys[t]);
+            arm(t);
+        }
+        if (f[n].revents & POLLIN)
+            all();
+#endif
+    }
+    return 0;
+}
+
+// start the thread, the first time a port's begun
+static bool start()
+{
+    if (wake[0] >= 0)
+        return true;
+    if (pipe(wake))
+        return false;
+    fcntl(wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake[1], F_SETFL, O_NONBLOCK);
+#ifdef __linux__
+    ep = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event e = {};
+    e.events = EPOLLIN;
+    e.data.u32 = HOST_TTYS;
+    epoll_ctl(ep, EPOLL_CTL_ADD, wake[0], &e);
+#endif
+    return !pthread_create(&thread, 0, service, 0);
+}
+
+static bool ptyopen(uint8_t t)
+{
+    pty& p = ptys[t];
+    const int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) || unlockpt(fd) || !ptsname(fd))
+    {
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+    snprintf(p.name, sizeof(p.name), "%s", ptsname(fd));
+    p.slave = ::open(p.name, O_RDWR | O_NOCTTY);
+
+    // characters straight through, and no echo back into the PDP
+    struct termios tio;
+    if (p.slave >= 0 && !tcgetattr(p.slave, &tio))
+    {
+        cfmakeraw(&tio);
+        tcsetattr(p.slave, TCSANOW, &tio);
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+#ifdef __linux__
+    struct epoll_event e = {};
+    e.data.u32 = t;
+    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &e);
+#endif
+    p.fd = fd;
+    return true;
+}
+
+const char* ptyname(uint8_t n)
+{
+    return n < HOST_TTYS && ptys[n].fd >= 0 ? ptys[n].name : 0;
+}
+
+};  // namespace host
+
+using namespace host;
+
+// a port from TTY_PORTS, by its index in tty
+static pty* port(Stream* s)
+{
+    const ptrdiff_t t = s - tty;
+    return t >= 0 && t < HOST_TTYS ? &ptys[t] : 0;
+}
+
+void Stream::begin(long)
+{
+    pty* p = port(this);
+    if (!p || p->fd >= 0)
+        return;
+    if (!start() || !ptyopen(p - ptys))
+    {
+        fprintf(stderr, "sam11: no pty for serial port %u\n", (unsigned)(p - ptys));
+        return;
+    }
+    poke();
+}
+
+// the processor's side of a port: only the buffers, never the pty
+int host::ptyavailable(Stream* s)
+{
+    pty* p = port(s);
+    if (!p || p->fd < 0)
+        return 0;
+    return p->inhead.load(std::memory_order_acquire) - p->intail.load(std::memory_order_relaxed);
+}
+
+int host::ptyread(Stream* s)
+{
+    if (!ptyavailable(s))
+        return -1;
+    pty* p = port(s);
+    const uint32_t tail = p->intail.load(std::memory_order_relaxed);
+    const uint8_t c = p->in[tail & (PTY_BUF - 1)];
+    const bool full = p->inhead.load(std::memory_order_acquire) - tail == PTY_BUF;
+    p->intail.store(tail + 1, std::memory_order_release);
+    if (full)
+        poke();  // it stopped reading the pty
+    return c;
+}
+
+int host::ptyroom(Stream* s)
+{
+    pty* p = port(s);
+    if (!p || p->fd < 0)
+        return 0;
+    return PTY_BUF - (p->outhead.load(std::memory_order_relaxed) - p->outtail.load(std::memory_order_acquire));
+}
+
+size_t host::ptywrite(Stream* s, uint8_t c)
+{
+    if (!ptyroom(s))
+        return 0;
+    pty* p = port(s);
+    const uint32_t head = p->outhead.load(std::memory_order_relaxed);
+    p->out[head & (PTY_BUF - 1)] = c;
+    p->outhead.store(head + 1, std::memory_order_release);
+    if (head == p->outtail.load(std::memory_order_acquire))
+        poke();  // it was empty, so nothing's sending it
+    return 1;
+}
@@ -0,0 +1,68 @@
+#!/bin/sh
+# Record a scripted UNIX V6 session with one host build of sam11 and replay it
+# with another (see rr.h), each on a fresh copy of the disk image. The replay
+# has to run to the end of the log without diverging and print the same
+# output, and has to diverge once an event in the log is changed.
+#
+#   rrtest.sh build/rrrecord/sam11 build/rrreplay/sam11
+
+record=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+replay=$(cd "$(dirname "$2")" && pwd)/$(basename "$2")
+here=$(cd "$(dirname "$0")" && pwd)
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+fresh()
+{
+    cp "$here/../../resources/OS Images/unixv6.dsk" "$dir/" || exit 1
+}
+
+# the console output, without sam11's own messages
+console()
+{
+    tr -d '\r\a' | sed 's/%%.*//' | grep -v '^$'
+}
+
+fail()
+{
+    cat "$dir/out"
+    echo "rr: FAILED ($1)"
+    exit 1
+}
+
+# replay until it stops, which is a panic that would otherwise wait for -t
+run_replay()
+{
+    fresh
+    SAMDIR="$dir" "$replay" -t 120 > "$dir/out" &
+    pid=$!
+    i=0
+    while ! grep -q 'rr: \(replay finished\|diverged\|failed\)' "$dir/out" && [ $i -lt 1200 ]; do
+        sleep 0.1
+        i=$((i + 1))
+    done
+    { kill $pid && wait $pid; } 2> /dev/null
+}
+
+fresh
+script=$(printf 'unix\r~~root\r~cat >x.c\rmain(){int i,s;s=0;for(i=0;i<1000;i++)s=+i*3%%7;printf("%%d\\n",s);}\r\004~cc x.c\r~~~~~~~~~a.out\r~~')
+SAMDIR="$dir" "$record" -t 40 "$script" > "$dir/out"
+console < "$dir/out" > "$dir/recorded"
+grep -qx 2999 "$dir/recorded" || fail "recording"
+cp "$dir/rr.log" "$dir/rr.keep"
+
+run_replay
+grep -q 'rr: replay finished' "$dir/out" || fail "replay"
+console < "$dir/out" > "$dir/replayed"
+grep -qx 2999 "$dir/replayed" || fail "replay output"
+# the recording ran on a little past its last event
+head -n $(wc -l < "$dir/replayed") "$dir/recorded" | cmp -s - "$dir/replayed" || fail "replay output differs"
+
+# change the PC of an event half way through
+n=$(($(wc -c < "$dir/rr.keep") / 16 / 2))
+cp "$dir/rr.keep" "$dir/rr.log"
+printf '\377' | dd of="$dir/rr.log" bs=1 seek=$((n * 16 + 12)) conv=notrunc 2> /dev/null
+run_replay
+grep -q 'rr: diverged' "$dir/out" || fail "changed log"
+
+echo "rr: ok"
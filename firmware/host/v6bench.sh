@@ -0,0 +1,30 @@
+#!/bin/sh
+# Boot UNIX V6 on a host build of sam11 with the FP11 (USE_FP), type in
+# ../test/whetstone.c, build it and time it with V6's time. Then time a shell
+# script of 30 "cat /unix ... >x" lines, each copying /unix ten times, which
+# is mostly read() and write() system calls moving data between the kernel and
+# user space (MFPI and MTPI). Runs on a copy of the disk image, so the one in
+# resources is never written to.
+#
+#   v6bench.sh build/fp/sam11 [loops]
+
+sam11=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+loops=${2:-20}
+here=$(cd "$(dirname "$0")" && pwd)
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cp "$here/../../resources/OS Images/unixv6.dsk" "$dir/" || exit 1
+
+# a pause every few lines, so the terminal input queue never fills
+source=$(awk '{ printf "%s\r", $0 } NR % 16 == 0 { printf "~" }' "$here/../test/whetstone.c")
+cats=$(for i in $(seq 30); do printf 'cat /unix /unix /unix /unix /unix /unix /unix /unix /unix /unix >x\r'; done)
+script=$(printf 'unix\r~~root\r~cat >c\r%s\004~cat >w.c\r%s\004~cc -f w.c\r~~~~~~~~~~~~time a.out %s\r~~~~time sh c\r' "$cats" "$source" "$loops")
+out=$(SAMDIR="$dir" "$sam11" -g 2000 -t 100 "$script~~~~~~~~~~~~~~~~~~~~" | tr -d '\r')
+
+if echo "$out" | grep -q '^m11 ' && echo "$out" | sed -n '/time sh c/,$p' | grep -q '^sys '; then
+    echo "$out" | sed -n '/time a.out/,$p' | grep -v '^# *$'
+else
+    echo "$out"
+    echo "v6bench: FAILED"
+    exit 1
+fi
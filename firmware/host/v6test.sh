@@ -0,0 +1,23 @@
+#!/bin/sh
+# Boot UNIX V6 on a host build of sam11, compile and run a C program, and
+# check its output. Runs on a copy of the disk image, so the one in
+# resources is never written to.
+#
+#   v6test.sh build/default/sam11
+
+sam11=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+here=$(cd "$(dirname "$0")" && pwd)
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cp "$here/../../resources/OS Images/unixv6.dsk" "$dir/" || exit 1
+
+script=$(printf 'unix\r~~root\r~cat >x.c\rmain(){int i,s;s=0;for(i=0;i<1000;i++)s=+i*3%%7;printf("%%d\\n",s);}\r\004~cc x.c\r~~~~~~~~~a.out\r~~')
+out=$(SAMDIR="$dir" "$sam11" -t 40 "$script" | tr -d '\r')
+
+if echo "$out" | grep -qx 2999; then
+    echo "v6: ok"
+else
+    echo "$out"
+    echo "v6: FAILED"
+    exit 1
+fi
@@ -0,0 +1,105 @@
+/*
+Modified BSD License
+
+Copyright (c) 2021 Chloe Lunn
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// sam11 checkpointing of the running machine to the SD card
+#include "pdp1140.h"
+#include "platform.h"
+
+#include <SdFat.h>
+
+/* Checkpoints:
+ * ============
+ *
+ * A checkpoint is the ram and the state of every device, written to the SD
+ * card so that a long running machine can be picked back up where it left off.
+ *
+ * Writing all 248KiB of ram to an SD card takes a noticeable amount of time,
+ * and the processor can't run while it happens, so only the first checkpoint
+ * is a full one. ms11 keeps a bitmap of which 8KiB pages have been written to,
+ * and every checkpoint after that only contains the pages that changed since
+ * the last one, plus the (small) cpu and device state.
+ *
+ * The checkpoints form a chain: "ckpt.000" is the full one, "ckpt.001" holds
+ * the changes on top of that, and so on. Restoring checks that each one is
+ * all there before loading any of them, and loads the chain up to the last
+ * whole one. compact() merges a chain into a single full checkpoint again,
+ * which is done at boot, and whenever the chain gets longer than
+ * CKPT_MAX_CHAIN a slice at a time from poll(), so the processor doesn't stop
+ * for the whole merge. If the merge fails, no more checkpoints are taken until
+ * a retry works, and the pages they would have had stay dirty until then.
+ *
+ * File layout (all little endian):
+ *
+ *   header  { 'S' '1' '1' 'C', version, sequence, number of pages, state length }
+ *   state   { kd11/kb11, kt11, kw11, kl11, rk11, lp11 in that order }
+ *   pages   { page number, 8KiB of data } * number of pages
+ *
+ * Disk images are NOT part of a checkpoint, they carry on being written to as
+ * normal, so a checkpoint should only be restored with the disks it was
+ * taken with.
+ */
+
+#define CKPT_PERIOD_MS (60000)  // how often to take a checkpoint
+#define CKPT_CHECK     (4096)   // how many steps between checking if it's time for a checkpoint
+#define CKPT_MAX_CHAIN (16)     // compact the chain when it gets this long
+#define CKPT_RESTORE   (true)   // restore the checkpoint chain (if there is one) at boot
+
+namespace ckpt {
+
+enum
+{
+    VERSION = 4,
+};
+
+struct header {
+    char magic[4];
+    uint16_t version;
+    uint16_t seq;
+    uint16_t pages;
+    uint16_t state;  // length of the device state
+};
+
+extern PERMACHINE uint32_t last_us;     // how long the processor was paused for by the last checkpoint
+extern PERMACHINE uint32_t last_bytes;  // how much the last checkpoint wrote to the card
+
+extern PERMACHINE bool failed;  // a block of state couldn't be saved or loaded since this was last cleared
+
+bool xfer(SdFile& f, bool save, void* p, size_t n);
+void state(SdFile& f, bool save);  // the processor and device state, as in a checkpoint (and a fork)
+
+void begin();
+void poll();
+bool take();
+bool restore();
+bool compact();
+
+};  // namespace ckpt
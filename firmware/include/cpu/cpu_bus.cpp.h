@@ -38,8 +38,15 @@ static uint16_t read8(const uint16_t a)
     return dd11::read8(kt11::decode_instr(a, false, curuser));
 }
 
+// word accesses go straight to ram when kt11::fastword() can map them
+
 static uint16_t read16(const uint16_t a)
 {
+    const uint32_t pa = kt11::fastword(a, false, curuser);
+    if (pa != NO_SPAN)
+    {
+        return ms11::read16(pa);
+    }
     return dd11::read16(kt11::decode_instr(a, false, curuser));
 }
 
@@ -50,6 +57,12 @@ static void write8(const uint16_t a, const uint16_t v)
 
 static void write16(const uint16_t a, const uint16_t v)
 {
+    const uint32_t pa = kt11::fastword(a, true, curuser);
+    if (pa != NO_SPAN)
+    {
+        ms11::write16(pa, v);
+        return;
+    }
     dd11::write16(kt11::decode_instr(a, true, curuser), v);
 }
 
@@ -51,6 +51,120 @@ static uint16_t pop()
     return val;
 }
 
+// device status registers which can be read without side effects, by
+// physical address (which is above 4MB with USE_22BIT)
+static bool statusreg(const uint32_t pa)
+{
+    if (pa == NO_SPAN || pa < IOPAGE_BASE)
+    {
+        return false;
+    }
+
+    switch (pa - (IOPAGE_BASE - DEV_MEMORY))  // the UNIBUS address, as in dd11
+    {
+    case DEV_CONSOLE_TTY_IN_STATUS:
+    case DEV_CONSOLE_TTY_OUT_STATUS:
+    case DEV_KW_LKS:
+    case DEV_LP_STATUS:
+    case DEV_RK_CS:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// the word at a, if reading it can't fault or have a side effect, for
+// spinloop, which looks at words the program hasn't read yet. Anything it
+// can't see this way just isn't a spin loop.
+static bool peek(const uint16_t a, uint16_t& v)
+{
+    const uint32_t pa = kt11::probe(a, curuser);
+    if ((a & 1) || pa == NO_SPAN || pa >= MAX_RAM_ADDRESS)
+    {
+        return false;
+    }
+    v = ms11::read16(pa);
+    return true;
+}
+
+// spinloop checks if the branch just taken, back len bytes to R[7], closes a
+// loop of a single TST(B) or BIT(B) #n of a device status register, e.g.
+// "1: TSTB @#177564; BPL 1b". Nothing about such a loop changes until the
+// device does, so it's flagged for loop0 to skip whole passes of it. It's
+// only a look ahead, so it must never trap or touch the MMU registers.
+static void spinloop(const uint16_t len)
+{
+    const uint16_t to = R[7];
+    uint16_t instr;
+    uint16_t ilen = 2;
+    uint16_t a;
+
+    if (!peek(to, instr))
+    {
+        return;
+    }
+
+    switch (instr & 0177700)
+    {
+    case 0005700:  // TST
+    case 0105700:  // TSTB
+        break;
+    case 0032700:  // BIT #n
+    case 0132700:  // BITB #n
+        ilen += 2;
+        break;
+    default:
+        return;
+    }
+
+    switch (instr & 077)
+    {
+    case 037:  // @#a
+        if (!peek(to + ilen, a))
+        {
+            return;
+        }
+        ilen += 2;
+        break;
+    case 067:  // a (relative)
+        if (!peek(to + ilen, a))
+        {
+            return;
+        }
+        ilen += 2;
+        a += to + ilen;
+        break;
+    case 010:  // (Rn)
+    case 011:
+    case 012:
+    case 013:
+    case 014:
+    case 015:
+        a = R[instr & 7];
+        break;
+    case 060:  // X(Rn)
+    case 061:
+    case 062:
+    case 063:
+    case 064:
+    case 065:
+        if (!peek(to + ilen, a))
+        {
+            return;
+        }
+        a += R[instr & 7];
+        ilen += 2;
+        break;
+    default:
+        return;
+    }
+
+    if (ilen + 2 == len && statusreg(kt11::probe(a, curuser)))
+    {
+        spinning = true;
+    }
+}
+
 static void branch(int16_t o)
 {
     if (o & 0x80)
@@ -59,25 +173,155 @@ static void branch(int16_t o)
     }
     o <<= 1;
     R[7] += o;
+
+    if (o < 0 && o >= -8)  // short loop, might be polling a device
+    {
+        spinloop(-o);
+    }
+}
+
+// Lazy condition codes.
+// The common instructions (MOV, CMP, TST, BIT, ADD, SUB, INC, DEC, ...) don't
+// work out N, Z, V and C as they go, they just note what they did in cc and
+// leave the flags in PS stale. flags() works them out when something needs
+// them. Anything else that reads or writes the low bits of PS has to call
+// flags() first.
+enum
+{
+    CC_PS,     // PS has the flags
+    CC_LOGIC,  // N, Z from res, V clear, C from PS
+    CC_TST,    // N, Z from res, V and C clear
+    CC_ADD,    // res = a + b
+    CC_SUB,    // res = a - b
+    CC_INC,    // res = a + 1, C from PS
+    CC_DEC     // res = a - 1, C from PS
+};
+
+static PERMACHINE struct
+{
+    uint8_t op;
+    uint16_t msb;  // sign bit, 0x8000 for words, 0x80 for bytes
+    uint16_t res;  // result, masked to the operand size
+    uint16_t a;
+    uint16_t b;
+} cc = {CC_PS, 0x8000, 0, 0, 0};
+
+// note the result of an instruction, flags() does the rest
+static inline void setcc(const uint8_t op, const uint16_t msb, const uint16_t res,
+                         const uint16_t a = 0, const uint16_t b = 0)
+{
+    if (op == CC_LOGIC || op == CC_INC || op == CC_DEC)
+    {
+        // C carries over, so it has to be settled in PS first
+        switch (cc.op)
+        {
+        case CC_TST:
+            PS &= ~FLAGC;
+            break;
+        case CC_ADD:
+            PS = (PS & ~FLAGC) | (cc.res < cc.a ? FLAGC : 0);
+            break;
+        case CC_SUB:
+            PS = (PS & ~FLAGC) | (cc.a < cc.b ? FLAGC : 0);
+            break;
+        }
+    }
+    cc.op = op;
+    cc.msb = msb;
+    cc.res = res;
+    cc.a = a;
+    cc.b = b;
+}
+
+// put the condition codes of the last noted instruction into PS
+void flags()
+{
+    if (cc.op == CC_PS)
+    {
+        return;
+    }
+    const uint16_t msb = cc.msb;
+    const uint16_t res = cc.res;
+    uint16_t f = PS & FLAGC;
+    if (res & msb)
+    {
+        f |= FLAGN;
+    }
+    if (res == 0)
+    {
+        f |= FLAGZ;
+    }
+    switch (cc.op)
+    {
+    case CC_TST:
+        f &= ~FLAGC;
+        break;
+    case CC_ADD:
+        f &= ~FLAGC;
+        if (~(cc.a ^ cc.b) & (cc.a ^ res) & msb)
+        {
+            f |= FLAGV;
+        }
+        if (res < cc.a)
+        {
+            f |= FLAGC;
+        }
+        break;
+    case CC_SUB:
+        f &= ~FLAGC;
+        if ((cc.a ^ cc.b) & (cc.a ^ res) & msb)
+        {
+            f |= FLAGV;
+        }
+        if (cc.a < cc.b)
+        {
+            f |= FLAGC;
+        }
+        break;
+    case CC_INC:
+        if (res == msb)
+        {
+            f |= FLAGV;
+        }
+        break;
+    case CC_DEC:
+        if (res == msb - 1)
+        {
+            f |= FLAGV;
+        }
+        break;
+    }
+    PS = (PS & 0xFFF0) | f;
+    cc.op = CC_PS;
 }
 
 bool N()
 {
+    if (cc.op != CC_PS)
+    {
+        return cc.res & cc.msb;
+    }
     return (uint8_t)PS & FLAGN;
 }
 
 bool Z()
 {
+    if (cc.op != CC_PS)
+    {
+        return cc.res == 0;
+    }
     return (uint8_t)PS & FLAGZ;
 }
 
 bool V()
 {
+    flags();
     return (uint8_t)PS & FLAGV;
 }
 
 bool C()
 {
+    flags();
     return (uint8_t)PS & FLAGC;
 }
 
@@ -87,6 +331,122 @@ void setZ(bool b)
         PS |= FLAGZ;
 }
 
+// blockloop checks if the SOB just taken on register s, back to R[7], closes a
+// loop of a single MOV (Rx)+,(Ry)+ or CLR (Ry)+, the way blocks of memory get
+// copied and cleared, e.g. "1: CLR (R0)+; SOB R1,1b". It's flagged for loop0
+// to run the passes it can in one go with blockrun()
+static PERMACHINE uint16_t block_instr;  // the MOV or CLR
+static PERMACHINE uint8_t block_reg;     // the SOB counter
+static PERMACHINE uint32_t block_pa;     // where the loop is
+
+static void blockloop(const uint8_t s)
+{
+    if (R[s] <= 0 || R[s] > 0177777)
+    {
+        return;
+    }
+    const uint32_t pa = kt11::span(R[7], 4, false, curuser);
+    if (pa == NO_SPAN)
+    {
+        return;
+    }
+    const uint16_t instr = ms11::read16(pa);
+    const uint8_t x = (instr >> 6) & 7;
+    const uint8_t y = instr & 7;
+    if ((instr & 0177070) == 0012020)  // MOV (Rx)+,(Ry)+
+    {
+        if (x == 7 || x == y || x == s)
+        {
+            return;
+        }
+    }
+    else if ((instr & 0177770) != 0005020)  // CLR (Ry)+
+    {
+        return;
+    }
+    if (y == 7 || y == s)
+    {
+        return;
+    }
+    block_instr = instr;
+    block_reg = s;
+    block_pa = pa;
+    copying = true;
+}
+
+// bytes from a to the end of its page, and not into the registers at 0170000
+static uint32_t page_left(const uint16_t a)
+{
+    if (a < 0170010 && a >= 0160000)
+    {
+        return a < 0170000 ? 0170000 - a : 0;
+    }
+    return 020000 - (a & 017777);
+}
+
+// run up to n passes of the loop blockloop() found, with one copy or fill of
+// the memory, stopping short of anything that would need the normal path
+// (the end of an MMU page, a page it can't use, or the I/O page). Returns the
+// number of passes run, which may be 0
+uint32_t blockrun(uint32_t n)
+{
+    const bool mov = block_instr & 0010000;
+    const uint8_t x = (block_instr >> 6) & 7;
+    const uint8_t y = block_instr & 7;
+    const uint16_t dst = R[y];
+    const uint16_t src = R[x];
+
+    if (n > (uint32_t)R[block_reg])
+    {
+        n = R[block_reg];
+    }
+    if (n > page_left(dst) / 2)
+    {
+        n = page_left(dst) / 2;
+    }
+    if (mov && n > page_left(src) / 2)
+    {
+        n = page_left(src) / 2;
+    }
+    if (!n || (dst & 1) || (mov && (src & 1)))
+    {
+        return 0;
+    }
+
+    uint32_t psrc = 0;
+    if (mov)
+    {
+        psrc = kt11::span(src, 2 * n, false, curuser);
+        if (psrc == NO_SPAN)
+        {
+            return 0;
+        }
+    }
+    const uint32_t pdst = kt11::span(dst, 2 * n, true, curuser);
+    if (pdst == NO_SPAN || (pdst < block_pa + 4 && pdst + 2 * n > block_pa))
+    {
+        return 0;  // can't, or it writes over the loop itself
+    }
+    if (mov)
+    {
+        ms11::copy16(pdst, psrc, n);
+        R[x] += 2 * n;
+        setcc(CC_LOGIC, 0x8000, ms11::read16(pdst + 2 * n - 2));
+    }
+    else
+    {
+        ms11::fill16(pdst, 0, n);
+        setcc(CC_TST, 0x8000, 0);
+    }
+    R[y] += 2 * n;
+    R[block_reg] -= n;
+    if (!R[block_reg])
+    {
+        R[7] += 4;  // the last SOB falls through
+    }
+    return n;
+}
+
 // aget resolves the operand to a vaddress.
 // if the operand is a register, an address in
 // the range [0170000,0170007). This address range is
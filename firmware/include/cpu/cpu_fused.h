@@ -0,0 +1,19 @@
+// Pairs of instructions the threaded core fuses (see cpu_threaded.cpp.h),
+// most common first. Written by host/fused_ops.sh from a UNIX V6 session
+// (booting, ls, sort, ed, cc) on a PAIR_STATS build: the pairs it ran most,
+// less those starting with a control flow instruction. Run it again to
+// redo them for another workload.
+
+#define FUSED_OPS(X) \
+    X(TST, BGE)      \
+    X(MOV, MOV)      \
+    X(CMP, BNE)      \
+    X(MTPI, SOB)     \
+    X(ADD, CMP)      \
+    X(CMP, BHI)      \
+    X(MOV, JSR)      \
+    X(CLR, MTPI)     \
+    X(MOV, RTS)      \
+    X(TST, BNE)      \
+    X(MFPI, MTPI)    \
+    X(CMP, BCS)
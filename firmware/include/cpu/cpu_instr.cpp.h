@@ -50,6 +50,20 @@ static void NOP(uint16_t instr)
     // does nothing, but does not cause trap
 }
 
+// Clear or set condition codes, CL? and SE?
+static void CCOP(uint16_t instr)
+{
+    flags();
+    if (instr & 020)
+    {
+        PS |= instr & 017;
+    }
+    else
+    {
+        PS &= ~instr & 017;
+    }
+}
+
 // Set priority level -- Not implemented
 static void SPL(uint16_t instr)
 {
@@ -68,20 +82,7 @@ static void CMP(uint16_t instr)
     uint16_t da = aget(d, l);
     uint16_t val2 = memread(da, l);
     const int32_t sval = (val1 - val2) & max;
-    PS &= 0xFFF0;
-    setZ(sval == 0);
-    if (sval & msb)
-    {
-        PS |= FLAGN;
-    }
-    if (((val1 ^ val2) & msb) && (!((val2 ^ sval) & msb)))
-    {
-        PS |= FLAGV;
-    }
-    if (val1 < val2)
-    {
-        PS |= FLAGC;
-    }
+    setcc(CC_SUB, msb, sval, val1, val2);
 }
 
 // Branch (always)
@@ -233,12 +234,7 @@ static void BIT(uint16_t instr)
     uint16_t da = aget(d, l);
     uint16_t val2 = memread(da, l);
     uint16_t uval = val1 & val2;
-    PS &= 0xFFF1;
-    setZ(uval == 0);
-    if (uval & msb)
-    {
-        PS |= FLAGN;
-    }
+    setcc(CC_LOGIC, msb, uval);
 }
 
 // Bit clear
@@ -253,12 +249,7 @@ static void BIC(uint16_t instr)
     uint16_t da = aget(d, l);
     uint16_t val2 = memread(da, l);
     uint16_t uval = (max ^ val1) & val2;
-    PS &= 0xFFF1;
-    setZ(uval == 0);
-    if (uval & msb)
-    {
-        PS |= FLAGN;
-    }
+    setcc(CC_LOGIC, msb, uval);
     memwrite(da, l, uval);
 }
 
@@ -273,12 +264,7 @@ static void BIS(uint16_t instr)
     uint16_t da = aget(d, l);
     uint16_t val2 = memread(da, l);
     uint16_t uval = val1 | val2;
-    PS &= 0xFFF1;
-    setZ(uval == 0);
-    if (uval & msb)
-    {
-        PS |= FLAGN;
-    }
+    setcc(CC_LOGIC, msb, uval);
     memwrite(da, l, uval);
 }
 
@@ -293,20 +279,7 @@ static void ADD(uint16_t instr)
     uint16_t da = aget(d, 2);
     uint16_t val2 = memread16(da);
     uint16_t uval = (val1 + val2) & 0xFFFF;
-    PS &= 0xFFF0;
-    setZ(uval == 0);
-    if (uval & 0x8000)
-    {
-        PS |= FLAGN;
-    }
-    if (!((val1 ^ val2) & 0x8000) && ((val2 ^ uval) & 0x8000))
-    {
-        PS |= FLAGV;
-    }
-    if ((val1 + val2) >= 0xFFFF)
-    {
-        PS |= FLAGC;
-    }
+    setcc(CC_ADD, 0x8000, uval, val2, val1);
     memwrite16(da, uval);
 }
 
@@ -321,20 +294,7 @@ static void SUB(uint16_t instr)
     uint16_t da = aget(d, 2);
     uint16_t val2 = memread16(da);
     uint16_t uval = (val2 - val1) & 0xFFFF;
-    PS &= 0xFFF0;
-    setZ(uval == 0);
-    if (uval & 0x8000)
-    {
-        PS |= FLAGN;
-    }
-    if (((val1 ^ val2) & 0x8000) && (!((val2 ^ uval) & 0x8000)))
-    {
-        PS |= FLAGV;
-    }
-    if (val1 > val2)
-    {
-        PS |= FLAGC;
-    }
+    setcc(CC_SUB, 0x8000, uval, val2, val1);
     memwrite16(da, uval);
 }
 
@@ -362,162 +322,217 @@ static void JSR(uint16_t instr)
 // Multiply
 static void MUL(uint16_t instr)
 {
-    uint8_t d = instr & 077;
-    uint8_t s = (instr & 07700) >> 6;
-    int32_t val1 = R[s & 7];
-    if (val1 & 0x8000)
-    {
-        val1 = -((0xFFFF ^ val1) + 1);
-    }
-    uint8_t l = 2 - (instr >> 15);
-    uint16_t da = aget(d, l);
-    int32_t val2 = memread16(da);
-    if (val2 & 0x8000)
-    {
-        val2 = -((0xFFFF ^ val2) + 1);
-    }
-    int32_t sval = val1 * val2;
-    R[s & 7] = sval >> 16;
-    R[(s & 7) | 1] = sval & 0xFFFF;
-    PS &= 0xFFF0;
-    if (sval & 0x80000000)
-    {
-        PS |= FLAGN;
-    }
-    setZ((sval & 0xFFFFFFFF) == 0);
-    if ((sval < 0x8000) || (sval >= 0x7FFF))  // if ((sval < (1 << 15)) || (sval >= ((1 << 15) - 1)))
-    {
-        PS |= FLAGC;
-    }
+    flags();
+    const uint8_t d = instr & 077;
+    const uint8_t s = (instr & 07700) >> 6;
+    const int16_t val1 = R[s & 7];
+    const int16_t val2 = memread16(aget(d, 2));
+    const int32_t sval = (int32_t)val1 * val2;
+    R[s & 7] = ((uint32_t)sval >> 16) & 0xFFFF;
+    R[(s & 7) | 1] = sval & 0xFFFF;  // an odd register only keeps the low word
+    PS = (PS & 0xFFF0) |
+         (sval < 0 ? FLAGN : 0) |
+         (sval == 0 ? FLAGZ : 0) |
+         (sval != (int16_t)sval ? FLAGC : 0);  // doesn't fit in one word
 }
 
 // Divide
 static void DIV(uint16_t instr)
 {
-    uint8_t d = instr & 077;
-    uint8_t s = (instr & 07700) >> 6;
-    int32_t val1 = (R[s & 7] << 16) | (R[(s & 7) | 1]);
-    uint8_t l = 2 - (instr >> 15);
-    uint16_t da = aget(d, l);
-    int32_t val2 = memread16(da);
+    flags();
+    const uint8_t d = instr & 077;
+    const uint8_t s = (instr & 07700) >> 6;
+    const int64_t val1 = (int32_t)(((uint32_t)R[s & 7] << 16) | (R[(s & 7) | 1] & 0xFFFF));
+    const int16_t val2 = memread16(aget(d, 2));
     PS &= 0xFFF0;
     if (val2 == 0)
     {
-        PS |= FLAGC;
+        PS |= FLAGV | FLAGC;  // the registers are left alone
         return;
     }
-    if ((val1 / val2) >= 0x10000)
+    const int64_t quot = val1 / val2;  // 64 bit, so -2^31 / -1 can't overflow
+    if (quot != (int16_t)quot)
     {
-        PS |= FLAGV;
+        PS |= FLAGV;  // quotient doesn't fit in a word, the registers are left alone
         return;
     }
-    R[s & 7] = (val1 / val2) & 0xFFFF;
-    R[(s & 7) | 1] = (val1 % val2) & 0xFFFF;
-    setZ(R[s & 7] == 0);
-    if (R[s & 7] & 0100000)
+    R[s & 7] = quot & 0xFFFF;
+    R[(s & 7) | 1] = (val1 % val2) & 0xFFFF;  // remainder has the sign of the dividend
+    PS |= (quot < 0 ? FLAGN : 0) | (quot == 0 ? FLAGZ : 0);
+}
+
+// Shift val, a signed value of bits bits, by the count in the low 6 bits of n
+// (-32 to 31, negative is right) like ASH and ASHC, and set the condition
+// codes. V is set if the sign changed along the way, C is the last bit out
+static uint32_t eis_shift(const int64_t val, const uint16_t n, const uint8_t bits)
+{
+    const int8_t count = (int8_t)(n << 2) >> 2;
+    int64_t sval;
+    uint16_t carry;
+    if (count >= 0)
     {
-        PS |= FLAGN;
+        sval = (int64_t)((uint64_t)val << count);
+        carry = count ? (sval >> bits) & 1 : 0;
     }
-    if (val1 == 0)
+    else
     {
-        PS |= FLAGV;
-    }
+        sval = val >> -count;
+        carry = (val >> (-count - 1)) & 1;
+    }
+    const int64_t top = (int64_t)1 << (bits - 1);
+    const uint32_t res = sval & ((top << 1) - 1);
+    PS = (PS & 0xFFF0) |
+         (res & top ? FLAGN : 0) |
+         (res == 0 ? FLAGZ : 0) |
+         (sval < -top || sval >= top ? FLAGV : 0) |
+         carry;
+    return res;
 }
 
 // Shift arithmetically
 static void ASH(uint16_t instr)
 {
-    uint8_t d = instr & 077;
-    uint8_t s = (instr & 07700) >> 6;
-    uint16_t val1 = R[s & 7];
-    uint16_t da = aget(d, 2);
-    uint16_t val2 = memread16(da) & 077;
-    PS &= 0xFFF0;
-    int32_t sval;
-    if (val2 & 040)
-    {
-        val2 = (077 ^ val2) + 1;
-        if (val1 & 0100000)
-        {
-            sval = 0xFFFF ^ (0xFFFF >> val2);
-            sval |= val1 >> val2;
-        }
-        else
-        {
-            sval = val1 >> val2;
-        }
-        if (val1 & (1 << (val2 - 1)))
-        {
-            PS |= FLAGC;
-        }
-    }
-    else
-    {
-        sval = (val1 << val2) & 0xFFFF;
-        if (val1 & (1 << (16 - val2)))
-        {
-            PS |= FLAGC;
-        }
-    }
-    R[s & 7] = sval;
-    setZ(sval == 0);
-    if (sval & 0100000)
-    {
-        PS |= FLAGN;
-    }
-    if ((sval & 0100000) xor (val1 & 0100000))
-    {
-        PS |= FLAGV;
-    }
+    flags();
+    const uint8_t d = instr & 077;
+    const uint8_t s = (instr & 07700) >> 6;
+    const int16_t val1 = R[s & 7];
+    const uint16_t val2 = memread16(aget(d, 2));
+    R[s & 7] = eis_shift(val1, val2, 16);
 }
 
 // Arith shift combined
 static void ASHC(uint16_t instr)
 {
-    uint8_t d = instr & 077;
-    uint8_t s = (instr & 07700) >> 6;
-    uint16_t val1 = R[s & 7] << 16 | R[(s & 7) | 1];
-    uint16_t da = aget(d, 2);
-    uint16_t val2 = memread16(da) & 077;
-    PS &= 0xFFF0;
-    int32_t sval;
-    if (val2 & 040)
+    flags();
+    const uint8_t d = instr & 077;
+    const uint8_t s = (instr & 07700) >> 6;
+    // with an odd register, it's shifted as the high and low word both
+    const int32_t val1 = ((uint32_t)R[s & 7] << 16) | (R[(s & 7) | 1] & 0xFFFF);
+    const uint16_t val2 = memread16(aget(d, 2));
+    const uint32_t sval = eis_shift(val1, val2, 32);
+    R[s & 7] = sval >> 16;
+    R[(s & 7) | 1] = sval & 0xFFFF;
+}
+
+#if USE_FP
+// Floating point, run by the FP11
+static void FPP(uint16_t instr)
+{
+    fp11::step(instr);
+}
+#endif
+
+#if USE_FIS
+// KE11-F floating instructions, which work on a stack of two F format numbers
+// at R: B at (R) and A at 4(R), each a high word then a low word. A op B
+// replaces A and pops B. The 24 bit fractions fit a host double exactly, so
+// the arithmetic runs on the FPU, and the error of the double result (which is
+// exact to recover) says which way the true answer rounds.
+
+// F format number from its high and low words
+static double fis_get(const uint16_t hi, const uint16_t lo)
+{
+    const uint16_t exp = (hi >> 7) & 0377;
+    if (!exp)
     {
-        val2 = (077 ^ val2) + 1;
-        if (val1 & 0x80000000)
+        return 0;  // anything with a 0 exponent is 0
+    }
+    // 0.1f * 2^(exp - 0200) is 1.f * 2^(exp - 0201), and doubles are biased by 1023
+    const uint64_t bits = ((uint64_t)(hi >> 15) << 63) | ((uint64_t)(exp + 894) << 52) | ((uint64_t)(((hi & 0177) << 16) | lo) << 29);
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+// Set the condition codes and trap through 244, leaving the stack alone
+static void fis_fail(const uint16_t cc)
+{
+    flags();
+    PS = (PS & 0177760) | cc;
+    longjmp(trapbuf, INTFPUERR);
+}
+
+// Round d, where the exact answer is d + err, half away from zero into A and
+// pop B. err is under half a unit in the last place of d, so only its sign
+// matters: a true value just below d comes out as one less in the bottom of
+// the fraction, which then rounds the way it would
+static void fis_put(const uint8_t r, const double d, const double err)
+{
+    const uint16_t a = R[r];
+    uint16_t hi = 0, lo = 0;
+    if (d != 0)
+    {
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        int32_t exp = (int32_t)((bits >> 52) & 03777) - 894;
+        uint64_t frac = (bits & 0xFFFFFFFFFFFFFULL) | (1ULL << 52);
+        if ((err != 0) && ((signbit(err) != 0) != (signbit(d) != 0)))
         {
-            sval = 0xFFFFFFFF ^ (0xFFFFFFFF >> val2);
-            sval |= val1 >> val2;
+            frac--;
         }
-        else
+        frac = (frac + (1ULL << 28)) >> 29;
+        if (frac >> 24)  // rounded up past the top
         {
-            sval = val1 >> val2;
+            frac >>= 1;
+            exp++;
         }
-        if (val1 & (1 << (val2 - 1)))
+        if (exp > 0377)
         {
-            PS |= FLAGC;
+            fis_fail(FLAGV);  // overflow
         }
-    }
-    else
-    {
-        sval = (val1 << val2) & 0xFFFFFFFF;
-        if (val1 & (1 << (32 - val2)))
+        if (exp <= 0)
         {
-            PS |= FLAGC;
+            fis_fail(FLAGN | FLAGV);  // underflow
         }
-    }
-    R[s & 7] = (sval >> 16) & 0xFFFF;
-    R[(s & 7) | 1] = sval & 0xFFFF;
-    setZ(sval == 0);
-    if (sval & 0x80000000)
+        hi = ((bits >> 48) & 0100000) | (exp << 7) | ((frac >> 16) & 0177);
+        lo = frac & 0xFFFF;
+    }
+    write16(a + 4, hi);
+    write16(a + 6, lo);
+    R[r] = (a + 4) & 0xFFFF;
+    flags();
+    PS = (PS & 0177760) | ((hi & 0100000) ? FLAGN : 0) | (hi ? 0 : FLAGZ);
+}
+
+// Floating add and subtract, A + B and A - B
+static void FADD(uint16_t instr)
+{
+    const uint8_t r = instr & 7;
+    const uint16_t a = R[r];
+    const double y = fis_get(read16(a), read16(a + 2));
+    const double x = fis_get(read16(a + 4), read16(a + 6));
+    const double b = (instr & 010) ? -y : y;  // FSUB
+    const double s = x + b;
+    const double t = s - x;
+    fis_put(r, s, (x - (s - t)) + (b - t));  // s + err is exactly x + b
+}
+
+// Floating multiply, A * B
+static void FMUL(uint16_t instr)
+{
+    const uint8_t r = instr & 7;
+    const uint16_t a = R[r];
+    const double y = fis_get(read16(a), read16(a + 2));
+    const double x = fis_get(read16(a + 4), read16(a + 6));
+    fis_put(r, x * y, 0);  // 24 x 24 bits is exact
+}
+
+// Floating divide, A / B
+static void FDIV(uint16_t instr)
+{
+    const uint8_t r = instr & 7;
+    const uint16_t a = R[r];
+    const double y = fis_get(read16(a), read16(a + 2));
+    const double x = fis_get(read16(a + 4), read16(a + 6));
+    if (y == 0)
     {
-        PS |= FLAGN;
-    }
-    if ((sval & 0x80000000) xor (val1 & 0x80000000))
-    {
-        PS |= FLAGV;
+        fis_fail(FLAGN | FLAGV | FLAGC);  // divide by zero
     }
+    const double q = x / y;
+    const double rem = fma(-q, y, x);  // exactly x - q * y, so q + rem / y is exact
+    fis_put(r, q, (y < 0) ? -rem : rem);
 }
+#endif
 
 // Exclusive OR
 static void XOR(uint16_t instr)
@@ -528,12 +543,7 @@ static void XOR(uint16_t instr)
     uint16_t da = aget(d, 2);
     uint16_t val2 = memread16(da);
     uint16_t uval = val1 ^ val2;
-    PS &= 0xFFF1;
-    setZ(uval == 0);
-    if (uval & 0x8000)
-    {
-        PS |= FLAGN;
-    }
+    setcc(CC_LOGIC, 0x8000, uval);
     memwrite16(da, uval);
 }
 
@@ -551,12 +561,18 @@ static void SOB(uint16_t instr)
         o <<= 1;
         // o *= 2;
         R[7] -= o;
+
+        if (o == 4)  // a loop of one instruction, might be copying memory
+        {
+            blockloop(s & 7);
+        }
     }
 }
 
 // Clear
 static void CLR(uint16_t instr)
 {
+    flags();
     // 0c050DD where c is 0/1 depending on if register
 
     const uint8_t d = instr & 077;
@@ -574,6 +590,7 @@ static void CLR(uint16_t instr)
 // 1s Compliment
 static void COM(uint16_t instr)
 {
+    flags();
     uint8_t d = instr & 077;
     uint8_t s = (instr & 07700) >> 6;
     uint8_t l = 2 - (instr >> 15);
@@ -600,12 +617,7 @@ static void INC(uint16_t instr)
     uint16_t max = l == 2 ? 0xFFFF : 0xff;
     uint16_t da = aget(d, l);
     uint16_t uval = (memread(da, l) + 1) & max;
-    PS &= 0xFFF1;
-    if (uval & msb)
-    {
-        PS |= FLAGN | FLAGV;
-    }
-    setZ(uval == 0);
+    setcc(CC_INC, msb, uval);
     memwrite(da, l, uval);
 }
 
@@ -616,25 +628,16 @@ static void _DEC(uint16_t instr)
     uint8_t l = 2 - (instr >> 15);
     uint16_t msb = l == 2 ? 0x8000 : 0x80;
     uint16_t max = l == 2 ? 0xFFFF : 0xff;
-    uint16_t maxp = l == 2 ? 0x7FFF : 0x7f;
     uint16_t da = aget(d, l);
     uint16_t uval = (memread(da, l) - 1) & max;
-    PS &= 0xFFF1;
-    if (uval & msb)
-    {
-        PS |= FLAGN;
-    }
-    if (uval == maxp)
-    {
-        PS |= FLAGV;
-    }
-    setZ(uval == 0);
+    setcc(CC_DEC, msb, uval);
     memwrite(da, l, uval);
 }
 
 // 2s Compliment
 static void NEG(uint16_t instr)
 {
+    flags();
     uint8_t d = instr & 077;
     uint8_t l = 2 - (instr >> 15);
     uint16_t msb = l == 2 ? 0x8000 : 0x80;
@@ -664,6 +667,7 @@ static void NEG(uint16_t instr)
 // Add with carry
 static void _ADC(uint16_t instr)
 {
+    flags();
     uint8_t d = instr & 077;
     uint8_t l = 2 - (instr >> 15);
     uint16_t msb = l == 2 ? 0x8000 : 0x80;
@@ -702,6 +706,7 @@ static void _ADC(uint16_t instr)
 // Subtract with carry
 static void SBC(uint16_t instr)
 {
+    flags();
     uint8_t d = instr & 077;
     uint8_t l = 2 - (instr >> 15);
     uint16_t msb = l == 2 ? 0x8000 : 0x80;
@@ -749,17 +754,13 @@ static void TST(uint16_t instr)
     uint8_t l = 2 - (instr >> 15);
     uint16_t msb = l == 2 ? 0x8000 : 0x80;
     uint16_t uval = memread(aget(d, l), l);
-    PS &= 0xFFF0;
-    if (uval & msb)
-    {
-        PS |= FLAGN;
-    }
-    setZ(uval == 0);
+    setcc(CC_TST, msb, uval);
 }
 
 // Rotate right
 static void ROR(uint16_t instr)
 {
+    flags();
     uint8_t d = instr & 077;
     uint8_t l = 2 - (instr >> 15);
     int32_t max = l == 2 ? 0xFFFF : 0xff;
@@ -791,6 +792,7 @@ static void ROR(uint16_t instr)
 // Rotate left
 static void ROL(uint16_t instr)
 {
+    flags();
     uint8_t d = instr & 077;
     uint8_t l = 2 - (instr >> 15);
     uint16_t msb = l == 2 ? 0x8000 : 0x80;
@@ -822,6 +824,7 @@ static void ROL(uint16_t instr)
 // Arith shift right
 static void ASR(uint16_t instr)
 {
+    flags();
     uint8_t d = instr & 077;
     uint8_t l = 2 - (instr >> 15);
     uint16_t msb = l == 2 ? 0x8000 : 0x80;
@@ -848,6 +851,7 @@ static void ASR(uint16_t instr)
 // Arith shift left
 static void ASL(uint16_t instr)
 {
+    flags();
     uint8_t d = instr & 077;
     uint8_t l = 2 - (instr >> 15);
     uint16_t msb = l == 2 ? 0x8000 : 0x80;
@@ -876,6 +880,7 @@ static void ASL(uint16_t instr)
 // Sign extend
 static void SXT(uint16_t instr)
 {
+    flags();
     uint8_t d = instr & 077;
     uint8_t l = 2 - (instr >> 15);
     uint16_t max = l == 2 ? 0xFFFF : 0xff;
@@ -911,6 +916,7 @@ static void JMP(uint16_t instr)
 // Swap bytes
 static void SWAB(uint16_t instr)
 {
+    flags();
     uint8_t d = instr & 077;
     uint8_t l = 2 - (instr >> 15);
     uint16_t da = aget(d, l);
@@ -944,6 +950,7 @@ static void RTS(uint16_t instr)
 // Trap (regular, emulator, breakpoint, and IO)
 static void EMTX(uint16_t instr)
 {
+    flags();
     uint16_t uval;
     if ((instr & 0177400) == 0104000)
     {
@@ -969,11 +976,13 @@ static void EMTX(uint16_t instr)
     PS = dd11::read16(uval + 2);
     PS |= (curuser << 14);
     PS |= (prevuser << 12);
+    switchset();
 }
 
 // Return from interrupt
 static void RTT(uint16_t instr)
 {
+    flags();
     R[7] = pop();
     uint16_t uval = pop();
     if (curuser)
@@ -981,7 +990,7 @@ static void RTT(uint16_t instr)
         uval &= 047;
         uval |= PS & 0177730;
     }
-    dd11::write16(0777776, uval);
+    dd11::write16(IOPAGE(DEV_CPU_STAT), uval);
 }
 
 // Reset processor
@@ -993,6 +1002,12 @@ static void RESET(uint16_t instr)
     }
     kl11::reset();
     rk11::reset();
+#if DL_TTYS
+    dl11::reset();
+#endif
+#if USE_DH
+    dh11::reset();
+#endif
 }
 
 // Move
@@ -1005,16 +1020,7 @@ static void MOV(uint16_t instr)
     uint16_t sa = aget(s, l);
     uint16_t uval = memread(sa, l);
     uint16_t da = aget(d, l);
-
-    PS &= 0xFFF1;
-    if (uval & msb)
-    {
-        PS |= FLAGN;
-    }
-    if (uval == 0)
-    {
-        PS |= FLAGZ;
-    }
+    setcc(CC_LOGIC, msb, uval);
 
     if ((isReg(da)) && (l == 1))
     {
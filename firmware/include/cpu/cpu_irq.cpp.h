@@ -71,6 +71,7 @@ void trapat(uint16_t vec)
                panic(t)
            }
    */
+    flags();
     uint16_t prev = PS;
     switchmode(0);
     push(prev);
@@ -80,10 +81,11 @@ void trapat(uint16_t vec)
     PS = dd11::read16(vec + 2);
     PS |= (curuser << 14);
     PS |= (prevuser << 12);
+    switchset();
     waiting = false;
 }
 
-void interrupt(uint8_t vec, uint8_t pri)
+void interrupt(uint16_t vec, uint8_t pri)
 {
     if (vec & 1)
     {
@@ -101,6 +103,13 @@ void interrupt(uint8_t vec, uint8_t pri)
         return;
     }
     uint8_t i;
+    for (i = 0; i < ITABN && itab[i].vec; i++)
+    {
+        if (itab[i].vec == vec)
+        {
+            return;  // already asking, a request is a level not an edge
+        }
+    }
     for (i = 0; i < ITABN; i++)
     {
         if ((itab[i].vec == 0) || (itab[i].pri < pri))
@@ -124,7 +133,7 @@ void interrupt(uint8_t vec, uint8_t pri)
         panic();
     }
     uint8_t j;
-    for (j = i + 1; j < ITABN; j++)
+    for (j = ITABN - 1; j > i; j--)
     {
         itab[j] = itab[j - 1];
     }
@@ -146,7 +155,7 @@ static void popirq()
 
 void handleinterrupt()
 {
-    uint8_t vec = itab[0].vec;
+    uint16_t vec = itab[0].vec;
     if (DEBUG_INTER)
     {
         if (PRINTSIMLINES)
@@ -158,6 +167,7 @@ void handleinterrupt()
     uint16_t vv = setjmp(trapbuf);
     if (vv == 0)
     {
+        flags();
         uint16_t prev = PS;
         switchmode(0);
         push(prev);
@@ -172,6 +182,7 @@ void handleinterrupt()
     PS = dd11::read16(vec + 2);
     PS |= (curuser << 14);
     PS |= (prevuser << 12);
+    switchset();
     waiting = false;
     popirq();
 }
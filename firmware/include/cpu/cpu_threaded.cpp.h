@@ -0,0 +1,419 @@
+/*
+Modified BSD License
+
+Copyright (c) 2021 Chloe Lunn
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Threaded core used by run() in kb11 and kd11 when THREADED_CORE is set
+//
+// Instead of returning to loop0 after every instruction, run() goes straight
+// on to the next one with a computed goto from the end of each instruction,
+// so each instruction has its own indirect jump for the branch predictor to
+// learn. It only stops for loop0 after a control flow instruction (branch,
+// jump, trap, ...), a write to the I/O page (which can start a device or
+// raise an interrupt), or when it reaches limit, the number of instructions
+// loop0 can run before a device needs polling.
+//
+// Pairs of instructions that often run one after the other (FUSED_OPS) get an
+// op of their own when they're in the decode cache, which runs the first and
+// then jumps straight to the second, without going through the MMU or the
+// indirect jump to fetch it.
+//
+// The loop itself is runmap(), with a copy for each way the PC can be mapped:
+// MMU off, and MMU on in kernel or user mode. run() picks the one for the
+// state it starts in, and each has its own translation inlined into the fetch.
+
+#if !H_CPU_THREADED
+#define H_CPU_THREADED 1
+
+// Instructions which carry straight on to the next
+#define STRAIGHT_OPS(X) \
+    X(MOV)              \
+    X(CMP)              \
+    X(BIT)              \
+    X(BIC)              \
+    X(BIS)              \
+    X(ADD)              \
+    X(SUB)              \
+    X(MUL)              \
+    X(DIV)              \
+    X(ASH)              \
+    X(ASHC)             \
+    X(XOR)              \
+    X(CLR)              \
+    X(COM)              \
+    X(INC)              \
+    X(_DEC)             \
+    X(NEG)              \
+    X(_ADC)             \
+    X(SBC)              \
+    X(TST)              \
+    X(ROR)              \
+    X(ROL)              \
+    X(ASR)              \
+    X(ASL)              \
+    X(SWAB)             \
+    X(SXT)              \
+    X(CCOP)             \
+    X(NOP)              \
+    X(MFPI)             \
+    X(MTPI)             \
+    X(MFPD)             \
+    X(MTPD)             \
+    FP_OPS(X)           \
+    FIS_OPS(X)
+
+#if USE_FP
+#define FP_OPS(X) X(FPP)
+#else
+#define FP_OPS(X)
+#endif
+
+#if USE_FIS
+#define FIS_OPS(X) \
+    X(FADD)        \
+    X(FMUL)        \
+    X(FDIV)
+#else
+#define FIS_OPS(X)
+#endif
+
+// Instructions which go back to loop0 afterwards
+#define FLOW_OPS(X) \
+    X(BR)           \
+    X(BNE)          \
+    X(BEQ)          \
+    X(BGE)          \
+    X(BLT)          \
+    X(BGT)          \
+    X(BLE)          \
+    X(BPL)          \
+    X(BMI)          \
+    X(BHI)          \
+    X(BLOS)         \
+    X(BVC)          \
+    X(BVS)          \
+    X(BCC)          \
+    X(BCS)          \
+    X(SOB)          \
+    X(JMP)          \
+    X(JSR)          \
+    X(RTS)          \
+    X(MARK)         \
+    X(EMTX)         \
+    X(RTT)          \
+    X(SPL)          \
+    X(RESET)        \
+    X(_WAIT)        \
+    X(_HALT)        \
+    X(UNOP)
+
+// Pairs of instructions which get fused, from cpu_fused.h, which
+// host/fused_ops.sh writes from a run with PAIR_STATS
+#if DECODE_CACHE && !PAIR_STATS
+#include "./cpu/cpu_fused.h"
+#else
+#define FUSED_OPS(X)
+#endif
+
+#define OP_ENUM(fn) OP_##fn,
+#define OP_FUSED_ENUM(first, second) OP_##first##_##second,
+enum
+{
+    STRAIGHT_OPS(OP_ENUM)
+    FLOW_OPS(OP_ENUM)
+    FUSED_OPS(OP_FUSED_ENUM)
+    OP_COUNT
+};
+#undef OP_ENUM
+#undef OP_FUSED_ENUM
+
+#if PAIR_STATS
+// how often each op ran straight after each other op, see pairstats()
+static PERMACHINE uint32_t pairs[OP_COUNT][OP_COUNT];
+static PERMACHINE uint8_t last_op = OP_UNOP;
+
+#define OP_NAME(fn) #fn,
+static const char* const op_names[] = {STRAIGHT_OPS(OP_NAME) FLOW_OPS(OP_NAME)};
+#undef OP_NAME
+
+// print the most common pairs, in the form FUSED_OPS takes
+void pairstats()
+{
+    Serial.println(F("%% most common instruction pairs:"));
+    for (uint8_t n = 0; n < 24; n++)
+    {
+        uint32_t most = 0;
+        uint8_t first = 0, second = 0;
+        for (uint8_t i = 0; i < OP_COUNT; i++)
+        {
+            for (uint8_t j = 0; j < OP_COUNT; j++)
+            {
+                if (pairs[i][j] > most)
+                {
+                    most = pairs[i][j];
+                    first = i;
+                    second = j;
+                }
+            }
+        }
+        if (!most)
+            break;
+        _printf("%%%%     X(%s, %s) // %lu\r\n", op_names[first], op_names[second], (unsigned long)most);
+        pairs[first][second] = 0;
+    }
+}
+#endif
+
+// decode_op returns the op for an instruction, using the same table as step()
+static uint8_t decode_op(const uint16_t instr)
+{
+#define EXEC(fn) return OP_##fn
+#undef H_CPU_JMP_TAB
+#include "./cpu/cpu_jmp_tab.cpp.h"
+#undef EXEC
+    return OP_UNOP;
+}
+
+#if DECODE_CACHE
+// bytes taken by the address mode in spec, or -1 if it changes the PC
+static int8_t operand_len(const uint8_t spec)
+{
+    const uint8_t mode = spec >> 3;
+    if (mode >= 6)
+    {
+        return 2;  // index word
+    }
+    if ((spec & 7) == 7)
+    {
+        return (mode == 2 || mode == 3) ? 2 : -1;  // immediate or absolute
+    }
+    return 0;
+}
+
+// op to keep in the decode cache for instr at pa, which is a fused op if the
+// next instruction makes one of the FUSED_OPS pairs with it. The next
+// instruction has to be in the same 64 byte block as this one, so that
+// whichever virtual address pa is run from, it is at the next virtual
+// address, with the same access.
+static uint8_t fuse(const uint8_t op, const uint16_t instr, const uint32_t pa)
+{
+    const int8_t dst = operand_len(instr & 077);
+    int8_t src = 0;
+    if (op == OP_MOV || op == OP_CMP || op == OP_BIT || op == OP_BIC || op == OP_BIS || op == OP_ADD || op == OP_SUB)
+    {
+        src = operand_len((instr >> 6) & 077);
+    }
+    const uint8_t len = 2 + src + dst;
+    if (src < 0 || dst < 0 || (pa & 077) + len >= 0100)
+    {
+        return op;
+    }
+    const uint8_t next = decode_op(dd11::read16(pa + len));
+#define FUSE(first, second)                           \
+    if (op == OP_##first && next == OP_##second)      \
+    {                                                 \
+        return OP_##first##_##second;                 \
+    }
+    FUSED_OPS(FUSE)
+#undef FUSE
+    return op;
+}
+#endif
+
+PERMACHINE uint16_t ran;
+
+// How runmap() maps the PC to fetch instructions, picked by run() when it
+// starts. Nothing it runs can turn the MMU on or off or change the mode
+// without it stopping: those take a write to the I/O page, a trap or a
+// control flow instruction.
+enum
+{
+    MAP_OFF,     // MMU disabled, so below the I/O page virtual is physical
+    MAP_KERNEL,  // MMU enabled in kernel mode
+    MAP_USER,    // MMU enabled in user mode
+    MAP_ANY,     // anything else, mapped the general way
+};
+
+// physical address of the instruction at the PC
+template <uint8_t map>
+static inline uint32_t pcaddr()
+{
+    const uint16_t a = R[7];
+    if (map == MAP_OFF && a < 0170000)
+    {
+        return a;
+    }
+    if (map == MAP_KERNEL || map == MAP_USER)
+    {
+        const uint32_t pa = kt11::fastword(a, false, (map == MAP_KERNEL) ? 0 : 3);
+        if (pa != NO_SPAN)
+        {
+            return pa;
+        }
+    }
+    return kt11::decode_instr(a, false, curuser);
+}
+
+// run instructions until one changes the flow, or limit have been run
+template <uint8_t map>
+static void runmap(const uint16_t limit)
+{
+#define OP_LABEL(fn) &&do_##fn,
+#define OP_FUSED_LABEL(first, second) &&do_##first##_##second,
+    static const void* const ops[] = {STRAIGHT_OPS(OP_LABEL) FLOW_OPS(OP_LABEL) FUSED_OPS(OP_FUSED_LABEL)};
+#undef OP_LABEL
+#undef OP_FUSED_LABEL
+
+    uint16_t instr;
+    uint8_t op;
+
+    ran = 0;
+    if (waiting)
+        return;
+
+    dd11::iowrite = false;
+
+#if DECODE_CACHE
+    uint32_t pa;  // of the instruction being run
+
+#define FETCH()                                                             \
+    {                                                                       \
+        pa = pcaddr<map>();                                                 \
+        decoded& d = dcache[(pa >> 1) & (DECODE_CACHE - 1)];                \
+        if (d.pa == pa)                                                     \
+        {                                                                   \
+            instr = d.instr;                                                \
+            op = d.op;                                                      \
+        }                                                                   \
+        else                                                                \
+        {                                                                   \
+            instr = dd11::read16(pa);                                       \
+            op = decode_op(instr);                                          \
+            if (pa < MAX_RAM_ADDRESS) /* only writes to ram invalidate */   \
+            {                                                               \
+                op = fuse(op, instr, pa);                                   \
+                d.pa = pa;                                                  \
+                d.instr = instr;                                            \
+                d.fn = decode(instr);                                       \
+                d.op = op;                                                  \
+            }                                                               \
+        }                                                                   \
+    }
+#else
+#define FETCH()                                                             \
+    {                                                                       \
+        instr = dd11::read16(pcaddr<map>());                                \
+        op = decode_op(instr);                                              \
+    }
+#endif
+
+#if PAIR_STATS
+#define COUNT_PAIR()                \
+    {                               \
+        pairs[last_op][op]++;       \
+        last_op = op;               \
+    }
+#else
+#define COUNT_PAIR()
+#endif
+
+#define DISPATCH()        \
+    {                     \
+        debug_step();     \
+        curPC = R[7];     \
+        FETCH();          \
+        R[7] += 2;        \
+        debug_print();    \
+        ran++;            \
+        COUNT_PAIR();     \
+        goto *ops[op];    \
+    }
+
+    DISPATCH();
+
+#define OP_STRAIGHT(fn)                        \
+    do_##fn : fn(instr);                       \
+    if (ran == limit || dd11::iowrite)         \
+        return;                                \
+    DISPATCH();
+
+#define OP_FLOW(fn)  \
+    do_##fn : fn(instr); \
+    return;
+
+// the second instruction is taken from the decode cache entry for the address
+// after the first, the same as FETCH() would, which also means a first that
+// wrote over it can't run a stale copy
+#define OP_FUSED(first, second)                                        \
+    do_##first##_##second : first(instr);                              \
+    if (ran == limit || dd11::iowrite)                                 \
+        return;                                                        \
+    {                                                                  \
+        pa += (uint16_t)(R[7] - curPC);                                \
+        const decoded& n = dcache[(pa >> 1) & (DECODE_CACHE - 1)];     \
+        if (n.pa != pa)                                                \
+            DISPATCH();                                                \
+        debug_step();                                                  \
+        curPC = R[7];                                                  \
+        instr = n.instr;                                               \
+        op = n.op;                                                     \
+        R[7] += 2;                                                     \
+        debug_print();                                                 \
+        ran++;                                                         \
+        if (op == OP_##second)                                         \
+            goto do_##second;                                          \
+        goto *ops[op];                                                 \
+    }
+
+    STRAIGHT_OPS(OP_STRAIGHT)
+    FLOW_OPS(OP_FLOW)
+    FUSED_OPS(OP_FUSED)
+
+#undef OP_STRAIGHT
+#undef OP_FLOW
+#undef OP_FUSED
+#undef DISPATCH
+#undef COUNT_PAIR
+#undef FETCH
+}
+
+void run(const uint16_t limit)
+{
+    if (!(kt11::SR0 & 1))
+        runmap<MAP_OFF>(limit);
+    else if (curuser == 0)
+        runmap<MAP_KERNEL>(limit);
+    else if (curuser == 3)
+        runmap<MAP_USER>(limit);
+    else
+        runmap<MAP_ANY>(limit);
+}
+
+#endif
@@ -85,8 +85,18 @@ union addr {
     uint32_t value;
 };
 
+extern PERMACHINE bool iowrite;  // set by every write to the I/O page
+
 uint16_t read8(uint32_t addr);
 uint16_t read16(uint32_t addr);
 void write8(uint32_t a, uint16_t v);
 void write16(uint32_t a, uint16_t v);
+
+// NPR transfers for the block devices, between words at the 18 bit UNIBUS
+// address a and the device's buffer. Runs of ram are copied in one go, and
+// anything else goes a word at a time through the I/O page. Rather than
+// trapping, they stop at the first word with nothing there and return how
+// many words were moved, so the device can flag non-existent memory.
+uint16_t dmaread(uint32_t a, uint16_t* buf, uint16_t words);
+uint16_t dmawrite(uint32_t a, const uint16_t* buf, uint16_t words);
 };  // namespace dd11
@@ -0,0 +1,85 @@
+/*
+Modified BSD License
+
+Copyright (c) 2021 Chloe Lunn
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// sam11 software emulation of DEC PDP-11 DH11 16 line serial multiplexer
+#include "pdp1140.h"
+
+#if USE_DH
+
+#if SNAPSHOTS
+#include <SdFat.h>
+#endif
+
+/* DH11 - 16 Line Asynchronous Serial Multiplexer
+ * ===============================================
+ *
+ * Where a DL11 interrupts once for every character sent, each DH11 line is
+ * given an address and a byte count and sends the whole buffer out of memory
+ * by DMA, with one transmit interrupt when it's done. The program picks the
+ * line with the low bits of the system control register, loads its current
+ * address and (negative) byte count, and sets its bit in the buffer active
+ * register. BAR bits clear as the lines finish.
+ *
+ * Characters received on any line go into one 64 character silo, tagged with
+ * the line number, and are read out a character at a time from NRCR. The
+ * receive interrupt comes when there's anything in the silo, or with the silo
+ * interrupt enabled, when there's more in it than the alarm level in SSR.
+ *
+ * The lines are connected to the board's serial ports after the DL11 lines'
+ * (TTY_PORTS in platform.h). There's no DM11 modem control, so the lines
+ * always look connected.
+ */
+
+namespace dh11 {
+
+enum
+{
+    BAUD_DEFAULT = 9600,  // the fastest of the DH11's standard speeds
+};
+
+void begin(void);
+void write16(uint32_t a, uint16_t v);
+uint16_t read16(uint32_t a);
+uint16_t peek16(uint32_t a);
+void reset();
+void poll();
+bool idle();
+uint16_t quiet();
+void skip(uint16_t n);
+
+#if SNAPSHOTS
+void snapshot(SdFile& f, bool save);
+#endif
+
+};  // namespace dh11
+
+#endif
@@ -30,11 +30,21 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-// sam11 software emulation of DEC PDP-11/40 KL11 Main TTY
+// sam11 software emulation of DEC PDP-11/40 DL11 serial lines
 #include "pdp1140.h"
 
 #if DL_TTYS
 
+#if SNAPSHOTS
+#include <SdFat.h>
+#endif
+
+#if DL_LINES > 16
+#error THE DL11 REGISTERS ONLY HAVE ROOM FOR 16 LINES
+#endif
+
+#define DL_END (DEV_DL_1_TTY_IN_STATUS + 010 * DL_LINES)  // just past the last line's registers
+
 namespace dl11 {
 
 enum
@@ -46,14 +56,25 @@ enum
     BAUD_600 = 600,    // REV D
     BAUD_1200 = 1200,  // REV E
     BAUD_2400 = 2400,  // REV F
-    BAUD_DEFAULT = BAUD_2400,
+    BAUD_4800 = 4800,  // DL11-W
+    BAUD_9600 = 9600,  // DL11-W
+    BAUD_DEFAULT = BAUD_9600,
 };
 
 void begin(void);
 void write16(uint32_t a, uint16_t v);
+void write8(uint32_t a, uint16_t v);
 uint16_t read16(uint32_t a);
-void clearterminal(uint8_t t);
-void poll(uint8_t t);
+uint16_t peek16(uint32_t a);
+void reset();
+void poll();
+bool idle();
+uint16_t quiet();
+void skip(uint16_t n);
+
+#if SNAPSHOTS
+void snapshot(SdFile& f, bool save);
+#endif
 
 };  // namespace dl11
 
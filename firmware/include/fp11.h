@@ -34,59 +34,54 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "pdp1140.h"
 
+#if SNAPSHOTS
+#include <SdFat.h>
+#endif
+
 #if USE_FP
 
 namespace fp11 {
 
+// Floating Exception Codes, left in FEC by an error
 enum
 {
-    ERRNOP = 002,    // No OP
+    ERROP = 002,     // op code error
+    ERRDIV = 004,    // divide by zero
+    ERRCONV = 006,   // integer conversion error
     ERROVER = 010,   // overflow
     ERRUNDER = 012,  // underflow
-}
+    ERRUNDEF = 014,  // undefined variable (-0)
+};
 
+// Floating Point Status bits
 enum
 {
-    signmask = 0100000,
-    expbias = 0200,
-    expmask = 077600,
-    expshift = 07,
-    hiddenmask = 0200,
-    fractionmask = 0177,
-    wordcount = 4,
-    wordbase = 0200000,
-    wordmask = 0177777,
-    wordbits = 16,
-}
-
-extern uint32_t PC;        // Program Counter
-extern uint16_t FEA;       // Error PC
-extern uint16_t FEC;       // Error code
-extern uint16_t FPS;       // Status/Error bits
-extern uint8_t modelen;    // Num words in instruction: 1 = immediate, 2 = real, 4 = double
-extern uint8_t precislen;  // Num words in number: 2 = real, 4 = double
-extern uint32_t res[8];    // Results/Working registers (actually 7)
-extern uint32_t SCR;       // Scratchpad -> 2x 16-bits to make a 32-bit number
-extern uint32_t AC[6];     // Accumilator Registers
-
-void zero(uint32_t* number);
-void test(uint32_t* number);
-void trap(int err);
-void copy(uint32_t* number, uint32_t* operand);
-void testI(uint32_t* number);
-void pack(uint32_t* number, uint32_t exponent, uint8_t sign);
-
-uint32_t aget(uint32_t instr, uint8_t l);
-
-int modF(uint32_t* number);
-
-int writeF(uint32_t a, uint32_t v);
-uint32_t readF(uint32_t a, uint32_t v);
-
-int write16(uint32_t a, uint16_t v);
-uint16_t read16(uint32_t a);
-
-int step(uint32_t instr);
+    FER = 0100000,  // error
+    FID = 040000,   // interrupt disable
+    FIUV = 04000,   // interrupt on undefined variable
+    FIU = 02000,    // interrupt on underflow
+    FIV = 01000,    // interrupt on overflow
+    FIC = 0400,     // interrupt on integer conversion error
+    FD = 0200,      // double precision mode
+    FL = 0100,      // long integer mode
+    FT = 040,       // truncate mode
+    FN = 010,
+    FZ = 004,
+    FV = 002,
+    FC = 001
+};
+
+extern PERMACHINE uint16_t FPS;    // Status
+extern PERMACHINE uint16_t FEC;    // Exception code
+extern PERMACHINE uint16_t FEA;    // Exception address
+extern PERMACHINE uint64_t AC[6];  // Accumulators, in D format; F format is the top 32 bits
+
+void reset();
+void step(uint16_t instr);
+
+#if SNAPSHOTS
+void snapshot(SdFile& f, bool save);
+#endif
 
 };  // namespace fp11
 
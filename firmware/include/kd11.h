@@ -35,16 +35,25 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 // this is all kinds of wrong
 #include "pdp1140.h"
+#include "platform.h"
+
+#if SNAPSHOTS
+#include <SdFat.h>
+#endif
 
 #if !USE_11_45 || STRICT_11_40
 
 #include <setjmp.h>
 
-extern jmp_buf trapbuf;
+extern PERMACHINE jmp_buf trapbuf;
 
-#define ITABN 16
+#if DL_TTYS
+#define ITABN (16 + 2 * DL_LINES + 2 * USE_DH)  // each DL11 line can have both of its interrupts waiting
+#else
+#define ITABN (16 + 2 * USE_DH)
+#endif
 
-extern pdp11::intr itab[ITABN];
+extern PERMACHINE pdp11::intr itab[ITABN];
 
 namespace kd11 {
 
@@ -56,31 +65,64 @@ enum
     FLAGC = 1
 };
 
-//R[2][8];
-extern volatile int32_t R[8];  // R6 = SP, R7 = PC
+extern PERMACHINE volatile int32_t R[8];  // R6 = SP, R7 = PC
+
+extern PERMACHINE volatile uint16_t curPC;      // R7
+extern PERMACHINE volatile uint16_t PS;         // Processor Status
+extern PERMACHINE volatile uint16_t bankSP[4];  // R6 of the other modes, by mode
+extern PERMACHINE volatile uint8_t curuser;     // 0: kernel, 1,2: illegal, 3: user
+extern PERMACHINE volatile uint8_t prevuser;    // 0: kernel, 1,2: illegal, 3: user
+extern PERMACHINE bool trapped;
+extern PERMACHINE bool waiting;   // WAIT instruction, stopped until an interrupt
+extern PERMACHINE bool spinning;  // polling a device status register in a loop
+extern PERMACHINE uint32_t elided;
+extern PERMACHINE bool copying;  // in a loop copying or clearing a block of memory
+
+#if DECODE_CACHE
+typedef void (*handler)(uint16_t instr);
+
+// an instruction in ram that's already been decoded, stored by physical address
+struct decoded {
+    uint32_t pa;
+    uint16_t instr;
+    handler fn;
+#if THREADED_CORE
+    uint8_t op;
+#endif
+};
 
-extern volatile uint16_t curPC;    // R7
-extern volatile uint16_t PS;       // Processor Status
-extern volatile uint16_t USP;      // R6 (user)
-extern volatile uint16_t KSP;      // R6 (kernel)
-extern volatile uint8_t curuser;   // 0: kernel, 1,2: illegal, 3: user
-extern volatile uint8_t prevuser;  // 0: kernel, 1,2: illegal, 3: user
-extern bool trapped;
+extern PERMACHINE decoded dcache[DECODE_CACHE];
+#endif
 
 bool isReg(const uint16_t a);
 void step();
+uint32_t blockrun(uint32_t n);
+
+#if THREADED_CORE
+void run(const uint16_t limit);
+extern PERMACHINE uint16_t ran;  // instructions run by the last run(), including one that trapped
+#if PAIR_STATS
+void pairstats();
+#endif
+#endif
 void reset(void);
 void switchmode(uint8_t newm);
+void switchset();  // after PS is loaded, for the register set it selects
 
 void trapat(uint16_t vec);
-void interrupt(uint8_t vec, uint8_t pri);
+void interrupt(uint16_t vec, uint8_t pri);
 void handleinterrupt();
 
+void flags();  // bring the condition codes in PS up to date
 bool N();
 bool Z();
 bool V();
 bool C();
 
+#if SNAPSHOTS
+void snapshot(SdFile& f, bool save);
+#endif
+
 };  // namespace kd11
 
 #endif
@@ -33,6 +33,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // sam11 software emulation of DEC PDP-11/40 KL11 Main TTY
 #include "pdp1140.h"
 
+#if SNAPSHOTS
+#include <SdFat.h>
+#endif
+
 namespace kl11 {
 
 enum
@@ -52,8 +56,18 @@ enum
 };
 
 void write16(uint32_t a, uint16_t v);
+void write8(uint32_t a, uint16_t v);
 uint16_t read16(uint32_t a);
+uint16_t peek16(uint32_t a);
 void reset();
 void poll();
+void flush();
+bool idle();
+uint16_t quiet();
+void skip(uint16_t n);
+
+#if SNAPSHOTS
+void snapshot(SdFile& f, bool save);
+#endif
 
 };  // namespace kl11
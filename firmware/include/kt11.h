@@ -33,18 +33,89 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // sam11 software emulation of DEC PDP-11/40 KT11 Memory Management Unit (MMU)
 #include "pdp1140.h"
 
+#if SNAPSHOTS
+#include <SdFat.h>
+#endif
+
 namespace kt11 {
 
-extern uint16_t SLR;
+extern PERMACHINE uint16_t SLR;
+
+extern PERMACHINE uint16_t SR0;
+extern PERMACHINE uint16_t SR1;
+extern PERMACHINE uint16_t SR2;
+extern PERMACHINE uint16_t SR3;
+
+#define NO_SPAN (0xFFFFFFFF)
 
-extern uint16_t SR0;
-extern uint16_t SR1;
-extern uint16_t SR2;
-extern uint16_t SR3;
+#define SR3_22BIT (020)  // 22 bit mapping, with 16 bit PARs (USE_22BIT)
+#define SR3_UBMAP (040)  // UNIBUS map relocation of device transfers (USE_22BIT)
 
 uint32_t decode_instr(uint16_t a, bool w, uint8_t user);
 uint32_t decode_data(uint16_t a, bool w, uint8_t user);
+uint32_t span(uint16_t a, uint16_t len, bool w, uint8_t user);
+
+// probe gives the physical address a read of a would go to, the same as
+// decode_instr, or NO_SPAN if it would fault. It never traps, and leaves SR0
+// and SR2 alone, for looking ahead at words the program hasn't read yet.
+uint32_t probe(uint16_t a, uint8_t user);
+
+// Translations of each mode's pages worked out ahead of time, for fastword().
+// A page maps offsets lo..hi to base + offset, only covers ram, and only takes
+// writes once it's been marked written, so using it never has a side effect.
+struct fastpage {
+    uint32_t base;
+    uint16_t lo;
+    uint16_t hi;  // lo > hi if none of the page can be used
+    bool write;
+};
+
+extern PERMACHINE fastpage fast[4][8];
+extern PERMACHINE bool fast_ok;  // cleared when the MMU registers change
+extern PERMACHINE bool fast_on;  // MMU enabled when fast was filled in
+void fill_fast();
+
+// fastword gives the physical address of the word at a, the same as
+// decode_instr, if it's in ram and the access needs nothing more than the
+// address, or NO_SPAN if it has to go the slow way (odd address, a fault,
+// the I/O page, the first write to a page). It never traps. It's here rather
+// than in kt11.cpp so that the cpu's memory accesses get it inlined.
+static inline uint32_t fastword(const uint16_t a, const bool w, const uint8_t user)
+{
+#if KY_PANEL
+    return NO_SPAN;  // the panel has to see every access
+#else
+    if (!fast_ok || fast_on != (SR0 & 1))
+    {
+        fill_fast();
+    }
+    const fastpage& f = fast[user][a >> 13];
+    const uint16_t off = a & 017777;
+    if ((a & 1) || off < f.lo || off > f.hi || (w && !f.write))
+    {
+        return NO_SPAN;
+    }
+    return f.base + off;
+#endif
+}
+
+// unibus gives the physical address that a device doing DMA to the 18 bit
+// UNIBUS address a reaches, through the UNIBUS map when SR3 turns it on.
+#if USE_22BIT
+extern PERMACHINE uint32_t ubmap[31];  // 22 bit address each 8KB of the UNIBUS is relocated to
+uint32_t unibus(uint32_t a);
+#else
+static inline uint32_t unibus(const uint32_t a)
+{
+    return a;  // UNIBUS addresses are physical ones
+}
+#endif
+
 uint16_t read16(uint32_t a);
 void write16(uint32_t a, uint16_t v);
 
+#if SNAPSHOTS
+void snapshot(SdFile& f, bool save);
+#endif
+
 };  // namespace kt11
@@ -33,13 +33,24 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // sam11 software emulation of DEC PDP-11/40 KW11 Line Clock
 #include "pdp1140.h"
 
+#if SNAPSHOTS
+#include <SdFat.h>
+#endif
+
 #define LKS_FREQ      (60)     // 60Hz or 50Hz
 #define LKS_PERIOD_MS (16)     // 16ms or 20ms
 #define LKS_PERIOD_US (16595)  // 16666us or 20000us <- this is not technically 60Hz, but slightly faster, however it gives more accurate clock times in OSes
 
 namespace kw11 {
 
-extern uint16_t LKS;
+extern PERMACHINE uint16_t LKS;
 void reset();
 void tick();
+bool idle();
+uint16_t quiet();
+void skip(uint16_t n);
+
+#if SNAPSHOTS
+void snapshot(SdFile& f, bool save);
+#endif
 };  // namespace kw11
@@ -46,10 +46,10 @@ enum
     sw_showDR = 0100,
 };
 
-extern uint32_t SR;
-extern uint16_t DR;
-extern uint16_t CSR;
-extern uint16_t SLR;
+extern PERMACHINE uint32_t SR;
+extern PERMACHINE uint16_t DR;
+extern PERMACHINE uint16_t CSR;
+extern PERMACHINE uint16_t SLR;
 void step();
 void reset();
 uint16_t read16(uint32_t addr);
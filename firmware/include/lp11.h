@@ -34,6 +34,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "pdp1140.h"
 
+#if SNAPSHOTS
+#include <SdFat.h>
+#endif
+
 #if USE_LP
 
 namespace lp11 {
@@ -41,6 +45,14 @@ void poll();
 void reset();
 uint16_t read16(uint32_t a);
 void write16(uint32_t a, uint16_t v);
+void write8(uint32_t a, uint16_t v);
+bool idle();
+uint16_t quiet();
+void skip(uint16_t n);
+
+#if SNAPSHOTS
+void snapshot(SdFile& f, bool save);
+#endif
 };  // namespace lp11
 
 #endif
@@ -32,7 +32,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
 // sam11 software emulation of DEC PDP-11/40  MS11-MB Silicon Memory
-// 256KiB/128KiW, but system can only access up to 248KiB/124KiW
+// 256KiB/128KiW, but system can only access up to 248KiB/124KiW (4MiB less the I/O page with USE_22BIT)
 #include "pdp1140.h"
 #include "platform.h"
 #include <SdFat.h>
@@ -52,14 +52,49 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
  */
 
+#define MS11_PAGE_SHIFT (13)  // 8KiB pages, the same size as a KT11 page
+#define MS11_PAGE_SIZE  (1 << MS11_PAGE_SHIFT)
+#define MS11_PAGES      ((MAX_RAM_ADDRESS + MS11_PAGE_SIZE - 1) >> MS11_PAGE_SHIFT)
+
 namespace ms11 {
 #if RAM_MODE == RAM_SWAPFILE
-extern SdFile msdata;
+extern PERMACHINE SdFile msdata;
+#endif
+
+#if USE_CKPT || USE_FORK
+// One bit per page, set on every write so that checkpoints only save what
+// changed, or with USE_FORK, so that only the first write to a page since it
+// was shared has to see if it needs copying
+extern PERMACHINE uint32_t dirty[(MS11_PAGES + 31) / 32];
+
+void clean();
+void soil();
+bool is_dirty(uint16_t page);
 #endif
+
+#if RAM_MODE == RAM_COW
+// The memory is MS11_PAGES pointers to pages, which machines share until one
+// of them writes to a page, when it gets a copy of its own (ram_cow.cpp.h).
+struct page;
+
+// fill in table with this machine's pages, now shared with the table
+void share(page** table);
+// make this machine's memory the pages in table, shared with it
+void adopt(page* const* table);
+// let go of the pages in table, e.g. a machine's own once it's done with
+void release(page** table);
+// and this machine's own
+void end();
+#endif
+
 void begin();
 void clear();
 uint16_t read8(uint32_t a);
 void write8(uint32_t a, uint16_t v);
 void write16(uint32_t a, uint16_t v);
 uint16_t read16(uint32_t a);
+void copy16(uint32_t dst, uint32_t src, uint16_t words);
+void fill16(uint32_t dst, uint16_t v, uint16_t words);
+void readblock16(uint32_t src, uint16_t* buf, uint16_t words);
+void writeblock16(uint32_t dst, const uint16_t* buf, uint16_t words);
 };  // namespace ms11
@@ -37,7 +37,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #if USE_PC
 
 namespace pc11 {
-uint16_t RS, RB, PS, PB;
+PERMACHINE uint16_t RS, RB, PS, PB;
 uint16_t read16(uint32_t a);
 };  // namespace pc11
 
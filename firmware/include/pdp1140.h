@@ -84,9 +84,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * BB11         (alias for DL11 type BB?)
  * DC11         Serial (async) Line Controller
  * DD11     Y   UNIBUS Backplane
- * DH11         Serial (async) Line Controller
+ * DH11     P   Serial (async) 16 Line Multiplexer (no DM11 modem control)
  * DJ11         Serial (async) Line Controller
- * DL11     +   Serial (async) Line Controller <- this is the one you add to expand the no. TTYs
+ * DL11     Y   Serial (async) Line Controller <- this is the one you add to expand the no. TTYs
  * DM11         Serial (async) Line Controller
  * DQ11         Serial (NPR sync) Line Controller
  * DR11         Parallel Controller
@@ -150,9 +150,11 @@ namespace pdp11 {
 
 #define KY_PANEL false  // The ky11 front panel will still kinda work without this, but with it changes it to run all bus functions into it, which slows down bus r/w access
 #define DL_TTYS  false  // DL11 TTY Console connectors
+#define DL_LINES 4      // how many DL11 lines, up to 16, connected to the board's serial ports in turn (TTY_PORTS in platform.h)
+#define USE_DH   false  // DH11 16 line multiplexer with DMA output, connected to the serial ports after the DL11 lines'
 
-#define USE_FP              false  // WIP - enable the FP11 Floating point  }_ These are different ways of adding floating point, they have different formats and instructions
-#define USE_FIS             false  // WIP - enable the FIS Floating point   }  FIS is not actually implemented, it just disables NOP traps
+#define USE_FP              false  // enable the FP11 Floating point        }_ These are different ways of adding floating point, they have different formats and instructions
+#define USE_FIS             false  // enable the KE11-F FIS Floating point   }  instructions
 #define SUPRESS_UNIX_FP_NOP true   // disable NOPs on fpp calls used by unix v6
 
 #define USE_LP true   // enable the line printer
@@ -161,8 +163,70 @@ namespace pdp11 {
 #define USE_RL false  // WIP - enable RL11 disk drives (e.g. RL02)
 #define USE_TM false  // WIP - enable TM11 mag tape drives (e.g. TU10)
 
+#define USE_22BIT false  // 11/70 style 22 bit addressing: SR3 turns on 22 bit PARs and the UNIBUS map, with the I/O page moved to the top of 4MB (MAX_RAM_ADDRESS is set per board in platform.h)
+
+// The 11/40 has no SR3 to turn 22 bit mapping on with
+#if STRICT_11_40
+#undef USE_22BIT
+#define USE_22BIT false
+#endif
+
+#define USE_CKPT false  // WIP - periodically write incremental checkpoints of ram and device state to the SD card (see ckpt.h)
+
+#define THREADED_CORE false  // run instructions back to back with computed gotos, only returning to the main loop when a device needs it (needs GCC)
+#define PAIR_STATS    false  // count which instructions follow which in the threaded core and print the most common pairs on halt, for redoing FUSED_OPS (host/fused_ops.sh)
+
+#define RR_OFF    (0)  // }
+#define RR_RECORD (1)  //  }- options for USE_RR
+#define RR_REPLAY (2)  // }
+
+#define USE_RR RR_OFF  // record the console, DL11 and DH11 input and clock ticks to the SD card, or replay them, so runs are repeatable (see rr.h)
+
+#define MULTI_MACHINE false  // host build only: all of a machine's state is thread_local (PERMACHINE), so each thread of a process can run a machine of its own (see host/host.h)
+#define USE_FORK      false  // host build only, with MULTI_MACHINE: fork a running machine into clones that share its memory pages and disk blocks copy-on-write (see host/host.h)
+
+// the host build (host/Makefile) changes options above per binary, with #undef and #define
+#ifdef HOST_OPTIONS
+#include HOST_OPTIONS
+#endif
+
+// what a machine's state is declared with, so there can be one per thread
+#if MULTI_MACHINE
+#ifndef SAM11_HOST
+#error MULTI_MACHINE IS ONLY FOR THE HOST BUILD
+#endif
+#if DL_TTYS || USE_DH
+#error THE PTYS ARE SHARED BY THE WHOLE PROCESS, SO MULTI_MACHINE CANNOT HAVE DL11 OR DH11 LINES
+#endif
+#define PERMACHINE thread_local
+#else
+#define PERMACHINE
+#endif
+
+#if USE_FORK
+#if !MULTI_MACHINE
+#error USE_FORK NEEDS MULTI_MACHINE, THE CLONES EACH RUN ON A THREAD OF THEIR OWN
+#endif
+#if USE_CKPT
+#error USE_FORK AND USE_CKPT BOTH KEEP THE DIRTY PAGE BITS, SO THEY CANNOT BE USED TOGETHER
+#endif
+#if USE_RP || USE_RL || USE_TM
+#error ONLY RK11 DISKS ARE SHARED WITH THE CLONES OF A FORK
+#endif
+#endif
+
+// the devices can save and load their state (snapshot()), for checkpoints and forks
+#define SNAPSHOTS (USE_CKPT || USE_FORK)
+
+#if USE_22BIT
+#define IOPAGE_BASE (017760000)  // the I/O page is the top 8KB of the 22 bit address space
+#else
+#define IOPAGE_BASE (0760000)  // the I/O page is the top 8KB of the 18 bit address space
+#endif
+#define IOPAGE(a) ((uint32_t)(a) + IOPAGE_BASE - 0760000)  // physical address of the I/O page register at UNIBUS address a
+
 struct intr {
-    uint8_t vec;
+    uint16_t vec;  // the floating vectors go past 0377
     uint8_t pri;
 };
 };  // namespace pdp11
@@ -568,6 +632,18 @@ enum
     DEV_SUP_INS_PDR_R1 = 0772202,  // MMU Supervisor Instruction PDR Register 1
     DEV_SUP_INS_PDR_R0 = 0772200,  // MMU Supervisor Instruction PDR Register 0
 
+    DEV_UBMAP_R30_HI = 0770372,  // UNIBUS Map Register 30 High
+    DEV_UBMAP_R0_LO = 0770200,   // UNIBUS Map Register 0 Low
+
+    DEV_DH_SSR = 0760036,   // DH11 Silo Status Register
+    DEV_DH_BRK = 0760034,   // DH11 Break Control Register
+    DEV_DH_BAR = 0760032,   // DH11 Buffer Active Register
+    DEV_DH_BCR = 0760030,   // DH11 Byte Count Register
+    DEV_DH_CAR = 0760026,   // DH11 Current Address Register
+    DEV_DH_LPR = 0760024,   // DH11 Line Parameter Register
+    DEV_DH_NRCR = 0760022,  // DH11 Next Received Character Register
+    DEV_DH_SCR = 0760020,   // DH11 System Control Register
+
     DEV_MEMORY = 0760000,  // Main Memory (0->0760000 (excl))
 };
 #endif
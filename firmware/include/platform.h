@@ -42,6 +42,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define RAM_EXTENDED (2)  // Use extended, internal RAM (xmem library for AVRs)
 #define RAM_PARALLEL (3)  // Use Parallel addr/data RAM chips (not implmented)
 #define RAM_SWAPFILE (4)  // Use a file on the SD card as a swap file
+#define RAM_COW      (5)  // Use pages shared copy-on-write with forks of the machine (host build, USE_FORK)
 
 #define LKS_LOW_ACC    (0)  // use elapsedMillis for the LKS tick
 #define LKS_HIGH_ACC   (2)  // use elapsedMicros for the LKS tick
@@ -50,6 +51,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 namespace platform {
 
 void begin();
+void sleep();
 void writeAddr(uint32_t addr);
 void writeData(uint16_t data);
 void writeDispReg(uint16_t disp);
@@ -83,6 +85,8 @@ uint16_t readControlSwitches();
 //#define PIN_OUT_PROC_RUN  (0)
 //#define PIN_OUT_BUS_ACT   (0)
 
+#define TTY_PORTS &Serial1, &Serial2, &Serial3  // serial ports for the DL11 lines, then the DH11 lines, in order
+
 #define LKS_ACC LKS_SHIFT_TICK
 
 //-------------------------------------------------------------------------------------------------
@@ -112,6 +116,8 @@ uint16_t readControlSwitches();
 //#define PIN_OUT_BUS_ACT   (13)
 //#define PIN_OUT_USER_MODE (13)
 
+#define TTY_PORTS &Serial1, &Serial2, &Serial3, &Serial4  // serial ports for the DL11 lines, then the DH11 lines, in order
+
 #define LKS_ACC LKS_HIGH_ACC
 
 //-------------------------------------------------------------------------------------------------
@@ -138,6 +144,8 @@ uint16_t readControlSwitches();
 
 #define DISABLE_PIN_10 (true)
 
+#define TTY_PORTS &Serial1  // serial ports for the DL11 lines, then the DH11 lines, in order
+
 //-------------------------------------------------------------------------------------------------
 
 // Teensy 4.1 and similar -> wayyy fast
@@ -147,16 +155,61 @@ uint16_t readControlSwitches();
 
 #define USE_SDIO true  // use an SDIO interface for cards
 
-#define ALLOW_DISASM    (false)    // allow disassembly (PDP-11) on crash/panic/state prints
+#define ALLOW_DISASM (false)  // allow disassembly (PDP-11) on crash/panic/state prints
+
+#if USE_22BIT
+#define MAX_RAM_ADDRESS (017760000)  // 4MB less the I/O page
+#define RAM_PSRAM       (true)       // too big for the onboard SRAM, so it needs a PSRAM chip soldered on the bottom
+#else
 #define MAX_RAM_ADDRESS (0760000)  // 248KB
+#endif
 
-#define RAM_MODE RAM_INTERNAL  // use the chip's onboard SRAM
+#define RAM_MODE RAM_INTERNAL  // use the chip's onboard SRAM (or the PSRAM, with RAM_PSRAM)
+
+#define DECODE_CACHE (4096)  // instructions to keep decoded (must be a power of 2), 0 to disable
 
 #define LED_ON  (HIGH)
 #define LED_OFF (LOW)
 
 #define PIN_OUT_DISK_ACT (13)
 
+#define TTY_PORTS &Serial1, &Serial2, &Serial3, &Serial4, &Serial5, &Serial6, &Serial7, &Serial8  // serial ports for the DL11 lines, then the DH11 lines, in order
+
+#define LKS_ACC LKS_HIGH_ACC
+
+//-------------------------------------------------------------------------------------------------
+
+// Linux/macOS build for testing and benchmarking, see host/Makefile
+#elif defined(SAM11_HOST)
+
+#define _printf Serial.printf
+
+#define USE_SDIO false  // SdFat is stubbed with stdio, in host/SdFat.h
+
+#define ALLOW_DISASM (true)  // allow disassembly (PDP-11) on crash/panic/state prints
+
+#if USE_22BIT
+#define MAX_RAM_ADDRESS (017760000)  // 4MB less the I/O page
+#else
+#define MAX_RAM_ADDRESS (0760000)  // 248KB
+#endif
+
+#if USE_FORK
+#define RAM_MODE RAM_COW  // pages shared with the clones of a fork
+#else
+#define RAM_MODE RAM_INTERNAL  // plain memory
+#endif
+
+#define DECODE_CACHE (4096)  // the same as the Teensy, so the same code paths run
+
+#define LED_ON  (HIGH)
+#define LED_OFF (LOW)
+
+#define PIN_OUT_SD_CS (0)
+#define SD_SPEED_MHZ  (12)
+
+#define TTY_PORTS HOST_TTY_PORTS  // a pty for each of the DL11 lines, then the DH11 lines, in order (host/pty.cpp)
+
 #define LKS_ACC LKS_HIGH_ACC
 
 //-------------------------------------------------------------------------------------------------
@@ -0,0 +1,134 @@
+// this file is inserted into ms11.cpp when copy-on-write ram is selected as the option
+
+#ifndef RAM_OPT
+#define RAM_OPT
+
+// A page of memory, and how many machines and fork tables (share()) have it.
+// Nobody writes to a page more than one of them has, so a machine that has a
+// page to itself can write to it in place, and one that doesn't writes to a
+// copy. The dirty bits are the pages a machine has written since it last
+// shared them, which are its own, so only the first write to a page has to
+// look at the count.
+struct page
+{
+    std::atomic<uint32_t> users;
+    uint16_t w[MS11_PAGE_SIZE / 2];
+};
+
+static page zero;  // all of memory until it's written, which is never shared or freed
+
+static PERMACHINE page* pages[MS11_PAGES];
+
+static void let_go(page* p)
+{
+    if (p && p != &zero && p->users.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        free(p);
+}
+
+// this machine's page n to write to, copying it if it's shared
+static page* own(const uint16_t n)
+{
+    page* p = pages[n];
+    if (p == &zero || p->users.load(std::memory_order_acquire) != 1)
+    {
+        page* c = (page*)malloc(sizeof(page));
+        if (!c)
+        {
+            if (PRINTSIMLINES)
+                Serial.println(F("%% ms11: out of memory for a page"));
+            panic();
+        }
+        c->users.store(1, std::memory_order_relaxed);
+        memcpy(c->w, p->w, sizeof(c->w));
+        let_go(p);
+        pages[n] = c;
+    }
+    dirty[n >> 5] |= 1UL << (n & 31);
+    return pages[n];
+}
+
+// the byte at a to write to
+static inline char* writable(const uint32_t a)
+{
+    const uint16_t n = a >> MS11_PAGE_SHIFT;
+    page* p = is_dirty(n) ? pages[n] : own(n);
+    return (char*)p->w + (a & (MS11_PAGE_SIZE - 1));
+}
+
+static inline const char* readable(const uint32_t a)
+{
+    return (const char*)pages[a >> MS11_PAGE_SHIFT]->w + (a & (MS11_PAGE_SIZE - 1));
+}
+
+void share(page** table)
+{
+    for (uint16_t n = 0; n < MS11_PAGES; n++)
+    {
+        table[n] = pages[n];
+        if (pages[n] != &zero)
+            pages[n]->users.fetch_add(1, std::memory_order_relaxed);
+    }
+    clean();
+}
+
+void adopt(page* const* table)
+{
+    end();
+    for (uint16_t n = 0; n < MS11_PAGES; n++)
+    {
+        pages[n] = table[n];
+        if (pages[n] != &zero)
+            pages[n]->users.fetch_add(1, std::memory_order_relaxed);
+    }
+    clean();
+#if DECODE_CACHE
+    for (uint16_t i = 0; i < DECODE_CACHE; i++)
+        procNS::dcache[i].pa = 1;  // it was decoded from the memory there was
+#endif
+}
+
+void release(page** table)
+{
+    for (uint16_t n = 0; n < MS11_PAGES; n++)
+    {
+        let_go(table[n]);
+        table[n] = &zero;
+    }
+}
+
+void end()
+{
+    release(pages);
+    clean();
+}
+
+void begin()
+{
+    end();
+}
+
+uint16_t read8(const uint32_t a)
+{
+    return *(const uint8_t*)readable(a);
+}
+
+void write8(const uint32_t a, const uint16_t v)
+{
+    snoop(a);
+    *writable(a) = v & 0xff;
+    return;
+}
+
+void write16(uint32_t a, uint16_t v)
+{
+    snoop(a);
+    *(uint16_t*)writable(a) = v;
+    return;
+}
+
+uint16_t read16(uint32_t a)
+{
+    return *(const uint16_t*)readable(a);
+}
+
+#endif
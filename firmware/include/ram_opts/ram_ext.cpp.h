@@ -57,6 +57,8 @@ void write8(const uint32_t a, const uint16_t v)
     if (a < MAX_RAM_ADDRESS)
     {
         // change this to a memory device rather than swap banks
+        mark(a);
+        snoop(a);
         xmem::setMemoryBank(bank(a), false);
         charptr[(a & 0x7fff)] = v & 0xff;
         return;
@@ -75,6 +77,8 @@ void write16(uint32_t a, uint16_t v)
     if (a < MAX_RAM_ADDRESS)
     {
         // change this to a memory device rather than swap banks
+        mark(a);
+        snoop(a);
         xmem::setMemoryBank(bank(a), false);
         intptr[(a & 0x7fff) >> 1] = v;
         return;
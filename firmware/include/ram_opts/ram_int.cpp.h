@@ -3,7 +3,11 @@
 #ifndef RAM_OPT
 #define RAM_OPT
 
-volatile char int_mem[MAX_RAM_ADDRESS];
+#if defined(RAM_PSRAM) && RAM_PSRAM
+PERMACHINE EXTMEM volatile char int_mem[MAX_RAM_ADDRESS];  // the teensy's PSRAM, which isn't cleared at startup
+#else
+PERMACHINE volatile char int_mem[MAX_RAM_ADDRESS];
+#endif
 
 // memory as words
 #define intptr ((uint16_t*)&int_mem)
@@ -12,7 +16,9 @@ volatile char int_mem[MAX_RAM_ADDRESS];
 
 void begin()
 {
-    // nothing to do
+#if defined(RAM_PSRAM) && RAM_PSRAM
+    memset((char*)int_mem, 0, MAX_RAM_ADDRESS);
+#endif
     return;
 }
 
@@ -23,12 +29,16 @@ uint16_t read8(const uint32_t a)
 
 void write8(const uint32_t a, const uint16_t v)
 {
+    mark(a);
+    snoop(a);
     charptr[a] = v & 0xff;
     return;
 }
 
 void write16(uint32_t a, uint16_t v)
 {
+    mark(a);
+    snoop(a);
     intptr[a >> 1] = v;
     return;
 }
@@ -49,6 +49,8 @@ uint16_t read8(const uint32_t a)
 
 void write8(const uint32_t a, const uint16_t v)
 {
+    mark(a);
+    snoop(a);
 #ifdef PIN_OUT_MEM_ACT
     digitalWrite(PIN_OUT_MEM_ACT, LED_ON);
 #endif
@@ -69,6 +71,8 @@ void write8(const uint32_t a, const uint16_t v)
 
 void write16(uint32_t a, uint16_t v)
 {
+    mark(a);
+    snoop(a);
 #ifdef PIN_OUT_MEM_ACT
     digitalWrite(PIN_OUT_MEM_ACT, LED_ON);
 #endif
@@ -55,18 +55,23 @@ Bits:
 namespace rk11 {
 
 #define NUM_RK_DRIVES (4)
-extern bool attached_drives[NUM_RK_DRIVES];
+extern PERMACHINE bool attached_drives[NUM_RK_DRIVES];
 
-extern SdFile rkdata[NUM_RK_DRIVES];
+extern PERMACHINE SdFile rkdata[NUM_RK_DRIVES];
 
 void reset();
 void write16(uint32_t a, uint16_t v);
 uint16_t read16(uint32_t a);
+
+#if SNAPSHOTS
+void snapshot(SdFile& f, bool save);
+#endif
 };  // namespace rk11
 
 enum
 {
     RKOVR = (1 << 14),
+    RKNXM = (1 << 10),
     RKNXD = (1 << 7),
     RKNXC = (1 << 6),
     RKNXS = (1 << 5)
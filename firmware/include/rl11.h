@@ -39,7 +39,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace rl11 {
 
-extern SdFile rldata;
+extern PERMACHINE SdFile rldata;
 
 void reset();
 void write16(uint32_t a, uint16_t v);
@@ -54,6 +54,7 @@ enum
     RLWCE = (1 << 11),
     RLDLT = (1 << 12),
     RLHNF = (1 << 12),
+    RLNXM = (1 << 13),
     RLDE = (1 << 14),
     RLCERR = (1 << 15)
 };
@@ -0,0 +1,115 @@
+/*
+Modified BSD License
+
+Copyright (c) 2021 Chloe Lunn
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// sam11 record and replay of external inputs
+#include "pdp1140.h"
+
+#if USE_RR
+
+#include <stdint.h>
+
+/* Record/Replay:
+ * ==============
+ *
+ * The only things that make two runs of the same disks behave differently are
+ * the console input (whenever the bytes happen to turn up on the serial port),
+ * the line clock (when it's timed with elapsedMillis/elapsedMicros), and the
+ * DL11 and DH11 lines' input and output, which goes as fast as their ports
+ * take it.
+ * Everything else runs off the step loop: the rk11 finishes a transfer in the
+ * same step that starts it, and kl11 output and the lp11 are paced in steps.
+ *
+ * In RR_RECORD mode every console byte, every clock tick, every DL11 or DH11
+ * byte in, and every DL11 byte or DH11 chunk out is written to RR_FILE on the
+ * SD card, along with the step it happened on and the PC.
+ * In RR_REPLAY mode the serial port and the wall clock are ignored, and the
+ * logged inputs are fed back in on the same steps, so the machine runs exactly
+ * the same instructions each time (as long as the disks are the same too).
+ *
+ * Every RR_SYNC steps a sync point with a checksum of the registers is logged,
+ * and the replay checks the machine against every event and sync point, so
+ * a divergence is reported within RR_SYNC steps of the instruction that
+ * caused it. Recording and replaying again with RR_SYNC set to 1 (e.g. the
+ * host build's OPTS="USE_RR=RR_RECORD RR_SYNC=1") reports the first
+ * instruction that differs, for 16 bytes of log a step. When the log runs out,
+ * the replay stops and reports how long it took, which makes it useful to
+ * compare builds with.
+ *
+ * The recording is flushed every RR_FLUSH_MS, and by end() when the processor
+ * halts.
+ */
+
+#define RR_FILE     "rr.log"
+#ifndef RR_SYNC
+#define RR_SYNC (65536)  // steps between sync points, 1 checks every instruction
+#endif
+#define RR_FLUSH_MS (1000)  // how often to flush the recording to the card
+
+namespace rr {
+
+enum
+{
+    EV_CHAR = 1,  // console byte, as loaded into TKB
+    EV_TICK = 2,  // line clock tick
+    EV_SYNC = 3,  // sync point, no input
+
+    EV_DL_RX = 0x10,  // DL11 input byte as loaded into TKB, plus the line number
+    EV_DL_TX = 0x20,  // DL11 output byte taken by the port, plus the line number
+    EV_DH_RX = 0x30,  // DH11 input byte as put in the silo, plus the line number
+    EV_DH_TX = 0x40,  // how many DH11 output bytes the port took, plus the line number
+};
+
+struct event {
+    uint64_t step;
+    uint32_t sum;  // checksum of the registers and PS
+    uint16_t pc;
+    uint8_t type;
+    uint8_t data;
+};
+
+extern PERMACHINE uint64_t steps;  // how many times the processor has been stepped
+
+void begin();
+void end();
+void step();
+uint32_t quiet();
+void skip(uint32_t n);
+
+#if USE_RR == RR_RECORD
+void record(uint8_t type, uint8_t data);
+#elif USE_RR == RR_REPLAY
+bool replay(uint8_t type, char* data);
+#endif
+
+};  // namespace rr
+
+#endif
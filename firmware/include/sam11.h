@@ -38,9 +38,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <SdFat.h>
 
 #if USE_SDIO && !defined(__IMXRT1062__)  // If SDIO and not a Teensy 4/4.1
-extern SdFatSdio sd;
+extern PERMACHINE SdFatSdio sd;
 #else  // SPI or Teensy
-extern SdFat sd;
+extern PERMACHINE SdFat sd;
 #endif
 
 enum
@@ -4,7 +4,7 @@
 #define FLUSH_SERIAL_AT_READY true  // clear the serial in and out buffers once the processor is ready
 
 #define ANSI_TO_ASCII false  // convert ansi codes for things like delete ("\e[3~") into their ascii equivalent (0x7F) when passing messages from Serial to PDP \
-                            // Note that this completely disables ESC, and does not passthrough ANY unhandled ANSI escapes.
+                            // Any other escape sequences are passed through as they are.
 
 // Only really works if just one of these is enabled at a time
 #define BS_TO_DEL false  // convert any CTRL+H, ASCII BS characters into ASCII DEL 0x7F characters
@@ -14,6 +14,20 @@
 
 #define REMAP_WITH_TABLE false  // use the table at the bottom of this header to do look up of ascii characters by value instead of passing value straight through
 
+// Console input
+#define KL_RX_BUFFER 256   // bytes of console input held until the PDP reads them, so a paste isn't lost (must be a power of 2)
+#define KL_RX_POLL   256   // polls between checks of the host for console input
+
+// Console output
+#define KL_BAUD      0     // pace the console output at this baud rate like a real KL11, or 0 to have each character done by the next poll, as fast as the program can send them
+#define KL_TX_BUFFER 256   // bytes of console output collected up to send to the host in one go (must be a power of 2)
+#define KL_TX_HOLD   4096  // most polls to hold console output for before sending it
+
+// DL11 and DH11 lines
+#define DL_RX_POLL 256  // polls between checks of the DL11 lines' ports for input
+#define DH_RX_POLL 256  // polls between checks of the DH11 lines' ports for input
+#define DH_CHUNK   64   // most bytes a DH11 line copies out of memory to its port in one poll (must be even)
+
 // ASCII Control Characters
 #define _NUL (0x00)
 #define _SOH (0x01)
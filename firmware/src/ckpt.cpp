@@ -0,0 +1,544 @@
+/*
+Modified BSD License
+
+Copyright (c) 2021 Chloe Lunn
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// sam11 checkpointing of the running machine to the SD card
+
+#include "ckpt.h"
+
+#include "pdp1140.h"
+
+#if SNAPSHOTS
+
+#include "dh11.h"
+#include "dl11.h"
+#include "fp11.h"
+#include "kb11.h"  // 11/45
+#include "kd11.h"  // 11/40
+#include "kl11.h"
+#include "kt11.h"
+#include "kw11.h"
+#include "lp11.h"
+#include "ms11.h"
+#include "platform.h"
+#include "rk11.h"
+#include "sam11.h"
+
+#include <Arduino.h>
+#include <SdFat.h>
+
+#if USE_11_45 && !STRICT_11_40
+#define procNS kb11
+#else
+#define procNS kd11
+#endif
+
+#define CKPT_TEMP "ckpt.tmp"
+
+namespace ckpt {
+
+PERMACHINE bool failed;
+
+// save or load a block of state, remembering if anything went wrong
+bool xfer(SdFile& f, bool save, void* p, size_t n)
+{
+    if (save)
+    {
+        if (f.write(p, n) != n)
+            failed = true;
+    }
+    else
+    {
+        if (f.read(p, n) != (int)n)
+            failed = true;
+    }
+    return !failed;
+}
+
+// save or load the processor and device state
+void state(SdFile& f, bool save)
+{
+    procNS::snapshot(f, save);
+#if USE_FP
+    fp11::snapshot(f, save);
+#endif
+    kt11::snapshot(f, save);
+    kw11::snapshot(f, save);
+    kl11::snapshot(f, save);
+    rk11::snapshot(f, save);
+#if USE_LP
+    lp11::snapshot(f, save);
+#endif
+#if DL_TTYS
+    dl11::snapshot(f, save);
+#endif
+#if USE_DH
+    dh11::snapshot(f, save);
+#endif
+}
+
+#if USE_CKPT
+
+PERMACHINE uint32_t last_us;
+PERMACHINE uint32_t last_bytes;
+
+PERMACHINE uint16_t seq;  // sequence number of the next checkpoint in the chain
+PERMACHINE uint16_t steps;
+PERMACHINE uint32_t last_ms;
+
+static PERMACHINE uint16_t buf[256];
+
+static const char* name(uint16_t n)
+{
+    static PERMACHINE char fn[16];
+    sprintf(fn, "ckpt.%03u", n);
+    return fn;
+}
+
+// copy n bytes from one file to the other
+static bool copy(SdFile& from, SdFile& to, uint32_t n)
+{
+    while (n)
+    {
+        uint16_t c = n > sizeof(buf) ? sizeof(buf) : n;
+        if (from.read(buf, c) != c || to.write(buf, c) != c)
+            return false;
+        n -= c;
+    }
+    return true;
+}
+
+// open checkpoint n and read its header, if it follows on from checkpoint
+// n - 1 and is all there. A checkpoint cut short, e.g. by the power going
+// while it was written, is as long as its header says.
+static bool check(SdFile& f, uint16_t n, header& h)
+{
+    if (!f.open(name(n), O_READ))
+        return false;
+
+    failed = false;
+    xfer(f, false, &h, sizeof(h));
+    if (!failed && !memcmp(h.magic, "S11C", 4) && h.version == VERSION && h.seq == n &&
+        f.fileSize() == sizeof(h) + h.state + (uint32_t)h.pages * (sizeof(uint16_t) + MS11_PAGE_SIZE))
+    {
+        return true;
+    }
+
+    if (PRINTSIMLINES)
+        _printf("%%%% ckpt: %s is not a whole checkpoint\r\n", name(n));
+    f.close();
+    return false;
+}
+
+// Compaction is done a slice at a time from poll(), so that the processor is
+// only paused for one slice: reading the page list of one checkpoint, copying
+// one page, or removing one file. Checkpoints wait until it's finished.
+enum
+{
+    MERGE_IDLE,
+    MERGE_SCAN,  // find the newest copy of each page
+    MERGE_COPY,  // copy them into CKPT_TEMP
+    MERGE_DROP,  // remove the old chain, then CKPT_TEMP becomes the new ckpt.000
+};
+
+static PERMACHINE struct
+{
+    uint8_t stage;
+    bool ok;        // how the last merge went
+    uint16_t n;     // checkpoint being scanned or removed
+    uint16_t last;  // newest checkpoint being merged
+    uint16_t p;     // next page to copy
+    uint16_t pages;
+    uint32_t start;
+    SdFile out;
+} merge;
+
+static PERMACHINE uint16_t state_len[CKPT_MAX_CHAIN + 1];
+static PERMACHINE uint8_t newest[MS11_PAGES];  // which checkpoint has the newest copy of each page
+static PERMACHINE uint16_t slot[MS11_PAGES];   // and where it is in that checkpoint
+
+static void merge_start()
+{
+    if (merge.stage != MERGE_IDLE)
+        return;
+
+    // a previous compaction got as far as removing the old chain
+    if (!sd.exists(name(0)) && sd.exists(CKPT_TEMP))
+        sd.rename(CKPT_TEMP, name(0));
+
+    for (uint16_t p = 0; p < MS11_PAGES; p++)
+        newest[p] = 0xFF;
+    merge.stage = MERGE_SCAN;
+    merge.ok = true;
+    merge.n = 0;
+    merge.pages = 0;
+    merge.start = micros();
+}
+
+static void merge_fail()
+{
+    if (PRINTSIMLINES)
+        Serial.println(F("%% ckpt: failed to merge checkpoints"));
+    merge.out.close();
+    sd.remove(CKPT_TEMP);
+    merge.stage = MERGE_IDLE;
+    merge.ok = false;
+}
+
+// a checkpoint taken since boot can't be read back, so the pages only it had
+// would be lost by a merge. Start a new chain with a full checkpoint instead
+static void merge_restart()
+{
+    if (PRINTSIMLINES)
+        _printf("%%%% ckpt: %s is not a whole checkpoint, starting a new chain\r\n", name(merge.n));
+    for (uint16_t n = 0; n < seq || sd.exists(name(n)); n++)
+        sd.remove(name(n));
+    seq = 0;
+    ms11::soil();
+    merge.stage = MERGE_IDLE;
+    merge.ok = false;
+}
+
+// do the next slice of the merge
+static void merge_slice()
+{
+    SdFile f;
+    header h;
+
+    switch (merge.stage)
+    {
+    case MERGE_SCAN:
+        if (merge.n <= CKPT_MAX_CHAIN && check(f, merge.n, h))
+        {
+            state_len[merge.n] = h.state;
+            f.seekSet(sizeof(h) + h.state);
+            for (uint16_t i = 0; i < h.pages && !failed; i++)
+            {
+                uint16_t p;
+                xfer(f, false, &p, sizeof(p));
+                if (p < MS11_PAGES)
+                {
+                    if (newest[p] == 0xFF)
+                        merge.pages++;
+                    newest[p] = merge.n;
+                    slot[p] = i;
+                }
+                f.seekSet(f.curPosition() + MS11_PAGE_SIZE);
+            }
+            f.close();
+            if (!failed)
+            {
+                merge.n++;
+                return;
+            }
+        }
+
+        // the end of the chain, which is where take() got up to unless one
+        // of them is broken
+        if (merge.n < seq)
+        {
+            merge_restart();
+            return;
+        }
+        if (merge.n <= 1)  // nothing to merge
+        {
+            seq = merge.n;
+            merge.stage = MERGE_IDLE;
+            return;
+        }
+        merge.last = merge.n - 1;
+
+        if (!merge.out.open(CKPT_TEMP, O_RDWR | O_CREAT | O_TRUNC))
+        {
+            merge_fail();
+            return;
+        }
+
+        // device state comes from the newest checkpoint
+        h = {{'S', '1', '1', 'C'}, VERSION, 0, merge.pages, state_len[merge.last]};
+        if (merge.out.write(&h, sizeof(h)) != sizeof(h) || !f.open(name(merge.last), O_READ))
+        {
+            merge_fail();
+            return;
+        }
+        f.seekSet(sizeof(h));
+        merge.ok = copy(f, merge.out, h.state);
+        f.close();
+        if (!merge.ok)
+        {
+            merge_fail();
+            return;
+        }
+        merge.p = 0;
+        merge.stage = MERGE_COPY;
+        return;
+
+    case MERGE_COPY:
+        // and each page from the newest checkpoint that has it
+        while (merge.p < MS11_PAGES && newest[merge.p] == 0xFF)
+            merge.p++;
+        if (merge.p < MS11_PAGES)
+        {
+            const uint16_t p = merge.p++;
+            const uint16_t n = newest[p];
+            if (!f.open(name(n), O_READ))
+            {
+                merge_fail();
+                return;
+            }
+            f.seekSet(sizeof(h) + state_len[n] + (uint32_t)slot[p] * (sizeof(p) + MS11_PAGE_SIZE));
+            merge.ok = copy(f, merge.out, sizeof(p) + MS11_PAGE_SIZE);
+            f.close();
+            if (!merge.ok)
+                merge_fail();
+            return;
+        }
+        if (!merge.out.close())
+        {
+            merge_fail();
+            return;
+        }
+
+        // anything after the chain is a checkpoint that was cut short, which
+        // would otherwise be taken as following on from the merged one. The
+        // scan got to seq at least, so none of them are ones take() finished
+        for (uint16_t n = merge.last + 1; sd.exists(name(n)); n++)
+            sd.remove(name(n));
+        merge.n = merge.last + 1;
+        merge.stage = MERGE_DROP;
+        return;
+
+    case MERGE_DROP:
+        // newest first, so whatever's left if the power goes is still a chain
+        if (merge.n)
+        {
+            sd.remove(name(--merge.n));
+            return;
+        }
+        sd.rename(CKPT_TEMP, name(0));
+        seq = 1;
+        merge.stage = MERGE_IDLE;
+
+        if (PRINTSIMLINES)
+            _printf("%%%% ckpt: merged %u checkpoints in %luus\r\n", merge.last + 1, micros() - merge.start);
+        return;
+    }
+}
+
+// write out all the dirty pages of ram, and the device state
+bool take()
+{
+    uint32_t start = micros();
+    SdFile f;
+
+    // the chain is as long as it gets until it's merged, which failed last
+    // time, so try again rather than add to it. The pages stay dirty
+    if (seq > CKPT_MAX_CHAIN)
+    {
+        merge_start();
+        return false;
+    }
+
+    if (!f.open(name(seq), O_RDWR | O_CREAT | O_TRUNC))
+    {
+        if (PRINTSIMLINES)
+            Serial.println(F("%% ckpt: failed to open checkpoint for write"));
+        return false;
+    }
+
+    header h = {{'S', '1', '1', 'C'}, VERSION, seq, 0, 0};
+    for (uint16_t p = 0; p < MS11_PAGES; p++)
+    {
+        if (ms11::is_dirty(p))
+            h.pages++;
+    }
+
+    failed = false;
+    xfer(f, true, &h, sizeof(h));
+    state(f, true);
+    h.state = f.curPosition() - sizeof(h);
+
+    for (uint16_t p = 0; p < MS11_PAGES && !failed; p++)
+    {
+        if (!ms11::is_dirty(p))
+            continue;
+        xfer(f, true, &p, sizeof(p));
+        uint32_t a = (uint32_t)p << MS11_PAGE_SHIFT;
+        for (uint16_t o = 0; o < MS11_PAGE_SIZE; o += sizeof(buf))
+        {
+            for (uint16_t i = 0; i < sizeof(buf) / 2; i++, a += 2)
+                buf[i] = a < MAX_RAM_ADDRESS ? ms11::read16(a) : 0;
+            xfer(f, true, buf, sizeof(buf));
+        }
+    }
+
+    // go back and fill in how big the state was
+    last_bytes = f.curPosition();
+    f.seekSet(0);
+    xfer(f, true, &h, sizeof(h));
+    f.close();
+
+    if (failed)
+    {
+        if (PRINTSIMLINES)
+            Serial.println(F("%% ckpt: failed to write checkpoint"));
+        return false;
+    }
+
+    ms11::clean();
+    seq++;
+    last_us = micros() - start;
+
+    if (PRINTSIMLINES)
+        _printf("%%%% ckpt %u: %u pages, %lu bytes, paused %luus\r\n", h.seq, h.pages, last_bytes, last_us);
+
+    if (seq > CKPT_MAX_CHAIN)
+        merge_start();  // from the next poll()
+
+    return true;
+}
+
+// load the chain of checkpoints back into ram and the devices
+bool restore()
+{
+    SdFile f;
+    header h;
+    uint16_t n;
+
+    // find the end of the chain before loading anything, so that the machine
+    // is left as the last whole checkpoint had it
+    for (n = 0; check(f, n, h); n++)
+        f.close();
+
+    // and drop the rest, so the next checkpoint follows on from that one
+    for (uint16_t m = n; sd.exists(name(m)); m++)
+        sd.remove(name(m));
+
+    if (!n)
+        return false;
+
+    // the device state is all in the newest, the pages are in each in turn
+    failed = false;
+    for (uint16_t c = 0; c < n && !failed; c++)
+    {
+        if (!check(f, c, h))
+        {
+            failed = true;
+            break;
+        }
+        if (c == n - 1)
+            state(f, false);
+        else
+            f.seekSet(sizeof(h) + h.state);
+
+        for (uint16_t i = 0; i < h.pages && !failed; i++)
+        {
+            uint16_t p;
+            xfer(f, false, &p, sizeof(p));
+            uint32_t a = (uint32_t)p << MS11_PAGE_SHIFT;
+            for (uint16_t o = 0; o < MS11_PAGE_SIZE && !failed; o += sizeof(buf))
+            {
+                xfer(f, false, buf, sizeof(buf));
+                for (uint16_t j = 0; j < sizeof(buf) / 2; j++, a += 2)
+                {
+                    if (a < MAX_RAM_ADDRESS)
+                        ms11::write16(a, buf[j]);
+                }
+            }
+        }
+        f.close();
+    }
+
+    if (failed)  // the card went away part way through, so start again from scratch
+    {
+        if (PRINTSIMLINES)
+            Serial.println(F("%% ckpt: failed to load the checkpoints"));
+        procNS::reset();
+        return false;
+    }
+
+    seq = n;
+    ms11::clean();
+    return true;
+}
+
+// merge the chain of checkpoints into a single, full checkpoint, all at once
+bool compact()
+{
+    merge_start();
+    while (merge.stage != MERGE_IDLE)
+        merge_slice();
+    return merge.ok;
+}
+
+// pick up from where the last checkpoint left off, or start a new chain
+void begin()
+{
+#if CKPT_RESTORE
+    if (compact() && restore())
+    {
+        Serial.println(F("%% Restored from checkpoint"));
+        last_ms = millis();
+        return;
+    }
+#endif
+
+    for (uint16_t n = 0; sd.exists(name(n)); n++)
+        sd.remove(name(n));
+    seq = 0;
+    ms11::soil();
+    last_ms = millis();
+}
+
+// take a checkpoint every CKPT_PERIOD_MS
+void poll()
+{
+    if (++steps < CKPT_CHECK)
+        return;
+    steps = 0;
+
+    if (merge.stage != MERGE_IDLE)
+    {
+        merge_slice();
+        return;
+    }
+
+    if (millis() - last_ms < CKPT_PERIOD_MS)
+        return;
+    take();
+    last_ms = millis();
+}
+
+#endif
+
+};  // namespace ckpt
+
+#endif
@@ -35,6 +35,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "dd11.h"
 
+#include "dh11.h"
+#include "dl11.h"
 #include "kb11.h"  // 11/45
 #include "kd11.h"  // 11/40
 #include "kl11.h"
@@ -61,9 +63,56 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <Arduino.h>
 #include <SdFat.h>
+#include <string.h>
 
 namespace dd11 {
 
+PERMACHINE bool iowrite;
+
+#if USE_22BIT
+// nothing answers between the top of the ram and the I/O page
+static void nxm(const uint32_t a)
+{
+    if (PRINTSIMLINES)
+    {
+        Serial.print(F("%% dd11: access to non-existent memory 0"));
+        Serial.println(a, OCT);
+    }
+    longjmp(trapbuf, INTBUS);
+}
+#endif
+
+// the UNIBUS address of the register at a, in the I/O page
+static inline uint32_t ioaddr(const uint32_t a)
+{
+    return a - (IOPAGE_BASE - DEV_MEMORY);
+}
+
+// read16 without the side effects some registers have when they're read,
+// for merging a byte write into the word it's in
+static uint16_t peek16(const uint32_t a)
+{
+    switch (ioaddr(a))
+    {
+    case DEV_CONSOLE_TTY_IN_DATA:
+        return kl11::peek16(ioaddr(a));
+
+#if USE_DH
+    case DEV_DH_NRCR:
+        return dh11::peek16(ioaddr(a));
+#endif
+
+    default:
+#if DL_TTYS
+        if ((ioaddr(a) >= DEV_DL_1_TTY_IN_STATUS) && (ioaddr(a) < DL_END))
+        {
+            return dl11::peek16(ioaddr(a));
+        }
+#endif
+        return read16(a);
+    }
+}
+
 uint16_t read8(const uint32_t a)
 {
 #if !KY_PANEL
@@ -90,13 +139,49 @@ void write8(const uint32_t a, const uint16_t v)
         return;
     }
 #endif
+
+#if !KY_PANEL
+    // devices with byte registers take the byte as it is
+#if DL_TTYS
+    if ((ioaddr(a) >= DEV_DL_1_TTY_IN_STATUS) && (ioaddr(a) < DL_END))
+    {
+        iowrite = true;
+        dl11::write8(ioaddr(a), v);
+        return;
+    }
+#endif
+    switch (ioaddr(a) & ~1)
+    {
+    case DEV_CONSOLE_TTY_OUT_DATA:
+    case DEV_CONSOLE_TTY_OUT_STATUS:
+    case DEV_CONSOLE_TTY_IN_DATA:
+    case DEV_CONSOLE_TTY_IN_STATUS:
+        iowrite = true;
+        kl11::write8(ioaddr(a), v);
+        return;
+
+#if USE_LP
+    case DEV_LP_DATA:
+    case DEV_LP_STATUS:
+        iowrite = true;
+        lp11::write8(ioaddr(a), v);
+        return;
+#endif
+
+    default:
+        break;
+    }
+#endif
+
+    // everything else gets the byte merged into the word it's in
+    const uint16_t w = peek16(a & ~1);
     if (a % 2 != 0)
     {
-        write16(a & ~1, (read16(a) & 0xFF) | ((v & 0xFF) << 8));
+        write16(a & ~1, (w & 0xFF) | ((v & 0xFF) << 8));
     }
     else
     {
-        write16(a & ~1, (read16(a) & 0xFF00) | (v & 0xFF));
+        write16(a & ~1, (w & 0xFF00) | (v & 0xFF));
     }
 }
 
@@ -124,6 +209,16 @@ void write16(uint32_t a, uint16_t v)
         return;
     }
 
+#if USE_22BIT
+    if (a < IOPAGE_BASE)
+    {
+        nxm(a);
+    }
+    a -= IOPAGE_BASE - DEV_MEMORY;  // the devices sit at their 18 bit addresses
+#endif
+
+    iowrite = true;
+
     switch (a)
     {
     case DEV_CPU_STAT:
@@ -172,7 +267,9 @@ void write16(uint32_t a, uint16_t v)
                 }
                 panic();
             }
+            procNS::flags();
             procNS::PS = v;
+            procNS::switchset();
         }
         return;
 
@@ -186,7 +283,7 @@ void write16(uint32_t a, uint16_t v)
             if (procNS::curuser == 1)
                 procNS::R[6] = v;
             else
-                procNS::SSP = v;
+                procNS::bankSP[1] = v;
         }
         return;
 #endif
@@ -196,7 +293,7 @@ void write16(uint32_t a, uint16_t v)
             if (procNS::curuser == 0)
                 procNS::R[6] = v;
             else
-                procNS::KSP = v;
+                procNS::bankSP[0] = v;
         }
         return;
 
@@ -205,7 +302,7 @@ void write16(uint32_t a, uint16_t v)
             if (procNS::curuser == 3)
                 procNS::R[6] = v;
             else
-                procNS::USP = v;
+                procNS::bankSP[3] = v;
         }
         return;
 
@@ -235,7 +332,12 @@ void write16(uint32_t a, uint16_t v)
 
 #if !STRICT_11_40
     case DEV_MMU_SR3:
+#if USE_22BIT
+        kt11::SR3 = v & 067;
+#else
         kt11::SR3 = v;
+#endif
+        kt11::fast_ok = false;
         return;
 #endif
 
@@ -253,6 +355,19 @@ void write16(uint32_t a, uint16_t v)
         return;
 #endif
 
+#if USE_DH
+    case DEV_DH_SCR:
+    case DEV_DH_NRCR:
+    case DEV_DH_LPR:
+    case DEV_DH_CAR:
+    case DEV_DH_BCR:
+    case DEV_DH_BAR:
+    case DEV_DH_BRK:
+    case DEV_DH_SSR:
+        dh11::write16(a, v);
+        return;
+#endif
+
     case DEV_RK_DS:
     case DEV_RK_ER:
     case DEV_RK_CS:
@@ -291,6 +406,22 @@ void write16(uint32_t a, uint16_t v)
     }
 #endif
 
+#if USE_22BIT
+    if ((a >= DEV_UBMAP_R0_LO) && (a <= DEV_UBMAP_R30_HI))
+    {
+        kt11::write16(a, v);
+        return;
+    }
+#endif
+
+#if DL_TTYS
+    if ((a >= DEV_DL_1_TTY_IN_STATUS) && (a < DL_END))
+    {
+        dl11::write16(a, v);
+        return;
+    }
+#endif
+
     if (PRINTSIMLINES)
     {
         Serial.print(F("%% dd11: write to invalid address 0"));
@@ -320,10 +451,21 @@ uint16_t read16(uint32_t a)
     {
         readReturn ms11::read16(a);
     }
+#if USE_22BIT
+    else if (a < IOPAGE_BASE)
+    {
+        nxm(a);
+    }
+    else
+    {
+        a -= IOPAGE_BASE - DEV_MEMORY;  // the devices sit at their 18 bit addresses
+    }
+#endif
 
     switch (a)  // Switch by address, and read from virtual device as appropriate
     {
     case DEV_CPU_STAT:
+        procNS::flags();
         readReturn procNS::PS;
         break;
 
@@ -337,7 +479,7 @@ uint16_t read16(uint32_t a)
             if (procNS::curuser == 1)
                 readReturn procNS::R[6];
             else
-                readReturn procNS::SSP;
+                readReturn procNS::bankSP[1];
         }
         break;
 #endif
@@ -347,7 +489,7 @@ uint16_t read16(uint32_t a)
             if (procNS::curuser == 0)
                 readReturn procNS::R[6];
             else
-                readReturn procNS::KSP;
+                readReturn procNS::bankSP[0];
         }
         break;
 
@@ -356,7 +498,7 @@ uint16_t read16(uint32_t a)
             if (procNS::curuser == 3)
                 readReturn procNS::R[6];
             else
-                readReturn procNS::USP;
+                readReturn procNS::bankSP[3];
         }
         break;
 
@@ -390,6 +532,16 @@ uint16_t read16(uint32_t a)
         break;
 #endif
 
+#if USE_22BIT
+    case DEV_SYS_SIZE_LO:
+        readReturn (MAX_RAM_ADDRESS >> 6) - 1;  // the last 64 byte block of ram
+        break;
+
+    case DEV_SYS_SIZE_UP:
+        readReturn 0;
+        break;
+#endif
+
     case DEV_CONSOLE_SR:
         readReturn ky11::read16(a);
         break;
@@ -401,6 +553,19 @@ uint16_t read16(uint32_t a)
         break;
 #endif
 
+#if USE_DH
+    case DEV_DH_SCR:
+    case DEV_DH_NRCR:
+    case DEV_DH_LPR:
+    case DEV_DH_CAR:
+    case DEV_DH_BCR:
+    case DEV_DH_BAR:
+    case DEV_DH_BRK:
+    case DEV_DH_SSR:
+        readReturn dh11::read16(a);
+        break;
+#endif
+
     case DEV_RK_DS:
     case DEV_RK_ER:
     case DEV_RK_CS:
@@ -437,6 +602,20 @@ uint16_t read16(uint32_t a)
     }
 #endif
 
+#if USE_22BIT
+    if ((a >= DEV_UBMAP_R0_LO) && (a <= DEV_UBMAP_R30_HI))
+    {
+        readReturn kt11::read16(a);
+    }
+#endif
+
+#if DL_TTYS
+    if ((a >= DEV_DL_1_TTY_IN_STATUS) && (a < DL_END))
+    {
+        readReturn dl11::read16(a);
+    }
+#endif
+
 #if KY_PANEL
     // If the panel is enabled, bus access gets written to the front panel, EXCEPT the switch registers, because that would be weird, instead we just do the address there
     if (a != DEV_CONSOLE_SR)
@@ -454,4 +633,100 @@ uint16_t read16(uint32_t a)
     longjmp(trapbuf, INTBUS);
 }
 
+// one word of a transfer the slow way, false if nothing answers at pa
+static bool dmaword(const uint32_t pa, uint16_t& v, const bool w)
+{
+    jmp_buf cpu;
+    memcpy(cpu, trapbuf, sizeof(jmp_buf));
+    if (setjmp(trapbuf))
+    {
+        memcpy(trapbuf, cpu, sizeof(jmp_buf));
+        return false;
+    }
+    if (w)
+    {
+        write16(pa, v);
+    }
+    else
+    {
+        v = read16(pa);
+    }
+    memcpy(trapbuf, cpu, sizeof(jmp_buf));
+    return true;
+}
+
+// how many of words from a can be moved in one go: the rest of the UNIBUS
+// map's 8KB block, and the rest of ram at pa, or 0 if pa isn't ram
+static uint16_t dmarun(const uint32_t a, const uint32_t pa, uint16_t words)
+{
+#if KY_PANEL
+    return 0;  // the panel has to see every access
+#else
+    if ((pa & 1) || pa >= MAX_RAM_ADDRESS)
+    {
+        return 0;
+    }
+    if (words > (020000 - (a & 017777)) >> 1)
+    {
+        words = (020000 - (a & 017777)) >> 1;
+    }
+    if (words > (MAX_RAM_ADDRESS - pa) >> 1)
+    {
+        words = (MAX_RAM_ADDRESS - pa) >> 1;
+    }
+    return words;
+#endif
+}
+
+uint16_t dmaread(uint32_t a, uint16_t* buf, const uint16_t words)
+{
+    uint16_t done = 0;
+    while (done < words)
+    {
+        const uint32_t pa = kt11::unibus(a);
+        uint16_t n = dmarun(a, pa, words - done);
+        if (n)
+        {
+            ms11::readblock16(pa, buf + done, n);
+        }
+        else if (dmaword(pa, buf[done], false))
+        {
+            n = 1;
+        }
+        else
+        {
+            break;
+        }
+        done += n;
+        a += 2 * n;
+    }
+    return done;
+}
+
+uint16_t dmawrite(uint32_t a, const uint16_t* buf, const uint16_t words)
+{
+    uint16_t done = 0;
+    while (done < words)
+    {
+        const uint32_t pa = kt11::unibus(a);
+        uint16_t n = dmarun(a, pa, words - done);
+        uint16_t v = buf[done];
+        if (n)
+        {
+            ms11::writeblock16(pa, buf + done, n);
+        }
+        else if (dmaword(pa, v, true))
+        {
+            n = 1;
+        }
+        else
+        {
+            break;
+        }
+        done += n;
+        a += 2 * n;
+    }
+    return done;
+}
+
 };  // namespace dd11
@@ -0,0 +1,431 @@
+/*
+Modified BSD License
+
+Copyright (c) 2021 Chloe Lunn
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// sam11 software emulation of DEC PDP-11 DH11 16 line serial multiplexer
+
+#include "dh11.h"
+
+#include "pdp1140.h"
+
+#if USE_DH
+
+#include "ckpt.h"
+#include "dd11.h"
+#include "kb11.h"  // 11/45
+#include "kd11.h"  // 11/40
+#include "platform.h"
+#include "rr.h"
+#include "sam11.h"
+#include "termopts.h"
+
+#include <Arduino.h>
+
+#if USE_11_45 && !STRICT_11_40
+#define procNS kb11
+#else
+#define procNS kd11
+#endif
+
+#define DH_LINES 16
+#define DH_SILO  64  // characters the receive silo holds (must be a power of 2)
+
+#if DL_TTYS
+#define DH_VEC   (INTFLOAT + 010 * DL_LINES)  // the floating vectors come after the DL11 lines'
+#define DH_FIRST DL_LINES                     // the first of TTY_PORTS that's the DH11's
+#else
+#define DH_VEC   INTFLOAT
+#define DH_FIRST 0
+#endif
+
+#if USE_RR && DH_CHUNK > 255
+#error "rr logs how many bytes a DH11 line sent in a byte, DH_CHUNK must fit"
+#endif
+
+namespace dh11 {
+
+// System control register bits
+enum
+{
+    SCR_LINE = 017,       // line select, for LPR, CAR and BCR
+    SCR_MEMEXT = 060,     // bits 16 and 17 of the selected line's CAR
+    SCR_RIE = 0100,       // receive interrupt enable
+    SCR_RI = 0200,        // receive interrupt, there's something in the silo
+    SCR_CNXM = 0400,      // clear NXM (write only)
+    SCR_MAINT = 01000,    // maintenance loop back (not emulated)
+    SCR_NXM = 02000,      // a transmit DMA found non-existent memory
+    SCR_MCLR = 04000,     // master clear (write only)
+    SCR_SIE = 010000,     // silo interrupt enable, only interrupt above the alarm level
+    SCR_TIE = 020000,     // transmit interrupt enable
+    SCR_SOVF = 040000,    // silo overflow
+    SCR_TI = 0100000,     // transmit interrupt, a line has finished its buffer
+};
+
+PERMACHINE uint16_t SCR;
+PERMACHINE uint16_t LPR[DH_LINES];  // write only
+PERMACHINE uint32_t CAR[DH_LINES];  // 18 bits, with the memory extension bits
+PERMACHINE uint16_t BCR[DH_LINES];  // two's complement, counts up to 0
+PERMACHINE uint16_t BAR;
+PERMACHINE uint16_t BRK;
+PERMACHINE uint16_t SSR;  // the alarm level, the fill level is worked out when it's read
+
+PERMACHINE uint16_t silo[DH_SILO];  // valid, the line number and the character, as NRCR reads them
+PERMACHINE uint8_t silohead, silotail;  // free running, silo[silotail] is the oldest
+
+// The port each line is connected to, or none for the lines past the last one
+HardwareSerial* port[DH_LINES];
+
+PERMACHINE uint16_t rxwait = 1;  // polls until the ports are next checked for input
+
+void begin(void)
+{
+#ifdef TTY_PORTS
+    HardwareSerial* const ports[] = {TTY_PORTS};
+    for (uint8_t t = 0; t < DH_LINES && DH_FIRST + t < sizeof(ports) / sizeof(ports[0]); t++)
+    {
+        port[t] = ports[DH_FIRST + t];
+        port[t]->begin(BAUD_DEFAULT);
+    }
+#endif
+    reset();
+}
+
+void reset()
+{
+    SCR = 0;
+    BAR = 0;
+    BRK = 0;
+    SSR = 0;
+    silohead = silotail = 0;
+    for (uint8_t t = 0; t < DH_LINES; t++)
+    {
+        LPR[t] = 0;
+        CAR[t] = 0;
+        BCR[t] = 0;
+    }
+}
+
+// is the receive interrupt asking
+static bool rxready()
+{
+    const uint8_t n = silohead - silotail;
+    if (SCR & SCR_SIE)
+        return n > (SSR & 077);
+    return n > 0;
+}
+
+static void rxcheck()
+{
+    if ((SCR & SCR_RIE) && rxready())
+    {
+        procNS::interrupt(DH_VEC, 5);
+    }
+}
+
+static void txdone()
+{
+    SCR |= SCR_TI;
+    if (SCR & SCR_TIE)
+    {
+        procNS::interrupt(DH_VEC + 4, 5);
+    }
+}
+
+// send as much of the line's buffer as its port has room for
+static void send(const uint8_t t)
+{
+    uint16_t n = -BCR[t];  // bytes left
+    bool nxm = false;
+    if (n && port[t])
+    {
+#if USE_RR == RR_REPLAY
+        char taken;
+        if (!rr::replay(rr::EV_DH_TX + t, &taken))
+            return;  // wait for the step the port made room on
+        n = (uint8_t)taken;
+#else
+        const int room = port[t]->availableForWrite();
+        if (n > room)
+            n = room;
+        if (n > DH_CHUNK)
+            n = DH_CHUNK;
+        if (!n)
+            return;  // wait for the port to make some room
+#if USE_RR == RR_RECORD
+        rr::record(rr::EV_DH_TX + t, n);
+#endif
+#endif
+
+        // the words the bytes are in, which are in memory order as the host is little endian too
+        const uint32_t a = CAR[t];
+        const uint16_t words = ((a & 1) + n + 1) >> 1;
+        uint16_t buf[DH_CHUNK / 2 + 1];
+        const uint16_t got = dd11::dmaread(a & ~1, buf, words);
+        if (got < words)
+        {
+            // send up to the word nothing answered at, and leave CAR there
+            n = got * 2 > (a & 1) ? got * 2 - (a & 1) : 0;
+            nxm = true;
+        }
+
+        uint8_t* const c = (uint8_t*)buf + (a & 1);
+        for (uint16_t i = 0; i < n; i++)
+            c[i] &= 0x7f;  // the & 0x7f removes the parity bit, all characters should be 7-bit anyway.
+        port[t]->write(c, n);
+    }
+
+    // (a line that isn't connected to anything sends it all at once)
+    CAR[t] = (CAR[t] + n) & 0777777;
+    BCR[t] += n;
+
+    if (nxm)
+    {
+        SCR |= SCR_NXM;
+        BAR &= ~(1 << t);
+        txdone();
+    }
+    else if (!BCR[t])
+    {
+        BAR &= ~(1 << t);
+        txdone();
+    }
+}
+
+// move what the ports have sent (or the replay has) into the silo, as much as
+// will fit
+static void receive()
+{
+    bool any = false;
+    for (uint8_t t = 0; t < DH_LINES && port[t]; t++)
+    {
+#if USE_RR == RR_REPLAY
+        char c;
+        while ((uint8_t)(silohead - silotail) < DH_SILO && rr::replay(rr::EV_DH_RX + t, &c))
+        {
+            silo[silohead++ & (DH_SILO - 1)] = 0100000 | (t << 8) | (uint8_t)c;
+            any = true;
+        }
+#else
+        const uint8_t mask = 0377 >> (3 - (LPR[t] & 3));  // 5 to 8 bit characters
+        while ((uint8_t)(silohead - silotail) < DH_SILO && port[t]->available())
+        {
+            const uint8_t c = port[t]->read() & mask;
+#if USE_RR == RR_RECORD
+            rr::record(rr::EV_DH_RX + t, c);
+#endif
+            silo[silohead++ & (DH_SILO - 1)] = 0100000 | (t << 8) | c;
+            any = true;
+        }
+#endif
+    }
+    if (any)
+        rxcheck();
+}
+
+void poll()
+{
+    // Write
+    for (uint16_t b = BAR; b; b &= b - 1)
+    {
+        send(__builtin_ctz(b));
+    }
+
+    // Read
+#if USE_RR == RR_REPLAY
+    receive();
+#else
+    if (!--rxwait)
+    {
+        rxwait = DH_RX_POLL;
+        receive();
+    }
+#endif
+}
+
+// the processor is WAITing, so check for input now. Returns true if there's
+// nothing to do but wait for some
+bool idle()
+{
+#if USE_RR == RR_RECORD
+    // leave it for the next poll, so it's logged in the order it's replayed
+    for (uint8_t t = 0; t < DH_LINES && port[t]; t++)
+    {
+        if (port[t]->available())
+        {
+            rxwait = 1;
+            return false;
+        }
+    }
+#elif USE_RR != RR_REPLAY
+    receive();
+#endif
+    if ((SCR & SCR_RIE) && rxready())
+        return false;  // its interrupt is waiting to be taken
+    return !BAR;
+}
+
+// how many more polls will pass without anything happening
+uint16_t quiet()
+{
+    if (BAR)
+        return 0;  // the next poll sends some more
+#if USE_RR == RR_REPLAY
+    return 0xFFFF;  // the input comes in on the steps it was logged on
+#else
+    return rxwait - 1;
+#endif
+}
+
+// skip n polls, n must be no more than quiet()
+void skip(uint16_t n)
+{
+#if USE_RR != RR_REPLAY
+    rxwait -= n;
+#endif
+}
+
+uint16_t read16(uint32_t a)
+{
+    const uint8_t t = SCR & SCR_LINE;
+
+    switch (a)
+    {
+    case DEV_DH_SCR:
+        return (SCR & ~(SCR_MEMEXT | SCR_RI)) | ((CAR[t] >> 12) & SCR_MEMEXT) | (rxready() ? SCR_RI : 0);
+    case DEV_DH_NRCR:
+        if (silohead != silotail)
+        {
+            return silo[silotail++ & (DH_SILO - 1)];
+        }
+        return 0;
+    case DEV_DH_LPR:
+        return 0;
+    case DEV_DH_CAR:
+        return CAR[t] & 0177777;
+    case DEV_DH_BCR:
+        return BCR[t];
+    case DEV_DH_BAR:
+        return BAR;
+    case DEV_DH_BRK:
+        return BRK;
+    case DEV_DH_SSR:
+        return ((uint8_t)(silohead - silotail) << 8) | (SSR & 077);
+    default:
+        if (PRINTSIMLINES)
+        {
+            _printf("%%%% dh11: read from invalid address 0%06o\n", a);
+        }
+        return 0;
+    }
+}
+
+// read16 without taking the character out of the silo when NRCR is read
+uint16_t peek16(uint32_t a)
+{
+    if (a == DEV_DH_NRCR)
+    {
+        return (silohead != silotail) ? silo[silotail & (DH_SILO - 1)] : 0;
+    }
+    return read16(a);
+}
+
+void write16(uint32_t a, uint16_t v)
+{
+    switch (a)
+    {
+    case DEV_DH_SCR:
+        if (v & SCR_MCLR)
+        {
+            reset();
+            break;
+        }
+        if (v & SCR_CNXM)
+        {
+            SCR &= ~SCR_NXM;
+        }
+        // the two interrupt flags can only be cleared
+        SCR = (v & (SCR_LINE | SCR_RIE | SCR_MAINT | SCR_SIE | SCR_TIE)) | (SCR & SCR_NXM) | (SCR & v & (SCR_SOVF | SCR_TI));
+        CAR[v & SCR_LINE] = (CAR[v & SCR_LINE] & 0177777) | ((uint32_t)(v & SCR_MEMEXT) << 12);
+        if ((SCR & SCR_TI) && (SCR & SCR_TIE))
+        {
+            procNS::interrupt(DH_VEC + 4, 5);
+        }
+        rxcheck();
+        break;
+    case DEV_DH_LPR:
+        LPR[SCR & SCR_LINE] = v;
+        break;
+    case DEV_DH_CAR:
+        CAR[SCR & SCR_LINE] = (CAR[SCR & SCR_LINE] & 0600000) | v;
+        break;
+    case DEV_DH_BCR:
+        BCR[SCR & SCR_LINE] = v;
+        break;
+    case DEV_DH_BAR:
+        BAR = v;
+        break;
+    case DEV_DH_BRK:
+        BRK = v;
+        break;
+    case DEV_DH_SSR:
+        SSR = v & 077;
+        rxcheck();
+        break;
+    case DEV_DH_NRCR:
+        break;
+    default:
+        if (PRINTSIMLINES)
+        {
+            _printf("%%%% dh11: write to invalid address 0%06o\n", a);
+        }
+    }
+}
+
+#if SNAPSHOTS
+// save or load the multiplexer state for a checkpoint or a fork
+void snapshot(SdFile& f, bool save)
+{
+    ckpt::xfer(f, save, &SCR, sizeof(SCR));
+    ckpt::xfer(f, save, LPR, sizeof(LPR));
+    ckpt::xfer(f, save, CAR, sizeof(CAR));
+    ckpt::xfer(f, save, BCR, sizeof(BCR));
+    ckpt::xfer(f, save, &BAR, sizeof(BAR));
+    ckpt::xfer(f, save, &BRK, sizeof(BRK));
+    ckpt::xfer(f, save, &SSR, sizeof(SSR));
+    ckpt::xfer(f, save, silo, sizeof(silo));
+    ckpt::xfer(f, save, &silohead, sizeof(silohead));
+    ckpt::xfer(f, save, &silotail, sizeof(silotail));
+}
+#endif
+
+};  // namespace dh11
+
+#endif
@@ -30,7 +30,7 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-// sam11 software emulation of DEC PDP-11/40 DL11 Main TTY
+// sam11 software emulation of DEC PDP-11/40 DL11 serial lines
 
 #include "dl11.h"
 
@@ -38,8 +38,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #if DL_TTYS
 
+#include "ckpt.h"
 #include "kb11.h"  // 11/45
 #include "kd11.h"  // 11/40
+#include "platform.h"
+#include "rr.h"
 #include "sam11.h"
 #include "termopts.h"
 
@@ -53,174 +56,271 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace dl11 {
 
-Uart* serial[4];
+PERMACHINE uint16_t TKS[DL_LINES];
+PERMACHINE uint16_t TKB[DL_LINES];
+PERMACHINE uint16_t TPS[DL_LINES];
+PERMACHINE uint16_t TPB[DL_LINES];
 
-uint16_t TKS[4];
-uint16_t TKB[4];
-uint16_t TPS[4];
-uint16_t TPB[4];
+// The port each line is connected to. Lines past the board's last port are
+// left unconnected, their output goes nowhere and they never get any input
+HardwareSerial* port[DL_LINES];
+
+// Rather than every poll going through every line, only the lines that have
+// something to do are looked at: the ones sending a character every poll,
+// and the ones waiting for input every DL_RX_POLL polls
+PERMACHINE uint16_t busy;        // lines with a character in TPB to send
+PERMACHINE uint16_t listening;   // connected lines that the PDP has read the last character from
+PERMACHINE uint16_t rxwait = 1;  // polls until the listening lines are next checked
 
 void begin(void)
 {
-    serial[0] = &Serial1;
-    serial[1] = &Serial2;
-    serial[2] = &Serial3;
-    serial[3] = &Serial;
-
-    for (int i = 0; i < 4; i++)
-        serial[i]->begin(BAUD_DEFAULT);
+#ifdef TTY_PORTS
+    HardwareSerial* const ports[] = {TTY_PORTS};
+    for (uint8_t t = 0; t < DL_LINES && t < sizeof(ports) / sizeof(ports[0]); t++)
+    {
+        port[t] = ports[t];
+        port[t]->begin(BAUD_DEFAULT);
+    }
+#endif
+    reset();
 }
 
-void clearterminal(uint8_t t)
+void reset()
 {
-    if (t < 4)
+    busy = 0;
+    listening = 0;
+    for (uint8_t t = 0; t < DL_LINES; t++)
     {
         TKS[t] = 0;
         TPS[t] = 1 << 7;
         TKB[t] = 0;
         TPB[t] = 0;
+        if (port[t])
+            listening |= 1 << t;
     }
 }
 
-static void addchar(char c, uint8_t t)
+// load the next character into line t's TKB
+static void addchar(uint8_t t, char c)
 {
-    switch (c)
-    {
-    default:
-        TKB[t] = c;
-        break;
-    }
+#if USE_RR == RR_RECORD
+    rr::record(rr::EV_DL_RX + t, c);
+#endif
+
+    TKB[t] = c;
     TKS[t] |= 0x80;
+    listening &= ~(1 << t);
     if (TKS[t] & (1 << 6))
     {
-        procNS::interrupt(INTFLOAT + (010 * t) + 0, 4);
+        procNS::interrupt(INTFLOAT + (010 * t), 4);
     }
 }
 
-uint8_t count[4];
-
-void poll(uint8_t t)
+// load the next character from the host (or the replay) into each line that's
+// ready for one. Returns true if any were
+static bool receive()
 {
-    if (serial[t]->available())
+    bool any = false;
+    for (uint16_t l = listening; l; l &= l - 1)
     {
-        char c = serial[t]->read();
-        if (FIRST_LF_BREAKS && (c == '\n' || c == '\r'))
-            procNS::trapped = true;
-        addchar(c & 0x7F, t);
+        const uint8_t t = __builtin_ctz(l);
+#if USE_RR == RR_REPLAY
+        char c;
+        if (!rr::replay(rr::EV_DL_RX + t, &c))
+            continue;
+        addchar(t, c);
+#else
+        if (!port[t]->available())
+            continue;
+        addchar(t, port[t]->read() & 0x7F);
+#endif
+        any = true;
     }
+    return any;
+}
 
-    if ((TPS[t] & 0x80) == 0)
+void poll()
+{
+    // Write. A line stays busy until its port has room for the character, so
+    // the output goes at the port's baud rate without holding up the processor
+    for (uint16_t b = busy; b; b &= b - 1)
     {
-        if (++count[t] > 32)
+        const uint8_t t = __builtin_ctz(b);
+        if (port[t])
         {
-            serial[t]->write(TPB[t] & 0x7f);  // the & 0x7f removes the parity bit, all characters should be 7-bit anyway.
-            TPS[t] |= 0x80;
-            if (TPS[t] & (1 << 6))
-            {
-                procNS::interrupt(INTFLOAT + (010 * t) + 4, 4);
-            }
+#if USE_RR == RR_REPLAY
+            if (!rr::replay(rr::EV_DL_TX + t, 0))
+                continue;
+#else
+            if (!port[t]->availableForWrite())
+                continue;
+#if USE_RR == RR_RECORD
+            rr::record(rr::EV_DL_TX + t, 0);
+#endif
+#endif
+            port[t]->write((uint8_t)(TPB[t] & 0x7f));  // the & 0x7f removes the parity bit, all characters should be 7-bit anyway.
+        }
+
+        busy &= ~(1 << t);
+        TPS[t] |= 0x80;
+        if (TPS[t] & (1 << 6))
+        {
+            procNS::interrupt(INTFLOAT + (010 * t) + 4, 4);
         }
     }
+
+    // Read
+#if USE_RR == RR_REPLAY
+    receive();
+#else
+    if (!--rxwait)
+    {
+        rxwait = DL_RX_POLL;
+        receive();
+    }
+#endif
 }
 
-uint16_t read16(uint32_t a)
+// the processor is WAITing, so check for input now. Returns true if there's
+// nothing to do but wait for some
+bool idle()
 {
-    if (a >= DEV_DL_1_TTY_IN_STATUS && a <= DEV_DL_16_OUT_DATA)
+#if USE_RR == RR_RECORD
+    // leave it for the next poll, so it's logged in the order it's replayed
+    for (uint16_t l = listening; l; l &= l - 1)
     {
-        if (a >= DEV_DL_1_TTY_IN_STATUS && a <= DEV_DL_4_OUT_DATA)
+        if (port[__builtin_ctz(l)]->available())
         {
-            uint8_t t = (a >> 3) & 070;
-
-            switch (a & 0777707)
-            {
-            case DEV_DL_1_TTY_IN_STATUS:
-                return TKS[t];
-            case DEV_DL_1_TTY_IN_DATA:
-                if (TKS[t] & 0x80)
-                {
-                    TKS[t] &= 0xff7e;
-                    return TKB[t];
-                }
-                return 0;
-            case DEV_DL_1_TTY_OUT_STATUS:
-                return TPS[t];
-            case DEV_DL_1_TTY_OUT_DATA:
-                return 0;
-            default:
-                if (PRINTSIMLINES)
-                {
-                    Serial.println(F("%% dl11: read16 from invalid address"));  // " + ostr(a, 6))
-                    // panic();
-                }
-                return 0;
-            }
+            rxwait = 1;
+            return false;
         }
     }
-    else
+#elif USE_RR != RR_REPLAY
+    if (receive())
+        return false;  // its interrupt is waiting to be taken
+#endif
+    return !busy;
+}
+
+// how many more polls will pass without anything happening
+uint16_t quiet()
+{
+    if (busy)
+        return 0;  // the next poll sends it, or checks the port for room for it
+#if USE_RR == RR_REPLAY
+    return 0xFFFF;  // the input comes in on the steps it was logged on
+#else
+    return rxwait - 1;
+#endif
+}
+
+// skip n polls, n must be no more than quiet()
+void skip(uint16_t n)
+{
+#if USE_RR != RR_REPLAY
+    rxwait -= n;
+#endif
+}
+
+uint16_t read16(uint32_t a)
+{
+    const uint8_t t = (a - DEV_DL_1_TTY_IN_STATUS) >> 3;
+
+    switch (a & 6)
     {
-        if (PRINTSIMLINES)
+    case DEV_DL_1_TTY_IN_STATUS & 6:
+        return TKS[t];
+    case DEV_DL_1_TTY_IN_DATA & 6:
+        if (TKS[t] & 0x80)
         {
-            Serial.println(F("%% dl11: read16 from invalid address"));  // " + ostr(a, 6))
-            // panic();
+            TKS[t] &= 0xff7e;
+            if (port[t])
+                listening |= 1 << t;
+            return TKB[t];
         }
+        return 0;
+    case DEV_DL_1_TTY_OUT_STATUS & 6:
+        return TPS[t];
+    default:  // DEV_DL_1_TTY_OUT_DATA
+        return 0;
+    }
+}
+
+// read16 without clearing DONE when the data buffer is read
+uint16_t peek16(uint32_t a)
+{
+    if ((a & 6) == (DEV_DL_1_TTY_IN_DATA & 6))
+    {
+        const uint8_t t = (a - DEV_DL_1_TTY_IN_STATUS) >> 3;
+        return (TKS[t] & 0x80) ? TKB[t] : 0;
+    }
+    return read16(a);
+}
+
+// the high bytes are all read only, so only the low ones do anything
+void write8(uint32_t a, uint16_t v)
+{
+    if (!(a & 1))
+    {
+        write16(a, v & 0xFF);
     }
 }
 
 void write16(uint32_t a, uint16_t v)
 {
-    if (a >= DEV_DL_1_TTY_IN_STATUS && a <= DEV_DL_16_OUT_DATA)
+    const uint8_t t = (a - DEV_DL_1_TTY_IN_STATUS) >> 3;
+
+    switch (a & 6)
     {
-        if (a >= DEV_DL_1_TTY_IN_STATUS && a <= DEV_DL_4_OUT_DATA)
+    case DEV_DL_1_TTY_IN_STATUS & 6:
+        if (v & (1 << 6))
         {
-            uint8_t t = (a >> 3) & 070;
-
-            switch (a & 0777707)
-            {
-            case DEV_DL_1_TTY_IN_STATUS:
-                if (v & (1 << 6))
-                {
-                    TKS[t] |= 1 << 6;
-                }
-                else
-                {
-                    TKS[t] &= ~(1 << 6);
-                }
-                break;
-            case DEV_DL_1_TTY_OUT_STATUS:
-                if (v & (1 << 6))
-                {
-                    TPS[t] |= 1 << 6;
-                }
-                else
-                {
-                    TPS[t] &= ~(1 << 6);
-                }
-                break;
-            case DEV_DL_1_TTY_OUT_DATA:
-                TPB[t] = v & 0xff;
-                TPS[t] &= 0xff7f;
-                count = 0;
-                break;
-            case DEV_DL_1_TTY_IN_DATA:
-                break;
-            default:
-                if (PRINTSIMLINES)
-                {
-                    Serial.println(F("%% dl11: write16 to invalid address"));  // " + ostr(a, 6))
-                    // panic();
-                }
-            }
+            TKS[t] |= 1 << 6;
         }
-    }
-    else
-    {
-        if (PRINTSIMLINES)
+        else
+        {
+            TKS[t] &= ~(1 << 6);
+        }
+        break;
+    case DEV_DL_1_TTY_OUT_STATUS & 6:
+        if (v & (1 << 6))
         {
-            Serial.println(F("%% dl11: write16 to invalid address"));  // " + ostr(a, 6))
-            // panic();
+            TPS[t] |= 1 << 6;
         }
+        else
+        {
+            TPS[t] &= ~(1 << 6);
+        }
+        break;
+    case DEV_DL_1_TTY_OUT_DATA & 6:
+        TPB[t] = v & 0xff;
+        TPS[t] &= 0xff7f;
+        busy |= 1 << t;
+        break;
+    default:  // DEV_DL_1_TTY_IN_DATA
+        break;
+    }
+}
+
+#if SNAPSHOTS
+// save or load the lines' state for a checkpoint or a fork
+void snapshot(SdFile& f, bool save)
+{
+    ckpt::xfer(f, save, TKS, sizeof(TKS));
+    ckpt::xfer(f, save, TKB, sizeof(TKB));
+    ckpt::xfer(f, save, TPS, sizeof(TPS));
+    ckpt::xfer(f, save, TPB, sizeof(TPB));
+    ckpt::xfer(f, save, &busy, sizeof(busy));
+
+    // the ports may not be the same ones as when it was saved
+    listening = 0;
+    for (uint8_t t = 0; t < DL_LINES; t++)
+    {
+        if (port[t] && !(TKS[t] & 0x80))
+            listening |= 1 << t;
     }
 }
+#endif
 
 };  // namespace dl11
 
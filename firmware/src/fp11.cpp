@@ -31,6 +31,14 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
 // sam11 software emulation of DEC PDP-11/45 FP11 Floating Point Processor (FPP)
+//
+// Numbers are unpacked from DEC F or D format for the arithmetic, and packed
+// back with DEC rounding (half away from zero, or truncation with FT set).
+// An F number's 24 bit fraction fits a host double exactly, so F mode adds,
+// multiplies and divides run on the FPU, with the error of the double result
+// (which is exact to recover) telling the rounding which side of it the true
+// answer lies. A D number's 56 bit fraction doesn't fit, so D mode does the
+// same arithmetic on a 64 bit fraction in integers.
 
 #include "fp11.h"
 
@@ -38,6 +46,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #if USE_FP
 
+#include "ckpt.h"
+#include "dd11.h"
+#include "kt11.h"
 #include "sam11.h"
 
 #if USE_11_45 && !STRICT_11_40
@@ -48,253 +59,535 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define procNS kd11
 #endif
 
+#include <math.h>
+#include <string.h>
+
 namespace fp11 {
-uint32_t PC;        // Program Counter
-uint16_t FEA;       // Error PC
-uint16_t FEC;       // Error code
-uint16_t FPS;       // Status/Error bits
-uint8_t modelen;    // Num words in instruction: 1 = immediate, 2 = real, 4 = double
-uint8_t precislen;  // Num words in number: 2 = real, 4 = double
-uint32_t res[8];    // Results/Working registers (actually 7)
-uint32_t SCR;       // Scratchpad -> 4x 16-bits to make a 64-bit number
-uint32_t AC[6];     // Accumilator Registers
-
-uint32_t incV(uint32_t v)
+
+PERMACHINE uint16_t FPS;    // Status
+PERMACHINE uint16_t FEC;    // Exception code
+PERMACHINE uint16_t FEA;    // Exception address
+PERMACHINE uint64_t AC[6];  // Accumulators
+
+static PERMACHINE uint8_t pending;  // maskable error to trap on once the result is stored
+
+// A number unpacked for arithmetic, worth frac / 2^64 * 2^(exp - 0200). The
+// hidden bit is bit 63 of frac once normalised, and zero has frac == 0
+struct unpacked {
+    bool sign;
+    int32_t exp;
+    uint64_t frac;
+};
+
+void reset()
+{
+    FPS = 0;
+    FEC = 0;
+    FEA = 0;
+    for (uint8_t i = 0; i < 6; i++)
+    {
+        AC[i] = 0;
+    }
+}
+
+// Record an error and trap through 244, unless interrupts are disabled
+static void fail(const uint8_t code)
+{
+    FPS |= FER;
+    FEC = code;
+    FEA = procNS::curPC;
+    if (!(FPS & FID))
+    {
+        longjmp(trapbuf, INTFPUERR);
+    }
+}
+
+static uint16_t read16(const uint16_t a)
 {
-    return ((v & 0200000) | ((v + 2) & 0177777));
+    return dd11::read16(kt11::decode_instr(a, false, procNS::curuser));
 }
 
-void zero(uint32_t* number)
+static void write16(const uint16_t a, const uint16_t v)
 {
-    if (precislen == 2)
-        *number &= 0xFFFF0000;
-    if (precislen == 4)
-        *number &= 0x00000000;
+    dd11::write16(kt11::decode_instr(a, true, procNS::curuser), v);
 }
 
-void test(uint32_t* number)
+static uint16_t fetch16()
 {
-    FPS &= 0177760;
-    if (!(*number & (expmask << 16)))
+    const uint16_t val = read16(procNS::R[7]);
+    procNS::R[7] += 2;
+    return val;
+}
+
+// Address of an operand len bytes long, like aget in the cpu but stepping the
+// register by len in the auto modes, except for the PC (immediate, which is
+// only ever one word) and the deferred modes, which step by a word
+static uint16_t operand(uint8_t v, const uint8_t len)
+{
+    if ((v & 070) == 000)
     {
-        FPS |= 4;  // Z bit
+        return 0;  // register, which the caller deals with
     }
-    if (*number & (signmask << 16))
+
+    const uint8_t l = (((v & 7) == 7) || (v & 010)) ? 2 : len;
+    uint32_t addr = 0;
+    switch (v & 060)
     {
-        FPS |= 8;  // N Bit
+    case 000:
+        v &= 007;
+        addr = procNS::R[v & 07];
+        break;
+    case 020:
+        addr = procNS::R[v & 07];
+        procNS::R[v & 07] += l;
+        break;
+    case 040:
+        procNS::R[v & 07] -= l;
+        addr = procNS::R[v & 07];
+        break;
+    case 060:
+        addr = fetch16();
+        addr += procNS::R[v & 07];
+        break;
     }
-}
 
-void trap(int err)
-{
-    FPS |= 0100000;  // Set FER - floating point error
-    FEC = err;
-    FEA = (PC - 2) & 0177777;
-    if (!(FPS & 040000))  // check interrupt enable
+    if (v & 010)
     {
-        longjmp(trapbuf, INTFPP);  // call interrupt
+        addr = read16(addr);
     }
+
+    return addr;
 }
 
-void copy(uint32_t* number, uint32_t* operand)
+// Accumulator n as a number len bytes long
+static uint64_t getac(const uint8_t n, const uint8_t len)
 {
-    *number = *operand;
+    return (len == 8) ? AC[n] : (AC[n] & 0xFFFFFFFF00000000ULL);
 }
 
-void testI(uint32_t* number)
+// Set accumulator n, which in F mode leaves the bottom 32 bits alone
+static void setac(const uint8_t n, const uint8_t len, const uint64_t v)
 {
-    FPS &= 0177760;  //   8 - N,  4 - Z,  2 - V,  1 - C
-    if (*number < 0)
-        FPS |= 8;  // N Bit
-    if (*number == 0)
-        FPS |= 4;  // Z bit
+    AC[n] = (len == 8) ? v : ((AC[n] & 0xFFFFFFFFULL) | (v & 0xFFFFFFFF00000000ULL));
 }
 
-void pack(uint32_t* number, uint32_t exponent, uint8_t sign)
+// Load a floating operand from a (or an accumulator in mode 0) into D format
+static uint64_t loadf(const uint8_t v, const uint16_t a, const uint8_t len)
 {
-    int condition = 0;  //   8 - N,  4 - Z,  2 - V,  1 - C
-    if (exponent <= 0)
-    {
-        exponent &= 0377;
-        if (FPS & 02000)
-        {                    // FIU - Floating interrupt on underflow
-            trap(ERRUNDER);  // 10 Floating underflow
-            if (!exponent)
-                condition |= 4;  // Z bit
+    uint64_t val;
+    if ((v & 070) == 000)
+    {
+        val = getac(v & 07, len);
+    }
+    else
+    {
+        val = (uint64_t)read16(a) << 48;
+        if (v != 027)  // immediate is only the first word
+        {
+            val |= (uint64_t)read16(a + 2) << 32;
+            if (len == 8)
+            {
+                val |= (uint64_t)read16(a + 4) << 16;
+                val |= read16(a + 6);
+            }
         }
-        else
+    }
+    if ((FPS & FIUV) && (val >> 63) && !((val >> 55) & 0377))
+    {
+        fail(ERRUNDEF);  // -0
+    }
+    return val;
+}
+
+// Store a floating operand to a (or an accumulator in mode 0) from D format
+static void storef(const uint8_t v, const uint16_t a, const uint8_t len, const uint64_t val)
+{
+    if ((v & 070) == 000)
+    {
+        setac(v & 07, len, val);
+        return;
+    }
+    write16(a, val >> 48);
+    if (v != 027)
+    {
+        write16(a + 2, val >> 32);
+        if (len == 8)
         {
-            zero(number);
-            sign = 0;
-            exponent = 0;
-            condition |= 4;  // Z bit
+            write16(a + 4, val >> 16);
+            write16(a + 6, val);
         }
     }
+}
+
+// Load an integer operand len bytes long. A general register (mode 0) or an
+// immediate only give the high word of a long
+static int32_t loadi(const uint8_t v, const uint8_t len)
+{
+    uint32_t hi, lo = 0;
+    if ((v & 070) == 000)
+    {
+        hi = procNS::R[v & 07] & 0xFFFF;
+    }
     else
     {
-        if (exponent >= 0400)
+        const uint16_t a = operand(v, len);
+        hi = read16(a);
+        if ((len == 4) && (v != 027))
         {
-            exponent &= 0377;  // 0200;
-            if (FPS & 01000)
-            {                   // FIV - Floating interrupt on overflow
-                trap(ERROVER);  // 8 Floating overflow
-                if (!exponent)
-                    condition |= 4;  // Z bit
-            }
-            else
-            {
-                zero(number);
-                sign = 0;
-                exponent = 0;
-                condition |= 4;  // Z bit
-            }
-            condition |= 2;  // V bit
+            lo = read16(a + 2);
         }
     }
-    *number = (*number & 0xFFFF0000) | (sign | (exponent << expshift) | (*number & (fractionmask << 16)));
-    if (sign)
+    if (len == 2)
     {
-        condition |= 8;  // N bit
+        return (int16_t)hi;
     }
-    FPS = (FPS & 0177760) | condition;
+    return (int32_t)((hi << 16) | lo);
 }
 
-void LDEXP(uint32_t* number, uint32_t exponent)
+// Store an integer operand len bytes long, only the high word of a long to a
+// general register (mode 0) or an immediate
+static void storei(const uint8_t v, const uint8_t len, const int32_t val)
 {
-    uint8_t sign;
-    sign = !!(*number & (signmask << 16));
-    *number = (*number & (fractionmask << 16)) | hiddenmask;
-    if (exponent & 0100000)
+    const uint16_t hi = (len == 4) ? ((uint32_t)val >> 16) : val;
+    if ((v & 070) == 000)
     {
-        exponent = exponent - 0200000;
+        procNS::R[v & 07] = hi;
+        return;
     }
-    exponent += expbias;
-    pack(number, exponent, sign);
+    const uint16_t a = operand(v, len);
+    write16(a, hi);
+    if ((len == 4) && (v != 027))
+    {
+        write16(a + 2, val);
+    }
+}
+
+// FN and FZ for a number in D format
+static uint16_t cc(const uint64_t val)
+{
+    return ((val >> 63) ? FN : 0) | (((val >> 55) & 0377) ? 0 : FZ);
+}
+
+// Copy the floating condition codes to the processor's
+static void cfcc()
+{
+    procNS::flags();
+    procNS::PS = (procNS::PS & 0177760) | (FPS & 017);
+}
+
+static unpacked unpack(const uint64_t val)
+{
+    unpacked u;
+    u.exp = (val >> 55) & 0377;
+    u.sign = u.exp && (val >> 63);  // anything with a 0 exponent is 0
+    u.frac = u.exp ? ((val << 8) | (1ULL << 63)) : 0;
+    return u;
 }
 
-void CMPF(uint32_t src1, uint32_t src2)
+// Normalise, round to the precision of a number len bytes long, and pack u.
+// On overflow (which sets FV) or underflow the result is 0, unless the error's
+// interrupt is enabled, in which case the exponent wraps around and the error
+// traps once the result is stored
+static uint64_t pack(unpacked u, const uint8_t len)
 {
-    uint32_t result = 0;
-    FPS &= 0177760;
-    if ((src1 | src2) & (expmask << 16))  // If both exponents zero then finished!
+    if (!u.frac)
     {
-        if ((src1 ^ src2) & (signmask << 16))  // For different signs + is larger
+        return 0;
+    }
+    const uint8_t z = __builtin_clzll(u.frac);
+    u.frac <<= z;
+    u.exp -= z;
+
+    const uint64_t lsb = (len == 8) ? (1ULL << 8) : (1ULL << 40);
+    if (!(FPS & FT))
+    {
+        u.frac += lsb >> 1;
+        if (u.frac < (lsb >> 1))  // carried out of the top
         {
-            result = 1;
+            u.frac = 1ULL << 63;
+            u.exp++;
         }
-        else
-        {                                                                            // For same sign and both not zero then need to compare fractions
-            result = (src1 & ~(FPPsignMask << 16)) - (src2 & ~(FPPsignMask << 16));  // Difference exponent and initial fraction
-            if (!result)
-            {  // If zero compare rest
-                for (int i = 1; i < precislen; i++)
-                {
-                    result = src1[i] - src2[i];
-                    if (result)
-                    {
-                        break;
-                    }
-                }
-            }
+    }
+    u.frac &= ~(lsb - 1);
+
+    if (u.exp > 0377)
+    {
+        FPS |= FV;
+        if (!(FPS & FIV))
+        {
+            return 0;
         }
+        pending = ERROVER;
     }
-    if (!result)
+    else if (u.exp <= 0)
     {
-        FPS |= 4;  // Zero flag
+        if (!(FPS & FIU))
+        {
+            return 0;
+        }
+        pending = ERRUNDER;
     }
-    else
+    return ((uint64_t)u.sign << 63) | ((uint64_t)(u.exp & 0377) << 55) | ((u.frac << 1) >> 9);
+}
+
+static double todouble(const unpacked& u)
+{
+    if (!u.frac)
+    {
+        return 0;
+    }
+    // 0.1f * 2^(exp - 0200) is 1.f * 2^(exp - 0201), and doubles are biased by 1023
+    const uint64_t bits = ((uint64_t)u.sign << 63) | ((uint64_t)(u.exp + 894) << 52) | ((u.frac << 1) >> 12);
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+// Unpack d, where the exact answer is d + err. err is under half a unit in
+// the last place of d, so only its sign matters: a true value just below d
+// comes out as one less in the bottom of frac, which rounds and truncates the
+// same way it would
+static unpacked fromdouble(const double d, const double err)
+{
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    unpacked u;
+    u.sign = bits >> 63;
+    u.exp = (int32_t)((bits >> 52) & 03777) - 894;
+    u.frac = (d != 0) ? ((bits << 11) | (1ULL << 63)) : 0;
+    if (u.frac && (err != 0) && ((signbit(err) != 0) != u.sign))
+    {
+        u.frac--;  // pack normalises it again if d was a power of 2
+    }
+    return u;
+}
+
+// 64 x 64 bit multiply, giving the high half and leaving the low half in lo
+static uint64_t mul64(const uint64_t a, const uint64_t b, uint64_t* lo)
+{
+    const uint64_t ll = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    const uint64_t lh = (a & 0xFFFFFFFF) * (b >> 32);
+    const uint64_t hl = (a >> 32) * (b & 0xFFFFFFFF);
+    const uint64_t hh = (a >> 32) * (b >> 32);
+    const uint64_t mid = (ll >> 32) + (lh & 0xFFFFFFFF) + (hl & 0xFFFFFFFF);
+    *lo = (mid << 32) | (ll & 0xFFFFFFFF);
+    return hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+}
+
+static unpacked add(unpacked a, unpacked b, const uint8_t len)
+{
+    if (len == 4)
     {
-        if (src1 & (signmask << 16))
+        const double x = todouble(a);
+        const double y = todouble(b);
+        const double s = x + y;
+        const double t = s - x;
+        return fromdouble(s, (x - (s - t)) + (y - t));  // s + err is exactly x + y
+    }
+
+    if (!b.frac)
+    {
+        return a;
+    }
+    if (!a.frac)
+    {
+        return b;
+    }
+    if ((a.exp < b.exp) || ((a.exp == b.exp) && (a.frac < b.frac)))
+    {
+        const unpacked t = a;
+        a = b;
+        b = t;
+    }
+    // line up the smaller one, and if any bits fall off the bottom, take one
+    // more off a difference so it's truncated the right way
+    const int32_t d = a.exp - b.exp;
+    const uint64_t f = (d < 64) ? (b.frac >> d) : 0;
+    const bool lost = (d < 64) ? ((b.frac & ((1ULL << d) - 1)) != 0) : true;
+    if (a.sign == b.sign)
+    {
+        const uint64_t sum = a.frac + f;
+        if (sum < a.frac)
         {
-            result = -result;
+            a.frac = (sum >> 1) | (1ULL << 63);
+            a.exp++;
         }
-        if (result < 0)
+        else
+        {
+            a.frac = sum;
+        }
+    }
+    else
+    {
+        a.frac = a.frac - f - lost;
+        a.sign = a.sign && a.frac;
+    }
+    return a;
+}
+
+static unpacked mul(unpacked a, const unpacked& b, const uint8_t len)
+{
+    if (len == 4)
+    {
+        return fromdouble(todouble(a) * todouble(b), 0);  // 24 x 24 bits is exact
+    }
+
+    if (!a.frac || !b.frac)
+    {
+        a.frac = 0;
+        return a;
+    }
+    uint64_t lo;
+    a.sign ^= b.sign;
+    a.exp += b.exp - 0200;
+    a.frac = mul64(a.frac, b.frac, &lo);
+    if (!(a.frac >> 63))
+    {
+        a.frac = (a.frac << 1) | (lo >> 63);  // keep 64 bits, which MODF uses
+        a.exp--;
+    }
+    return a;
+}
+
+// b must not be 0
+static unpacked div(unpacked a, const unpacked& b, const uint8_t len)
+{
+    if (len == 4)
+    {
+        const double x = todouble(a);
+        const double y = todouble(b);
+        const double q = x / y;
+        const double r = fma(-q, y, x);  // exactly x - q * y, so q + r / y is exact
+        return fromdouble(q, (y < 0) ? -r : r);
+    }
+
+    if (!a.frac)
+    {
+        return a;
+    }
+    a.sign ^= b.sign;
+    a.exp -= b.exp - 0200;
+    uint64_t r = a.frac;
+    uint64_t q = 0;
+    uint8_t n = 64;
+    if (r >= b.frac)
+    {
+        r -= b.frac;
+        q = 1;
+        n = 63;
+        a.exp++;
+    }
+    while (n--)
+    {
+        const bool carry = r >> 63;
+        r <<= 1;
+        q <<= 1;
+        if (carry || (r >= b.frac))
         {
-            FPS |= 8;  // Negative flag
+            r -= b.frac;
+            q |= 1;
         }
     }
+    a.frac = q;
+    return a;
+}
+
+// < 0, 0 or > 0 as a is less than, equal to or greater than b
+static int8_t compare(const unpacked& a, const unpacked& b)
+{
+    if (a.sign != b.sign)
+    {
+        return a.sign ? -1 : 1;
+    }
+    int8_t m = 0;
+    if ((a.exp != b.exp) || (a.frac != b.frac))
+    {
+        m = ((a.exp < b.exp) || ((a.exp == b.exp) && (a.frac < b.frac))) ? -1 : 1;
+    }
+    return a.sign ? -m : m;
 }
 
-void CMP() { }
+// Whether an op's operand is floating point, rather than an integer, an
+// exponent or status
+static bool floating(const uint16_t instr)
+{
+    switch (instr & 07400)
+    {
+    case 0000000:  // misc ops
+    case 0005000:  // STEXP
+    case 0005400:  // STCFI
+    case 0006400:  // LDEXP
+    case 0007000:  // LDCIF
+        return false;
+    default:
+        return true;
+    }
+}
 
-int step(uint32_t instr)
+void step(const uint16_t instr)
 {
-    uint32_t tAC, res, v;
-    PC = procNS::curPC;
-    tAC = (instr >> 6) & 03;
+    const uint8_t ac = (instr >> 6) & 03;
+    const uint8_t v = instr & 077;
+    const uint8_t len = (FPS & FD) ? 8 : 4;
+    const uint8_t ilen = (FPS & FL) ? 4 : 2;
+    pending = 0;
+
+    if (((v & 076) == 006) && floating(instr))
+    {
+        fail(ERROP);  // there's no AC6 or AC7
+        return;
+    }
+
     switch (instr & 07400)
     {
     case 0000000:  // misc ops
         {
-            switch (tAC)
+            switch (ac)
             {
-            case 0:  // group 0
+            case 0:
                 {
-                    switch (instruction & 077)
+                    switch (v)
                     {
-                    case 0:  // 000 CFCC Copy Floating Condition Codes
-                        flags();
+                    case 000:  // CFCC Copy Floating Condition Codes
+                        cfcc();
                         break;
-                    case 1:  // 001 SETF Set Floating Mode
-                        FPS &= 0177577;
-                        precislen = 2;  // Floating is two word precision
+                    case 001:  // SETF Set Floating Mode
+                        FPS &= ~FD;
                         break;
-                    case 2:  // 002 SETI Set Integer Mode
-                        FPS &= 0177677;
+                    case 002:  // SETI Set Integer Mode
+                        FPS &= ~FL;
                         break;
-                    case 3:  // 003 LDUP - not valid on all systems
-                        trap(2);
+                    case 011:  // SETD Set Floating Double Mode
+                        FPS |= FD;
                         break;
-                    case 9:  // 011 SETD Set Floating Double Mode
-                        FPS |= 0200;
-                        precislen = 4;  // Double is four word precision
+                    case 012:  // SETL Set Long Integer Mode
+                        FPS |= FL;
                         break;
-                    case 10:  // 012 SETL Set Long Integer Mode
-                        FPS |= 0100;
-                        break;
-                    default:
-                        trap(ERRNOP);  // Unknown opcode
+                    default:  // including LDUB, maintenance only
+                        fail(ERROP);
                         break;
                     }
                     break;
                 }
-            case 1:  // load fpp status
+            case 1:  // LDFPS Load FPP Program Status
+                FPS = loadi(v, 2) & 0147777;
+                break;
+            case 2:  // STFPS Store FPP Program Status
+                storei(v, 2, FPS);
+                break;
+            case 3:  // STST Store FEC and FEA (just FEC to a general register)
                 {
-                    if ((res = read16(instr)) >= 0)
+                    if ((v & 070) == 000)
                     {
-                        FPS = res & 0147777;
-                        if (!(FPS & 0200))  // FD - Double precision mode
-                        {
-                            precislen = 2;  // Floating is two word precision
-                        }
-                        else
-                        {
-                            precislen = 4;  // Double is four word precision
-                        }
-                    }
-                    break;
-                }
-            case 2:  // store fpp prog status
-                {
-                    write16(instr, FPS);
-                    break;
-                }
-            case 3:  // store fec and fea
-                {
-                    // FEC only for general register
-                    if (!(instr & 070))
-                    {
-                        procNS::R[instr & 07] = FEC;
+                        procNS::R[v & 07] = FEC;
                     }
                     else
                     {
-                        if ((v = aget(instr, MMU_WRITE | 4)) >= 0)
+                        const uint16_t a = operand(v, 4);
+                        write16(a, FEC);
+                        if (v != 027)
                         {
-                            if (write16(v, FEC) >= 0)
-                            {
-                                v = incv(v);
-                                write16(v, FEA);
-                            }
+                            write16(a + 2, FEA);
                         }
                     }
                     break;
@@ -304,71 +597,216 @@ int step(uint32_t instr)
         }
     case 0000400:  // Single Operand
         {
-            switch (tAC)
+            const uint16_t a = operand(v, len);
+            uint64_t val = 0;
+            FPS &= 0177760;
+            switch (ac)
             {
-            case 0:  // CLRF - Clear Float/Double
-                {
-                    zero(&SCR);
-                    if (writeF(instr, SCR) >= 0)
-                    {
-                        test(&SCR);
-                    }
-                    break;
-                }
-            case 1:  // TSTF - Test Float/Double
+            case 0:  // CLRF Clear Fl/Db
+                storef(v, a, len, val);
+                break;
+            case 1:  // TSTF Test Fl/Db
+                val = loadf(v, a, len);
+                break;
+            case 2:  // ABSF Make Absolute Fl/Db
+                val = loadf(v, a, len);
+                val = ((val >> 55) & 0377) ? (val & ~(1ULL << 63)) : 0;
+                storef(v, a, len, val);
+                break;
+            case 3:  // NEGF Negate Fl/Db
+                val = loadf(v, a, len);
+                val = ((val >> 55) & 0377) ? (val ^ (1ULL << 63)) : 0;
+                storef(v, a, len, val);
+                break;
+            }
+            FPS |= cc(val);
+            break;
+        }
+    case 0001000:  // MULF Multiply Fl/Db
+    case 0002000:  // ADDF Add Fl/Db
+    case 0003000:  // SUBF Subtract Fl/Db
+    case 0004400:  // DIVF Divide Fl/Db
+        {
+            const unpacked x = unpack(getac(ac, len));
+            unpacked y = unpack(loadf(v, operand(v, len), len));
+            unpacked r;
+            switch (instr & 07400)
+            {
+            case 0001000:
+                r = mul(x, y, len);
+                break;
+            case 0002000:
+                r = add(x, y, len);
+                break;
+            case 0003000:
+                y.sign = !y.sign && y.frac;
+                r = add(x, y, len);
+                break;
+            default:
+                if (!y.frac)
                 {
-                    if (readF(instr, SCR) >= 0)
-                    {
-                        test(&SCR);
-                    }
-                    break;
+                    fail(ERRDIV);  // the accumulator is left alone
+                    return;
                 }
-            case 2:  // ABSF - Make Absolute Fl/Db
-                {
-                    if (readF(instr, SCR) != -1)
-                    {
-                        if (!(SCR & (expmask << 16)))
-                        {
-                            zero(&SCR);
-                        }
-                        else
-                        {
-                            SCR &= ~(signmask << 16);
-                        }
-                        if (modF(&SCR) >= 0)
-                        {
-                            test(&SCR);
-                        }
-                    }
-                    break;
-                }
-            case 3:  // NEGF - Negate Fl/Db
+                r = div(x, y, len);
+                break;
+            }
+            FPS &= 0177760;
+            const uint64_t val = pack(r, len);
+            setac(ac, len, val);
+            FPS |= cc(val);
+            break;
+        }
+    case 0001400:  // MODF Multiply and split into integer and fraction
+        {
+            const unpacked x = unpack(getac(ac, len));
+            const unpacked y = unpack(loadf(v, operand(v, len), len));
+            unpacked p = mul(x, y, len);
+            if (p.frac)
+            {
+                const uint8_t z = __builtin_clzll(p.frac);
+                p.frac <<= z;
+                p.exp -= z;
+            }
+            unpacked i = p;
+            // the number of bits before the binary point
+            const int32_t n = p.exp - 0200;
+            if (!p.frac || (n <= 0))
+            {
+                i.frac = 0;
+            }
+            else if (n >= ((len == 8) ? 56 : 24))
+            {
+                p.frac = 0;  // no room for any fraction
+            }
+            else
+            {
+                i.frac &= ~((1ULL << (64 - n)) - 1);
+                p.frac <<= n;
+                p.exp -= n;
+            }
+            FPS &= 0177760;
+            setac(ac | 1, len, pack(i, len));
+            const uint64_t val = pack(p, len);
+            setac(ac, len, val);
+            FPS |= cc(val);
+            break;
+        }
+    case 0002400:  // LDF Load Fl/Db
+        {
+            const uint64_t val = loadf(v, operand(v, len), len);
+            setac(ac, len, val);
+            FPS = (FPS & 0177760) | cc(val);
+            break;
+        }
+    case 0003400:  // CMPF Compare Fl/Db
+        {
+            const unpacked y = unpack(loadf(v, operand(v, len), len));
+            const int8_t c = compare(y, unpack(getac(ac, len)));
+            FPS = (FPS & 0177760) | ((c < 0) ? FN : 0) | ((c == 0) ? FZ : 0);
+            break;
+        }
+    case 0004000:  // STF Store Fl/Db
+        storef(v, operand(v, len), len, getac(ac, len));
+        break;
+    case 0005000:  // STEXP Store Exponent
+        {
+            const int16_t e = ((AC[ac] >> 55) & 0377) - 0200;
+            storei(v, 2, e);
+            FPS = (FPS & 0177760) | ((e < 0) ? FN : 0) | ((e == 0) ? FZ : 0);
+            cfcc();
+            break;
+        }
+    case 0005400:  // STCFI Store and Convert Fl/Db to Int/Long
+        {
+            const unpacked x = unpack(getac(ac, len));
+            const int32_t n = x.exp - 0200;
+            const uint32_t lim = (ilen == 4) ? 0x80000000 : 0x8000;
+            uint32_t mag = 0;
+            bool err = false;
+            if (x.frac && (n > 0))
+            {
+                mag = (n <= 32) ? (x.frac >> (64 - n)) : 0;  // truncates, whatever FT is
+                err = (n > 32) || (mag > (lim - !x.sign));
+            }
+            int32_t i = x.sign ? (int32_t)(0 - mag) : (int32_t)mag;
+            if (err)
+            {
+                i = 0;
+                if (FPS & FIC)
                 {
-                    break;
+                    pending = ERRCONV;
                 }
             }
+            storei(v, ilen, i);
+            FPS = (FPS & 0177760) | ((i < 0) ? FN : 0) | ((i == 0) ? FZ : 0) | (err ? FC : 0);
+            cfcc();
             break;
         }
-        // Double Operands
-    case 0001000:  // MULF - Multiply Fl/Db
-    case 0001400:  // MODF - Multiply and case to int
-    case 0002000:  // ADDF - Add fl/db
-    case 0002400:  // LDF - load fl/db
-    case 0003000:  // SUBF - Subtract
-    case 0003400:  // CMPF - Compare
-    case 0004000:  // STF - Store
-    case 0004400:  // DIVF - Divide
-    case 0005000:  // STEXP - Store Exponent
-    case 0005400:  // STCFI - Convert to int or long
-    case 0006000:  // STCFD - Store while convert float to double
-    case 0006400:  // LDEXP - Load exponent
-    case 0007000:  // LDCIF - Convert int/long to fl/db
-    case 0007400:  // LDCDF - Load convert fl/db to double
-    default:
-        trap(ERRNOP);
+    case 0006000:  // STCFD Store and Convert Fl/Db to Db/Fl
+        {
+            const uint8_t olen = 12 - len;
+            FPS &= 0177760;
+            const uint64_t val = pack(unpack(getac(ac, len)), olen);
+            storef(v, operand(v, olen), olen, val);
+            FPS |= cc(val);
+            break;
+        }
+    case 0006400:  // LDEXP Load Exponent
+        {
+            // the sign and fraction stay, even in a zero
+            unpacked x;
+            x.sign = AC[ac] >> 63;
+            x.exp = loadi(v, 2) + 0200;
+            x.frac = (getac(ac, len) << 8) | (1ULL << 63);
+            FPS &= 0177760;
+            const uint64_t val = pack(x, len);
+            setac(ac, len, val);
+            FPS |= cc(val);
+            break;
+        }
+    case 0007000:  // LDCIF Load and Convert Int/Long to Fl/Db
+        {
+            const int32_t i = loadi(v, ilen);
+            unpacked x;
+            x.sign = i < 0;
+            x.exp = 0200 + 32;
+            x.frac = (uint64_t)(x.sign ? -(uint32_t)i : (uint32_t)i) << 32;
+            FPS &= 0177760;
+            const uint64_t val = pack(x, len);
+            setac(ac, len, val);
+            FPS |= cc(val);
+            break;
+        }
+    case 0007400:  // LDCDF Load and Convert Db/Fl to Fl/Db
+        {
+            const uint8_t olen = 12 - len;
+            const unpacked x = unpack(loadf(v, operand(v, olen), olen));
+            FPS &= 0177760;
+            const uint64_t val = pack(x, len);
+            setac(ac, len, val);
+            FPS |= cc(val);
+            break;
+        }
+    }
+
+    if (pending)
+    {
+        fail(pending);
     }
 }
 
+#if SNAPSHOTS
+// save or load the floating point state for a checkpoint or a fork
+void snapshot(SdFile& f, bool save)
+{
+    ckpt::xfer(f, save, &FPS, sizeof(FPS));
+    ckpt::xfer(f, save, &FEC, sizeof(FEC));
+    ckpt::xfer(f, save, &FEA, sizeof(FEA));
+    ckpt::xfer(f, save, AC, sizeof(AC));
+}
+#endif
+
 };  // namespace fp11
 
-#endif
\ No newline at end of file
+#endif
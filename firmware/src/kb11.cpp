@@ -38,7 +38,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #if USE_11_45 && !STRICT_11_40
 
 #include "bootrom.h"
+#include "ckpt.h"
 #include "dd11.h"
+#include "dh11.h"
+#include "dl11.h"
+#include "fp11.h"
 #include "kl11.h"
 #include "kt11.h"
 #include "kw11.h"
@@ -49,26 +53,36 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "sam11.h"
 
 #include <SdFat.h>
+#include <math.h>
+#include <string.h>
 
-pdp11::intr itab[ITABN];
+PERMACHINE pdp11::intr itab[ITABN];
 
 namespace kb11 {
 
-// signed integer registers -- change to R[2][8]
-volatile int32_t R[8];  // R6 = SP, R7 = PC
+// signed integer registers, with the current register set in R0-R5 and the
+// current mode's stack pointer in R6
+PERMACHINE volatile int32_t R[8];  // R6 = SP, R7 = PC
 
-volatile uint16_t PS;     // Processor Status
-volatile uint16_t curPC;  // R7, address of current instruction
-volatile uint16_t KSP;    // R6 (kernel), stack pointer
-volatile uint16_t USP;    // R6 (user), stack pointer
-volatile uint16_t SSP;    // R6 (Super), stack pointer
+PERMACHINE volatile uint16_t PS;           // Processor Status
+PERMACHINE volatile uint16_t curPC;        // R7, address of current instruction
+PERMACHINE volatile uint16_t bankSP[4];    // R6 of each mode while it's not the current one, by mode
+PERMACHINE volatile uint16_t bankR[2][6];  // R0-R5 of each register set while it's not the current one
+PERMACHINE uint8_t regset;                 // register set in R0-R5, PS bit 11
 
-volatile uint8_t curuser;   // 0: kernel, 1: supervisor, 2: illegal, 3: user
-volatile uint8_t prevuser;  // 0: kernel, 1: supervisor, 2: illegal, 3: user
+PERMACHINE volatile uint8_t curuser;   // 0: kernel, 1: supervisor, 2: illegal, 3: user
+PERMACHINE volatile uint8_t prevuser;  // 0: kernel, 1: supervisor, 2: illegal, 3: user
 
-bool trapped = false;
-bool cont_with = false;
-bool waiting = false;
+PERMACHINE bool trapped = false;
+PERMACHINE bool cont_with = false;
+PERMACHINE bool waiting = false;
+
+#if DECODE_CACHE
+PERMACHINE decoded dcache[DECODE_CACHE];
+#endif
+PERMACHINE bool spinning = false;  // polling a device status register, see spinloop()
+PERMACHINE uint32_t elided = 0;    // instructions skipped by loop0 in polling loops
+PERMACHINE bool copying = false;   // in a loop copying or clearing memory, see blockloop()
 
 #include "./cpu/cpu_bus.cpp.h"
 
@@ -81,10 +95,13 @@ void reset(void)
         R[i] = 0;
     }
     kt11::SLR = 0400;
+    flags();
     PS = 0;
-    KSP = 0;
-    SSP = 0;
-    USP = 0;
+    for (i = 0; i < 4; i++)
+    {
+        bankSP[i] = 0;
+    }
+    regset = 0;
     curuser = 0;
     prevuser = 0;
     kt11::SR0 = 0;
@@ -93,7 +110,16 @@ void reset(void)
     kt11::SR3 = 0;
     curPC = 0;
     kw11::reset();
+#if USE_FP
+    fp11::reset();
+#endif
     ms11::clear();
+#if DECODE_CACHE
+    for (i = 0; i < DECODE_CACHE; i++)
+    {
+        dcache[i].pa = 1;  // never an instruction address
+    }
+#endif
     for (i = 0; i < BOOT_LEN; i++)
     {
         dd11::write16(BOOT_START + (i * 2), bootrom_rk0[i]);
@@ -101,6 +127,12 @@ void reset(void)
     R[7] = BOOT_START;
     kl11::reset();
     rk11::reset();
+#if DL_TTYS
+    dl11::reset();
+#endif
+#if USE_DH
+    dh11::reset();
+#endif
     waiting = false;
 
 #ifdef PIN_OUT_PROC_RUN
@@ -110,66 +142,33 @@ void reset(void)
 
 #include "./cpu/cpu_core.cpp.h"
 
-// switch the processor mode
+// switch the processor mode, which swaps R6 for the new mode's stack pointer.
+// The mode LEDs are left to loop0, which samples curuser
 void switchmode(uint8_t newm)
 {
     prevuser = curuser;
     curuser = newm;
-    if (prevuser == 3)
-    {
-        USP = R[6];
-    }
-    else if (prevuser == 1)
-    {
-        SSP = R[6];
-    }
-    else
-    {
-        KSP = R[6];
-    }
+    bankSP[prevuser] = R[6];
+    R[6] = bankSP[curuser];
+    PS &= 0007777;
+    PS |= ((curuser & 03) << 14);
+    PS |= ((prevuser & 03) << 12);
+}
 
-    if (curuser == 3)
-    {
-#ifdef PIN_OUT_USER_MODE
-        digitalWrite(PIN_OUT_USER_MODE, LED_ON);
-#endif
-#ifdef PIN_OUT_SUPER_MODE
-        digitalWrite(PIN_OUT_SUPER_MODE, LED_OFF);
-#endif
-#ifdef PIN_OUT_KERNEL_MODE
-        digitalWrite(PIN_OUT_KERNEL_MODE, LED_OFF);
-#endif
-        R[6] = USP;
-    }
-    if (curuser == 1)
+// swap R0-R5 for the register set PS selects, if it has changed
+void switchset()
+{
+    const uint8_t set = (PS >> 11) & 1;
+    if (set == regset)
     {
-#ifdef PIN_OUT_SUPER_MODE
-        digitalWrite(PIN_OUT_SUPER_MODE, LED_ON);
-#endif
-#ifdef PIN_OUT_USER_MODE
-        digitalWrite(PIN_OUT_USER_MODE, LED_OFF);
-#endif
-#ifdef PIN_OUT_KERNEL_MODE
-        digitalWrite(PIN_OUT_KERNEL_MODE, LED_OFF);
-#endif
-        R[6] = SSP;
+        return;
     }
-    else
+    for (uint8_t i = 0; i < 6; i++)
     {
-#ifdef PIN_OUT_USER_MODE
-        digitalWrite(PIN_OUT_USER_MODE, LED_OFF);
-#endif
-#ifdef PIN_OUT_SUPER_MODE
-        digitalWrite(PIN_OUT_SUPER_MODE, LED_OFF);
-#endif
-#ifdef PIN_OUT_KERNEL_MODE
-        digitalWrite(PIN_OUT_KERNEL_MODE, LED_ON);
-#endif
-        R[6] = KSP;
+        bankR[regset][i] = R[i];
+        R[i] = bankR[set][i];
     }
-    PS &= 0007777;
-    PS |= ((curuser & 03) << 14);
-    PS |= ((prevuser & 03) << 12);
+    regset = set;
 }
 
 #include "./cpu/cpu_debug.cpp.h"  // includes debug functions
@@ -178,30 +177,13 @@ void switchmode(uint8_t newm)
 // Move from previous instr
 static void MFPI(uint16_t instr)
 {
+    flags();
     uint8_t d = instr & 077;
     uint16_t da = aget(d, 2);
     uint16_t uval;
     if (da == 0170006)
     {
-        if (curuser == prevuser)
-        {
-            uval = R[6];
-        }
-        else
-        {
-            if (prevuser == 3)
-            {
-                uval = USP;
-            }
-            else if (prevuser == 1)
-            {
-                uval = SSP;
-            }
-            else
-            {
-                uval = KSP;
-            }
-        }
+        uval = (curuser == prevuser) ? R[6] : bankSP[prevuser];
     }
     else if (isReg(da))
     {
@@ -214,7 +196,15 @@ static void MFPI(uint16_t instr)
     }
     else
     {
-        uval = dd11::read16(kt11::decode_instr((uint16_t)da, false, prevuser));
+        const uint32_t pa = kt11::fastword(da, false, prevuser);
+        if (pa != NO_SPAN)
+        {
+            uval = ms11::read16(pa);
+        }
+        else
+        {
+            uval = dd11::read16(kt11::decode_instr((uint16_t)da, false, prevuser));
+        }
     }
     push(uval);
     PS &= 0xFFF0;
@@ -229,6 +219,7 @@ static void MFPI(uint16_t instr)
 // Move to previous instr
 static void MTPI(uint16_t instr)
 {
+    flags();
     uint32_t sa = 0;
     uint8_t d = instr & 077;
     uint16_t da = aget(d, 2);
@@ -239,17 +230,9 @@ static void MTPI(uint16_t instr)
         {
             R[6] = uval;
         }
-        else if (prevuser == 3)
-        {
-            USP = uval;
-        }
-        else if (prevuser == 1)
-        {
-            SSP = uval;
-        }
         else
         {
-            KSP = uval;
+            bankSP[prevuser] = uval;
         }
     }
     else if (isReg(da))
@@ -264,8 +247,16 @@ static void MTPI(uint16_t instr)
     }
     else
     {
-        sa = kt11::decode_instr(da, true, prevuser);
-        dd11::write16(sa, uval);
+        sa = kt11::fastword(da, true, prevuser);
+        if (sa != NO_SPAN)
+        {
+            ms11::write16(sa, uval);
+        }
+        else
+        {
+            sa = kt11::decode_instr(da, true, prevuser);
+            dd11::write16(sa, uval);
+        }
     }
     PS &= 0xFFF0;
     // PS |= FLAGC;
@@ -280,30 +271,13 @@ static void MTPI(uint16_t instr)
 // Move from previous data
 static void MFPD(uint16_t instr)
 {
+    flags();
     uint8_t d = instr & 077;
     uint16_t da = aget(d, 2);
     uint16_t uval;
     if (da == 0170006)
     {
-        if (curuser == prevuser)
-        {
-            uval = R[6];
-        }
-        else
-        {
-            if (prevuser == 3)
-            {
-                uval = USP;
-            }
-            else if (prevuser == 1)
-            {
-                uval = SSP;
-            }
-            else
-            {
-                uval = KSP;
-            }
-        }
+        uval = (curuser == prevuser) ? R[6] : bankSP[prevuser];
     }
     else if (isReg(da))
     {
@@ -330,6 +304,7 @@ static void MFPD(uint16_t instr)
 // Move to previous data
 static void MTPD(uint16_t instr)
 {
+    flags();
     uint32_t sa = 0;
     uint8_t d = instr & 077;
     uint16_t da = aget(d, 2);
@@ -340,17 +315,9 @@ static void MTPD(uint16_t instr)
         {
             R[6] = uval;
         }
-        else if (prevuser == 3)
-        {
-            USP = uval;
-        }
-        else if (prevuser == 1)
-        {
-            SSP = uval;
-        }
         else
         {
-            KSP = uval;
+            bankSP[prevuser] = uval;
         }
     }
     else if (isReg(da))
@@ -377,6 +344,17 @@ static void MTPD(uint16_t instr)
 }
 
 // Step the CPU
+#if DECODE_CACHE
+// decode returns the function for an instruction, using the same table as step()
+static handler decode(const uint16_t instr)
+{
+#define EXEC(fn) return fn
+#include "./cpu/cpu_jmp_tab.cpp.h"
+#undef EXEC
+    return UNOP;
+}
+#endif
+
 void step()
 {
     if (waiting)
@@ -385,6 +363,30 @@ void step()
     debug_step();
 
     curPC = R[7];
+
+#if DECODE_CACHE
+    uint32_t pa = kt11::fastword(R[7], false, curuser);
+    if (pa == NO_SPAN)
+    {
+        pa = kt11::decode_instr(R[7], false, curuser);
+    }
+    decoded d = dcache[(pa >> 1) & (DECODE_CACHE - 1)];
+    if (d.pa != pa)
+    {
+        d.pa = pa;
+        d.instr = dd11::read16(pa);
+        d.fn = decode(d.instr);
+        if (pa < MAX_RAM_ADDRESS)  // only writes to ram invalidate the cache
+        {
+            dcache[(pa >> 1) & (DECODE_CACHE - 1)] = d;
+        }
+    }
+    R[7] += 2;
+
+    debug_print();
+
+    d.fn(d.instr);
+#else
     uint16_t instr = dd11::read16(kt11::decode_instr(R[7], false, curuser));
     // return;
     R[7] += 2;
@@ -392,7 +394,13 @@ void step()
     debug_print();
 
 // this is  a set of switch cases which jump to the functions required
+#define EXEC(fn)       \
+    {                  \
+        fn(instr);     \
+        return;        \
+    }
 #include "./cpu/cpu_jmp_tab.cpp.h"
+#undef EXEC
 
     if (PRINTSIMLINES)
     {
@@ -400,10 +408,33 @@ void step()
         Serial.println(instr, OCT);
     }
     longjmp(trapbuf, INTINVAL);
+#endif
 }
 
+#if THREADED_CORE
+#include "./cpu/cpu_threaded.cpp.h"
+#endif
+
 #include "./cpu/cpu_irq.cpp.h"
 
+#if SNAPSHOTS
+// save or load the processor state for a checkpoint or a fork
+void snapshot(SdFile& f, bool save)
+{
+    ckpt::xfer(f, save, (void*)R, sizeof(R));
+    flags();
+    ckpt::xfer(f, save, (void*)&PS, sizeof(PS));
+    ckpt::xfer(f, save, (void*)&curPC, sizeof(curPC));
+    ckpt::xfer(f, save, (void*)bankSP, sizeof(bankSP));
+    ckpt::xfer(f, save, (void*)bankR, sizeof(bankR));
+    ckpt::xfer(f, save, &regset, sizeof(regset));
+    ckpt::xfer(f, save, (void*)&curuser, sizeof(curuser));
+    ckpt::xfer(f, save, (void*)&prevuser, sizeof(prevuser));
+    ckpt::xfer(f, save, &waiting, sizeof(waiting));
+    ckpt::xfer(f, save, itab, sizeof(itab));
+}
+#endif
+
 };  // namespace kb11
 
 #endif
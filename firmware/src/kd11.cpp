@@ -38,7 +38,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #if !USE_11_45 || STRICT_11_40
 
 #include "bootrom.h"
+#include "ckpt.h"
 #include "dd11.h"
+#include "dh11.h"
+#include "dl11.h"
+#include "fp11.h"
 #include "kl11.h"
 #include "kt11.h"
 #include "kw11.h"
@@ -49,25 +53,33 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "sam11.h"
 
 #include <SdFat.h>
+#include <math.h>
+#include <string.h>
 
-pdp11::intr itab[ITABN];
+PERMACHINE pdp11::intr itab[ITABN];
 
 namespace kd11 {
 
-// signed integer registers -- change to R[2][8]
-volatile int32_t R[8];  // R6 = SP, R7 = PC
+// signed integer registers, with the current mode's stack pointer in R6
+PERMACHINE volatile int32_t R[8];  // R6 = SP, R7 = PC
 
-volatile uint16_t PS;     // Processor Status
-volatile uint16_t curPC;  // R7, address of current instruction
-volatile uint16_t KSP;    // R6 (kernel), stack pointer
-volatile uint16_t USP;    // R6 (user), stack pointer
+PERMACHINE volatile uint16_t PS;         // Processor Status
+PERMACHINE volatile uint16_t curPC;      // R7, address of current instruction
+PERMACHINE volatile uint16_t bankSP[4];  // R6 of each mode while it's not the current one, by mode
 
-volatile uint8_t curuser;   // 0: kernel, 1: illegal, 2: illegal, 3: user
-volatile uint8_t prevuser;  // 0: kernel, 1: illegal, 2: illegal, 3: user
+PERMACHINE volatile uint8_t curuser;   // 0: kernel, 1: illegal, 2: illegal, 3: user
+PERMACHINE volatile uint8_t prevuser;  // 0: kernel, 1: illegal, 2: illegal, 3: user
 
-bool trapped = false;
-bool cont_with = false;
-bool waiting = false;
+PERMACHINE bool trapped = false;
+PERMACHINE bool cont_with = false;
+PERMACHINE bool waiting = false;
+
+#if DECODE_CACHE
+PERMACHINE decoded dcache[DECODE_CACHE];
+#endif
+PERMACHINE bool spinning = false;  // polling a device status register, see spinloop()
+PERMACHINE uint32_t elided = 0;    // instructions skipped by loop0 in polling loops
+PERMACHINE bool copying = false;   // in a loop copying or clearing memory, see blockloop()
 
 #include "cpu/cpu_bus.cpp.h"
 
@@ -80,9 +92,12 @@ void reset(void)
         R[i] = 0;
     }
     kt11::SLR = 0400;
+    flags();
     PS = 0;
-    KSP = 0;
-    USP = 0;
+    for (i = 0; i < 4; i++)
+    {
+        bankSP[i] = 0;
+    }
     curuser = 0;
     prevuser = 0;
     kt11::SR0 = 0;
@@ -91,7 +106,16 @@ void reset(void)
     kt11::SR3 = 0;
     curPC = 0;
     kw11::reset();
+#if USE_FP
+    fp11::reset();
+#endif
     ms11::clear();
+#if DECODE_CACHE
+    for (i = 0; i < DECODE_CACHE; i++)
+    {
+        dcache[i].pa = 1;  // never an instruction address
+    }
+#endif
     for (i = 0; i < BOOT_LEN; i++)
     {
         dd11::write16(BOOT_START + (i * 2), bootrom_rk0[i]);
@@ -99,6 +123,12 @@ void reset(void)
     R[7] = BOOT_START;
     kl11::reset();
     rk11::reset();
+#if DL_TTYS
+    dl11::reset();
+#endif
+#if USE_DH
+    dh11::reset();
+#endif
     waiting = false;
 
 #ifdef PIN_OUT_PROC_RUN
@@ -108,6 +138,8 @@ void reset(void)
 
 #include "./cpu/cpu_core.cpp.h"
 
+// switch the processor mode, which swaps R6 for the new mode's stack pointer.
+// The mode LEDs are left to loop0, which samples curuser
 void switchmode(uint8_t newm)
 {
 #if STRICT_11_40
@@ -117,72 +149,31 @@ void switchmode(uint8_t newm)
 
     prevuser = curuser;
     curuser = newm;
-    if (prevuser == 3)
-    {
-        USP = R[6];
-    }
-    else
-    {
-        KSP = R[6];
-    }
-
-    if (curuser == 3)
-    {
-#ifdef PIN_OUT_USER_MODE
-        digitalWrite(PIN_OUT_USER_MODE, LED_ON);
-#endif
-#ifdef PIN_OUT_SUPER_MODE
-        digitalWrite(PIN_OUT_SUPER_MODE, LED_OFF);
-#endif
-#ifdef PIN_OUT_KERNEL_MODE
-        digitalWrite(PIN_OUT_KERNEL_MODE, LED_OFF);
-#endif
-        R[6] = USP;
-    }
-    else
-    {
-#ifdef PIN_OUT_USER_MODE
-        digitalWrite(PIN_OUT_USER_MODE, LED_OFF);
-#endif
-#ifdef PIN_OUT_SUPER_MODE
-        digitalWrite(PIN_OUT_SUPER_MODE, LED_OFF);
-#endif
-#ifdef PIN_OUT_KERNEL_MODE
-        digitalWrite(PIN_OUT_KERNEL_MODE, LED_ON);
-#endif
-        R[6] = KSP;
-    }
+    bankSP[prevuser] = R[6];
+    R[6] = bankSP[curuser];
     PS &= 0007777;
     PS |= ((curuser & 03) << 14);
     PS |= ((prevuser & 03) << 12);
 }
 
+// the 11/40 only has the one register set
+void switchset()
+{
+}
+
 #include "./cpu/cpu_debug.cpp.h"  // includes debug functions
 #include "./cpu/cpu_instr.cpp.h"  // includes the actual instruction functions
 
 // Move from previous instr
 static void MFPI(uint16_t instr)
 {
+    flags();
     uint8_t d = instr & 077;
     uint16_t da = aget(d, 2);
     uint16_t uval;
     if (da == 0170006)
     {
-        if (curuser == prevuser)
-        {
-            uval = R[6];
-        }
-        else
-        {
-            if (prevuser == 3)
-            {
-                uval = USP;
-            }
-            else
-            {
-                uval = KSP;
-            }
-        }
+        uval = (curuser == prevuser) ? R[6] : bankSP[prevuser];
     }
     else if (isReg(da))
     {
@@ -195,7 +186,15 @@ static void MFPI(uint16_t instr)
     }
     else
     {
-        uval = dd11::read16(kt11::decode_instr((uint16_t)da, false, prevuser));
+        const uint32_t pa = kt11::fastword(da, false, prevuser);
+        if (pa != NO_SPAN)
+        {
+            uval = ms11::read16(pa);
+        }
+        else
+        {
+            uval = dd11::read16(kt11::decode_instr((uint16_t)da, false, prevuser));
+        }
     }
     push(uval);
     PS &= 0xFFF0;
@@ -210,6 +209,7 @@ static void MFPI(uint16_t instr)
 // Move to previous instr
 static void MTPI(uint16_t instr)
 {
+    flags();
     uint32_t sa = 0;
     uint8_t d = instr & 077;
     uint16_t da = aget(d, 2);
@@ -220,13 +220,9 @@ static void MTPI(uint16_t instr)
         {
             R[6] = uval;
         }
-        else if (prevuser == 3)
-        {
-            USP = uval;
-        }
         else
         {
-            KSP = uval;
+            bankSP[prevuser] = uval;
         }
     }
     else if (isReg(da))
@@ -241,8 +237,16 @@ static void MTPI(uint16_t instr)
     }
     else
     {
-        sa = kt11::decode_instr(da, true, prevuser);
-        dd11::write16(sa, uval);
+        sa = kt11::fastword(da, true, prevuser);
+        if (sa != NO_SPAN)
+        {
+            ms11::write16(sa, uval);
+        }
+        else
+        {
+            sa = kt11::decode_instr(da, true, prevuser);
+            dd11::write16(sa, uval);
+        }
     }
     PS &= 0xFFF0;
     // PS |= FLAGC;
@@ -266,6 +270,17 @@ static void MTPD(uint16_t instr)
     UNOP(instr);
 }
 
+#if DECODE_CACHE
+// decode returns the function for an instruction, using the same table as step()
+static handler decode(const uint16_t instr)
+{
+#define EXEC(fn) return fn
+#include "./cpu/cpu_jmp_tab.cpp.h"
+#undef EXEC
+    return UNOP;
+}
+#endif
+
 void step()
 {
     if (waiting)
@@ -274,6 +289,30 @@ void step()
     debug_step();
 
     curPC = R[7];
+
+#if DECODE_CACHE
+    uint32_t pa = kt11::fastword(R[7], false, curuser);
+    if (pa == NO_SPAN)
+    {
+        pa = kt11::decode_instr(R[7], false, curuser);
+    }
+    decoded d = dcache[(pa >> 1) & (DECODE_CACHE - 1)];
+    if (d.pa != pa)
+    {
+        d.pa = pa;
+        d.instr = dd11::read16(pa);
+        d.fn = decode(d.instr);
+        if (pa < MAX_RAM_ADDRESS)  // only writes to ram invalidate the cache
+        {
+            dcache[(pa >> 1) & (DECODE_CACHE - 1)] = d;
+        }
+    }
+    R[7] += 2;
+
+    debug_print();
+
+    d.fn(d.instr);
+#else
     uint16_t instr = dd11::read16(kt11::decode_instr(R[7], false, curuser));
     // return;
     R[7] += 2;
@@ -281,7 +320,13 @@ void step()
     debug_print();
 
 // this is  a set of switch cases which jump to the functions required
+#define EXEC(fn)       \
+    {                  \
+        fn(instr);     \
+        return;        \
+    }
 #include "./cpu/cpu_jmp_tab.cpp.h"
+#undef EXEC
 
     if (PRINTSIMLINES)
     {
@@ -289,10 +334,31 @@ void step()
         Serial.println(instr, OCT);
     }
     longjmp(trapbuf, INTINVAL);
+#endif
 }
 
+#if THREADED_CORE
+#include "./cpu/cpu_threaded.cpp.h"
+#endif
+
 #include "./cpu/cpu_irq.cpp.h"
 
+#if SNAPSHOTS
+// save or load the processor state for a checkpoint or a fork
+void snapshot(SdFile& f, bool save)
+{
+    ckpt::xfer(f, save, (void*)R, sizeof(R));
+    flags();
+    ckpt::xfer(f, save, (void*)&PS, sizeof(PS));
+    ckpt::xfer(f, save, (void*)&curPC, sizeof(curPC));
+    ckpt::xfer(f, save, (void*)bankSP, sizeof(bankSP));
+    ckpt::xfer(f, save, (void*)&curuser, sizeof(curuser));
+    ckpt::xfer(f, save, (void*)&prevuser, sizeof(prevuser));
+    ckpt::xfer(f, save, &waiting, sizeof(waiting));
+    ckpt::xfer(f, save, itab, sizeof(itab));
+}
+#endif
+
 };  // namespace kd11
 
 #endif
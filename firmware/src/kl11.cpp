@@ -34,8 +34,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "kl11.h"
 
+#include "ckpt.h"
 #include "kb11.h"  // 11/45
 #include "kd11.h"  // 11/40
+#include "rr.h"
 #include "sam11.h"
 #include "termopts.h"
 
@@ -47,12 +49,44 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define procNS kd11
 #endif
 
+#if USE_RR && KL_BAUD
+#undef KL_BAUD
+#define KL_BAUD 0  // replays can't have the output waiting on the wall clock
+#endif
+
+#if KL_BAUD
+#include <elapsedMillis.h>
+#endif
+
 namespace kl11 {
 
-uint16_t TKS;
-uint16_t TKB;
-uint16_t TPS;
-uint16_t TPB;
+PERMACHINE uint16_t TKS;
+PERMACHINE uint16_t TKB;
+PERMACHINE uint16_t TPS;
+PERMACHINE uint16_t TPB;
+
+// Output waiting to go to the host, sent in one go when the buffer fills, it's
+// been held for KL_TX_HOLD polls, or the processor is WAITing
+PERMACHINE char txbuf[KL_TX_BUFFER];
+PERMACHINE uint16_t txhead, txtail;  // free running, txbuf[txtail] is the oldest
+PERMACHINE uint16_t held;            // polls since the oldest was written
+
+// Input from the host, loaded into TKB a character at a time as the PDP reads
+// them, and only taken from the host while there's room for it, so nothing is
+// dropped when text is pasted in faster than the PDP reads it
+PERMACHINE char rxbuf[KL_RX_BUFFER];
+PERMACHINE uint16_t rxhead, rxtail;  // free running, rxbuf[rxtail] is the next for TKB
+PERMACHINE uint16_t rxwait = 1;      // polls until the host is next checked
+
+#if ANSI_TO_ASCII
+PERMACHINE char esc[4];   // the start of an escape sequence, until it's known what it is
+PERMACHINE uint8_t escn;  // how much of one there is
+#endif
+
+#if KL_BAUD
+PERMACHINE elapsedMicros txtime;                             // since TPB was written
+#define KL_CHAR_US ((uint32_t)10000000 / KL_BAUD)  // a start bit, 8 data bits and a stop bit
+#endif
 
 void reset()
 {
@@ -62,7 +96,9 @@ void reset()
     TPB = 0;
 }
 
-static void addchar(char c)
+#if USE_RR != RR_REPLAY
+// put a character from the host in the input buffer, remapped for the PDP
+static void rxput(char c)
 {
 #if CR_TO_LF && !LF_TO_CR
     if (c == _CR)
@@ -88,27 +124,52 @@ static void addchar(char c)
 
 #if REMAP_WITH_TABLE
     // If enabled, use the keymap array to change the character
-    TKB = ascii_chart[c & 0x7F] & 0x7F;
-#else
-    // If not then just pass the character forward as is
-    TKB = c & 0x7F;
+    c = ascii_chart[c & 0x7F];
 #endif
 
-    TKS |= 0x80;
-    if (TKS & (1 << 6))
+    rxbuf[rxhead++ & (KL_RX_BUFFER - 1)] = c & 0x7F;
+}
+
+#if ANSI_TO_ASCII
+// pass on the start of an escape sequence that didn't turn out to be one
+static void escflush()
+{
+    for (uint8_t i = 0; i < escn; i++)
+        rxput(esc[i]);
+    escn = 0;
+}
+
+// match "\e[3~" (delete) a character at a time, without waiting on the host
+static void escput(char c)
+{
+    static const char del[] = {_ESC, '[', '3', '~'};
+
+    if (c == del[escn])
     {
-        procNS::interrupt(INTTTYIN, 4);
+        esc[escn++] = c;
+        if (escn == sizeof(del))
+        {
+            escn = 0;
+            rxput(_DEL);
+        }
+        return;
     }
-}
 
-uint8_t count;
+    escflush();
+    if (c == _ESC)
+        esc[escn++] = c;
+    else
+        rxput(c);
+}
+#endif
 
-void poll()
+// move what the host has sent into the input buffer, as much as will fit
+static void receive()
 {
-    // Read
-    if (Serial.available())
+    // leave room for a whole escape sequence, anything else waits on the host
+    while ((uint16_t)(rxhead - rxtail) <= KL_RX_BUFFER - 4 && Serial.available())
     {
-        char c = Serial.read();
+        char c = Serial.read() & 0x7F;
 
         if ((c == '\n' || c == '\r'))
         {
@@ -120,51 +181,78 @@ void poll()
         }
 
 #if ANSI_TO_ASCII
-        if (c == 0x1B)  // ESC
+        escput(c);
+#else
+        rxput(c);
+#endif
+    }
+
+#if ANSI_TO_ASCII
+    // the rest of a sequence comes in with the ESC, so a lone one is just an ESC
+    if (escn && !Serial.available())
+        escflush();
+#endif
+}
+#endif
+
+// load the next character into TKB
+static void addchar(char c)
+{
+#if USE_RR == RR_RECORD
+    rr::record(rr::EV_CHAR, c);
+#endif
+
+    TKB = c;
+    TKS |= 0x80;
+    if (TKS & (1 << 6))
+    {
+        procNS::interrupt(INTTTYIN, 4);
+    }
+}
+
+// send everything waiting to the host
+void flush()
+{
+    while (txtail != txhead)
+    {
+        const uint16_t at = txtail & (KL_TX_BUFFER - 1);
+        uint16_t n = txhead - txtail;
+        if (n > KL_TX_BUFFER - at)
         {
-            char b = Serial.read();
-            if (b == '[')
-            {
-                char d = Serial.read();
-                if (d == '3')
-                {
-                    char e = Serial.read();
-                    if (e == '~')
-                    {
-                        addchar(0x7F);
-                    }
-                    else
-                    {
-                        addchar(c & 0x7F);
-                        addchar(b & 0x7F);
-                        addchar(d & 0x7F);
-                        addchar(e & 0x7F);
-                    }
-                }
-                else
-                {
-                    addchar(c & 0x7F);
-                    addchar(b & 0x7F);
-                    addchar(d & 0x7F);
-                }
-            }
-            else
-            {
-                addchar(c & 0x7F);
-                addchar(b & 0x7F);
-            }
+            n = KL_TX_BUFFER - at;
         }
-        else
-#endif
-            addchar(c & 0x7F);
+        Serial.write((const uint8_t*)&txbuf[at], n);
+        txtail += n;
+    }
+    held = 0;
+}
+
+void poll()
+{
+    // Read
+#if USE_RR == RR_REPLAY
+    char c;
+    while (rr::replay(rr::EV_CHAR, &c))
+        addchar(c);
+#else
+    if (!--rxwait)
+    {
+        rxwait = KL_RX_POLL;
+        receive();
+    }
+    if (rxtail != rxhead && !(TKS & 0x80))
+    {
+        addchar(rxbuf[rxtail++ & (KL_RX_BUFFER - 1)]);  // the last one has been read
     }
+#endif
 
     // Write
     if ((TPS & 0x80) == 0)
     {
-        if (++count > 32)
+#if KL_BAUD
+        if (txtime >= KL_CHAR_US)
+#endif
         {
-            Serial.write(TPB & 0x7f);  // the & 0x7f removes the parity bit, all characters should be 7-bit anyway.
             TPS |= 0x80;
             if (TPS & (1 << 6))
             {
@@ -172,6 +260,59 @@ void poll()
             }
         }
     }
+    if (txhead != txtail && ++held >= KL_TX_HOLD)
+    {
+        flush();
+    }
+}
+
+// the processor is WAITing, so send the output now rather than holding it,
+// and take in any input. Returns true if there's nothing to do but wait for
+// input, or the baud rate
+bool idle()
+{
+    flush();
+#if !KL_BAUD
+    if ((TPS & 0x80) == 0)
+    {
+        return false;  // the next poll finishes the character
+    }
+#endif
+#if USE_RR != RR_REPLAY
+    receive();
+    if (rxtail != rxhead && !(TKS & 0x80))
+    {
+        return false;  // the next poll loads it into TKB
+    }
+#endif
+    return true;
+}
+
+// how many more polls will pass without anything happening
+uint16_t quiet()
+{
+    uint16_t n = 0xFFFF;
+
+    if ((TPS & 0x80) == 0)
+        return 0;  // the next poll finishes it, or checks the wall clock for it
+#if USE_RR != RR_REPLAY
+    if (rxtail != rxhead && !(TKS & 0x80))
+        return 0;  // the next poll loads the next input character
+    n = rxwait - 1;
+#endif
+    if (txhead != txtail && n > KL_TX_HOLD - 1 - held)
+        n = KL_TX_HOLD - 1 - held;
+    return n;
+}
+
+// skip n polls, n must be no more than quiet()
+void skip(uint16_t n)
+{
+#if USE_RR != RR_REPLAY
+    rxwait -= n;
+#endif
+    if (txhead != txtail)
+        held += n;
 }
 
 uint16_t read16(uint32_t a)
@@ -201,6 +342,25 @@ uint16_t read16(uint32_t a)
     }
 }
 
+// read16 without clearing DONE when the data buffer is read
+uint16_t peek16(uint32_t a)
+{
+    if (a == DEV_CONSOLE_TTY_IN_DATA)
+    {
+        return (TKS & 0x80) ? TKB : 0;
+    }
+    return read16(a);
+}
+
+// the high bytes are all read only, so only the low ones do anything
+void write8(uint32_t a, uint16_t v)
+{
+    if (!(a & 1))
+    {
+        write16(a, v & 0xFF);
+    }
+}
+
 void write16(uint32_t a, uint16_t v)
 {
     switch (a)
@@ -228,7 +388,14 @@ void write16(uint32_t a, uint16_t v)
     case DEV_CONSOLE_TTY_OUT_DATA:
         TPB = v & 0xff;
         TPS &= 0xff7f;
-        count = 0;
+        if ((uint16_t)(txhead - txtail) == KL_TX_BUFFER)
+        {
+            flush();
+        }
+        txbuf[txhead++ & (KL_TX_BUFFER - 1)] = TPB & 0x7f;  // the & 0x7f removes the parity bit, all characters should be 7-bit anyway.
+#if KL_BAUD
+        txtime = 0;
+#endif
         break;
     case DEV_CONSOLE_TTY_IN_DATA:
         break;
@@ -241,4 +408,17 @@ void write16(uint32_t a, uint16_t v)
     }
 }
 
+#if SNAPSHOTS
+// save or load the console state for a checkpoint or a fork
+void snapshot(SdFile& f, bool save)
+{
+    if (save)
+        flush();  // so the checkpoint doesn't need the output buffer
+    ckpt::xfer(f, save, &TKS, sizeof(TKS));
+    ckpt::xfer(f, save, &TKB, sizeof(TKB));
+    ckpt::xfer(f, save, &TPS, sizeof(TPS));
+    ckpt::xfer(f, save, &TPB, sizeof(TPB));
+}
+#endif
+
 };  // namespace kl11
@@ -34,6 +34,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "kt11.h"
 
+#include "ckpt.h"
 #include "kb11.h"  // 11/45
 #include "kd11.h"  // 11/40
 #include "platform.h"
@@ -49,15 +50,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace kt11 {
 
-uint16_t SLR;
+PERMACHINE uint16_t SLR;
 
 struct page {
     uint16_t par;  // Page address register
     uint16_t pdr;  // Page descriptor register
-    uint32_t addr()
-    {
-        return par & 07777;  // only bits 11-0 are valid
-    }
     uint16_t len()
     {
         return ((pdr >> 8) & 0x7F);  // page length field - bits 14-8
@@ -76,9 +73,43 @@ struct page {
     }
 };
 
-page instr_pages[4][8];  //0 = kern, 1 = super, 2 = illegal, 3 = user
-page data_pages[4][8];   //0 = kern, 1 = super, 2 = illegal, 3 = user
-uint16_t SR0, SR1, SR2, SR3;
+PERMACHINE page instr_pages[4][8];  //0 = kern, 1 = super, 2 = illegal, 3 = user
+PERMACHINE page data_pages[4][8];   //0 = kern, 1 = super, 2 = illegal, 3 = user
+PERMACHINE uint16_t SR0, SR1, SR2, SR3;
+
+PERMACHINE fastpage fast[4][8];
+PERMACHINE bool fast_ok = false;  // cleared when the MMU registers change
+PERMACHINE bool fast_on;          // MMU enabled when fast was filled in
+
+// The physical address of block and disp in the page mapped by par. Only bits
+// 11-0 of the PAR are valid, reaching the 256KB that 18 bits do, with the I/O
+// page in the top 8KB of it, unless SR3 turns on 22 bit mapping, when all 16
+// are, reaching 4MB.
+static inline uint32_t relocate(const uint16_t par, const uint16_t block, const uint16_t disp)
+{
+#if USE_22BIT
+    if (SR3 & SR3_22BIT)
+    {
+        return (((uint32_t)block + par) << 6) + disp;
+    }
+    const uint32_t aa = (((uint32_t)block + (par & 07777)) << 6) + disp;
+    return (aa >= 0760000) ? IOPAGE(aa) : aa;
+#else
+    return (((uint32_t)block + (par & 07777)) << 6) + disp;
+#endif
+}
+
+// The top of the ram that the pages can reach
+static inline uint32_t ramtop()
+{
+#if USE_22BIT
+    if (!(SR3 & SR3_22BIT) && MAX_RAM_ADDRESS > 0760000)
+    {
+        return 0760000;
+    }
+#endif
+    return MAX_RAM_ADDRESS;
+}
 
 void errorSR0(const uint16_t a, const uint8_t user)
 {
@@ -95,7 +126,7 @@ uint32_t decode_instr(const uint16_t a, const bool w, const uint8_t user)
     if (!(SR0 & 1))
     {
         if (a >= 0170000)
-            return (uint32_t)((uint32_t)a + 0600000);
+            return IOPAGE((uint32_t)a + 0600000);
         return a;
     }
 
@@ -154,10 +185,13 @@ uint32_t decode_instr(const uint16_t a, const bool w, const uint8_t user)
         longjmp(trapbuf, INTMMUERR);
     }
 
-    if (w)
+    if (w && !(instr_pages[user][i].pdr & (1 << 6)))
+    {
         instr_pages[user][i].pdr |= 1 << 6;
+        fast_ok = false;
+    }
 
-    uint32_t aa = ((block + instr_pages[user][i].addr()) << 6) + disp;
+    uint32_t aa = relocate(instr_pages[user][i].par, block, disp);
 
 #if DEBUG_MMU
     if (PRINTSIMLINES && DEBUG_MMU)
@@ -173,6 +207,122 @@ uint32_t decode_instr(const uint16_t a, const bool w, const uint8_t user)
     return aa;
 }
 
+void fill_fast()
+{
+    for (uint8_t user = 0; user < 4; user++)
+    {
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            fastpage& f = fast[user][i];
+            int32_t hi;
+            if (!(SR0 & 1))
+            {
+                f.base = (uint32_t)i << 13;
+                f.lo = 0;
+                hi = i == 7 ? 007776 : 017776;  // 0170000 up is the I/O page
+                f.write = true;
+            }
+            else
+            {
+                page& p = instr_pages[user][i];
+                f.base = relocate(p.par, 0, 0);
+                f.lo = p.ed() ? p.len() << 6 : 0;
+                hi = p.ed() ? 017776 : ((p.len() + 1) << 6) - 2;
+                if (!p.read())
+                {
+                    hi = -1;
+                }
+                f.write = p.write() && (p.pdr & (1 << 6));
+            }
+            if ((int32_t)(f.base + hi) >= (int32_t)ramtop())
+            {
+                hi = (int32_t)ramtop() - 2 - (int32_t)f.base;
+            }
+            if (hi < f.lo)
+            {
+                f.lo = 1;
+                f.hi = 0;
+            }
+            else
+            {
+                f.hi = hi;
+            }
+        }
+    }
+    fast_on = SR0 & 1;
+    fast_ok = true;
+}
+
+// span gives the physical address of the len bytes from a, if they are all in
+// ram in one page and can be accessed, for working on them in one go, or
+// NO_SPAN if not. It never traps, but marks the page written like
+// decode_instr does when w is set.
+uint32_t span(const uint16_t a, const uint16_t len, const bool w, const uint8_t user)
+{
+    const uint16_t last = a + len - 1;
+    if (!len || last < a || (a >> 13) != (last >> 13))
+    {
+        return NO_SPAN;  // wraps around or crosses a page
+    }
+
+    uint32_t aa = a;
+    if (!(SR0 & 1))
+    {
+        if (last >= 0170000)
+        {
+            return NO_SPAN;  // the I/O page
+        }
+    }
+    else
+    {
+        const uint16_t i = (a >> 13);
+        const uint16_t block = (a >> 6) & 0177;
+        page& p = instr_pages[user][i];
+
+        if ((w && !p.write()) || !p.read())
+        {
+            return NO_SPAN;
+        }
+        if (p.ed() ? (block < p.len()) : (((last >> 6) & 0177) > p.len()))
+        {
+            return NO_SPAN;
+        }
+        if (w && !(p.pdr & (1 << 6)))
+        {
+            p.pdr |= 1 << 6;
+            fast_ok = false;
+        }
+        aa = relocate(p.par, block, a & 077);
+    }
+
+    if (aa + len > ramtop())
+    {
+        return NO_SPAN;
+    }
+    return aa;
+}
+
+uint32_t probe(const uint16_t a, const uint8_t user)
+{
+    if (!(SR0 & 1))
+    {
+        if (a >= 0170000)
+        {
+            return IOPAGE((uint32_t)a + 0600000);
+        }
+        return a;
+    }
+
+    const uint16_t i = (a >> 13);
+    const uint16_t block = (a >> 6) & 0177;
+    page& p = instr_pages[user][i];
+    if (!p.read() || (p.ed() ? (block < p.len()) : (block > p.len())))
+    {
+        return NO_SPAN;
+    }
+    return relocate(p.par, block, a & 077);
+}
+
 uint32_t decode_data(const uint16_t a, const bool w, const uint8_t user)
 {
 #if !STRICT_11_40
@@ -257,7 +407,7 @@ uint32_t decode_data(const uint16_t a, const bool w, const uint8_t user)
     if (w)
         data_pages[user][i].pdr |= 1 << 6;
 
-    uint32_t aa = ((block + data_pages[user][i].addr()) << 6) + disp;
+    uint32_t aa = relocate(data_pages[user][i].par, block, disp);
 
 #if DEBUG_MMU
     if (PRINTSIMLINES && DEBUG_MMU)
@@ -276,6 +426,23 @@ uint32_t decode_data(const uint16_t a, const bool w, const uint8_t user)
 #endif
 }
 
+#if USE_22BIT
+PERMACHINE uint32_t ubmap[31];
+
+uint32_t unibus(const uint32_t a)
+{
+    if (a >= DEV_MEMORY)
+    {
+        return IOPAGE(a);
+    }
+    if (!(SR3 & SR3_UBMAP))
+    {
+        return a;
+    }
+    return (ubmap[a >> 13] + (a & 017777)) & 017777777;
+}
+#endif
+
 uint16_t read16(const uint32_t a)
 {
     uint8_t i = ((a & 017) >> 1);
@@ -366,6 +533,16 @@ uint16_t read16(const uint32_t a)
         return data_pages[3][i].par;
     }
 
+#if USE_22BIT
+    // ~~~ UNIBUS map, the low word holding bits 15-1 and the high one bits 21-16
+
+    if ((a >= DEV_UBMAP_R0_LO) && (a <= DEV_UBMAP_R30_HI))
+    {
+        const uint32_t m = ubmap[(a - DEV_UBMAP_R0_LO) >> 2];
+        return (a & 2) ? (m >> 16) & 077 : m & 0177776;
+    }
+#endif
+
     if (PRINTSIMLINES)
     {
         Serial.print(F("%% kt11::read16 invalid read from "));
@@ -378,6 +555,8 @@ void write16(const uint32_t a, const uint16_t v)
 {
     uint8_t i = ((a & 017) >> 1);
 
+    fast_ok = false;
+
     // ~~~ Instructions space
 
     if ((a >= DEV_KER_INS_PDR_R0) && (a <= DEV_KER_INS_PDR_R7))
@@ -488,6 +667,22 @@ void write16(const uint32_t a, const uint16_t v)
         return;
     }
 
+#if USE_22BIT
+    if ((a >= DEV_UBMAP_R0_LO) && (a <= DEV_UBMAP_R30_HI))
+    {
+        uint32_t& m = ubmap[(a - DEV_UBMAP_R0_LO) >> 2];
+        if (a & 2)
+        {
+            m = (m & 0177776) | ((uint32_t)(v & 077) << 16);
+        }
+        else
+        {
+            m = (m & 017600000) | (v & 0177776);
+        }
+        return;
+    }
+#endif
+
     if (PRINTSIMLINES)
     {
         Serial.print(F("%% kt11::write16 0"));
@@ -498,4 +693,22 @@ void write16(const uint32_t a, const uint16_t v)
     longjmp(trapbuf, INTBUS);
 }
 
+#if SNAPSHOTS
+// save or load the mmu state for a checkpoint or a fork
+void snapshot(SdFile& f, bool save)
+{
+    ckpt::xfer(f, save, instr_pages, sizeof(instr_pages));
+    ckpt::xfer(f, save, data_pages, sizeof(data_pages));
+    ckpt::xfer(f, save, &SR0, sizeof(SR0));
+    ckpt::xfer(f, save, &SR1, sizeof(SR1));
+    ckpt::xfer(f, save, &SR2, sizeof(SR2));
+    ckpt::xfer(f, save, &SR3, sizeof(SR3));
+    ckpt::xfer(f, save, &SLR, sizeof(SLR));
+#if USE_22BIT
+    ckpt::xfer(f, save, ubmap, sizeof(ubmap));
+#endif
+    fast_ok = false;
+}
+#endif
+
 };  // namespace kt11
@@ -34,10 +34,12 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "kw11.h"
 
+#include "ckpt.h"
 #include "kb11.h"  // 11/45
 #include "kd11.h"  // 11/40
 #include "pdp1140.h"
 #include "platform.h"
+#include "rr.h"
 
 #define LKS_COMPROMISE 100  // factor to compromise the ticks by, 0 == disable. Higher number or disabled is more accurate date/time in OS, but slows down processor speed
 
@@ -57,16 +59,16 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace kw11 {
 
-uint16_t LKS;
+PERMACHINE uint16_t LKS;
 
 #if LKS_ACC == LKS_SHIFT_TICK
-uint16_t time;
+PERMACHINE uint16_t time;
 #define LKS_PER (16384)
 #elif LKS_ACC == LKS_LOW_ACC
-elapsedMillis time;
+PERMACHINE elapsedMillis time;
 #define LKS_PER LKS_PERIOD_MS
 #elif LKS_ACC == LKS_HIGH_ACC
-elapsedMicros time;
+PERMACHINE elapsedMicros time;
 #define LKS_PER LKS_PERIOD_US
 #endif
 
@@ -77,10 +79,10 @@ void reset()
 }
 
 #if LKS_COMPROMISE
-int loop_time = 0;
+PERMACHINE int loop_time = 0;
 #endif
 
-bool lks_ticked = false;
+PERMACHINE bool lks_ticked = false;
 
 void tick()
 {
@@ -104,6 +106,13 @@ void tick()
     }
 #endif
 
+#if USE_RR == RR_RECORD
+    if (lks_ticked)
+        rr::record(rr::EV_TICK, 0);
+#elif USE_RR == RR_REPLAY
+    lks_ticked = rr::replay(rr::EV_TICK, 0);
+#endif
+
     if (lks_ticked)
     {
         time = 0;
@@ -115,4 +124,69 @@ void tick()
         }
     }
 }
+
+// the processor is WAITing, so skip the loop counts forward and have the next
+// tick() check the clock. Returns true if the clock is the wall clock, so
+// there's nothing to do but wait for it
+bool idle()
+{
+#if LKS_COMPROMISE
+    loop_time = LKS_COMPROMISE - 1;
+#endif
+
+#if LKS_ACC == LKS_SHIFT_TICK
+    time = LKS_PER - 1;
+    return false;
+#else
+    return true;
+#endif
+}
+
+// how many more ticks will pass without the clock being checked
+uint16_t quiet()
+{
+    uint16_t n = 0xFFFF;
+
+#if LKS_COMPROMISE
+    n = LKS_COMPROMISE - 1 - loop_time;
+#elif LKS_ACC != LKS_SHIFT_TICK
+    n = 0;  // checks the clock every tick
+#endif
+
+#if LKS_ACC == LKS_SHIFT_TICK
+    if (n > LKS_PER - 1 - time)
+        n = LKS_PER - 1 - time;
+#endif
+
+    return n;
+}
+
+// skip n ticks, n must be no more than quiet()
+void skip(uint16_t n)
+{
+#if LKS_ACC == LKS_SHIFT_TICK
+    time += n;
+#endif
+
+#if LKS_COMPROMISE
+    loop_time += n;
+#endif
+}
+
+#if SNAPSHOTS
+// save or load the clock state for a checkpoint or a fork
+void snapshot(SdFile& f, bool save)
+{
+    uint32_t t = time;
+    ckpt::xfer(f, save, &LKS, sizeof(LKS));
+    ckpt::xfer(f, save, &t, sizeof(t));
+    ckpt::xfer(f, save, &lks_ticked, sizeof(lks_ticked));
+#if LKS_COMPROMISE
+    ckpt::xfer(f, save, &loop_time, sizeof(loop_time));
+#endif
+    if (!save)
+        time = t;
+}
+#endif
+
 };  // namespace kw11
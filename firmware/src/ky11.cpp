@@ -42,17 +42,17 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace ky11 {
 
-uint32_t SR;  // data switches (not address or option switches!)
-uint16_t DR;  // display register (separate to address/data displays)
+PERMACHINE uint32_t SR;  // data switches (not address or option switches!)
+PERMACHINE uint16_t DR;  // display register (separate to address/data displays)
 
-uint16_t SLR;  // Register of status LEDs separate to addr/data/display
-uint16_t CSR;  // Resgister of control switches separate to addr/data switches
+PERMACHINE uint16_t SLR;  // Register of status LEDs separate to addr/data/display
+PERMACHINE uint16_t CSR;  // Resgister of control switches separate to addr/data switches
 
-uint16_t prevCSR;
-uint32_t workingADR;
-uint16_t workingDTR;
+PERMACHINE uint16_t prevCSR;
+PERMACHINE uint32_t workingADR;
+PERMACHINE uint16_t workingDTR;
 
-bool showDR = false;
+PERMACHINE bool showDR = false;
 
 void step()
 {
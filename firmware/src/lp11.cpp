@@ -34,6 +34,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "lp11.h"
 
+#include "ckpt.h"
 #include "kb11.h"  // 11/45
 #include "kd11.h"  // 11/40
 #include "platform.h"
@@ -53,10 +54,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace lp11 {
 
-uint16_t LPS;
-uint16_t LPB;
+PERMACHINE uint16_t LPS;
+PERMACHINE uint16_t LPB;
 
-int loop_time = 0;
+PERMACHINE int loop_time = 0;
 
 void poll()
 {
@@ -106,6 +107,15 @@ void write16(uint32_t a, uint16_t v)
     }
 }
 
+// only the low bytes do anything, the error bit in the high byte is read only
+void write8(uint32_t a, uint16_t v)
+{
+    if (!(a & 1))
+    {
+        write16(a, v & 0xFF);
+    }
+}
+
 uint16_t read16(uint32_t a)
 {
     switch (a)
@@ -131,6 +141,44 @@ void reset()
     LPS = 0200;
     LPB = 0;
 }
+
+// the processor is WAITing, so print the character now rather than counting
+// polls. Returns true if there's nothing left to print
+bool idle()
+{
+    if (!(LPS & 0200))
+    {
+        loop_time = LP_THROTTLE;
+        return false;
+    }
+    return true;
+}
+
+// how many more polls will pass without the character printing
+uint16_t quiet()
+{
+    if (!(LPS & 0200))
+        return LP_THROTTLE - loop_time;
+    return 0xFFFF;
+}
+
+// skip n polls, n must be no more than quiet()
+void skip(uint16_t n)
+{
+    if (!(LPS & 0200))
+        loop_time += n;
+}
+
+#if SNAPSHOTS
+// save or load the printer state for a checkpoint or a fork
+void snapshot(SdFile& f, bool save)
+{
+    ckpt::xfer(f, save, &LPS, sizeof(LPS));
+    ckpt::xfer(f, save, &LPB, sizeof(LPB));
+    ckpt::xfer(f, save, &loop_time, sizeof(loop_time));
+}
+#endif
+
 };  // namespace lp11
 
 #endif
@@ -41,6 +41,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "sam11.h"
 
 #include <Arduino.h>
+#include <string.h>
 
 #if RAM_MODE == RAM_EXTENDED
 #include "xmem.h"
@@ -51,10 +52,61 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdint.h>
 #endif
 
+#if RAM_MODE == RAM_COW
+#include <atomic>
+#include <stdlib.h>
+#endif
+
+#if USE_11_45 && !STRICT_11_40
+#define procNS kb11
+#else
+#define procNS kd11
+#endif
+
 namespace ms11 {
 #if RAM_MODE == RAM_SWAPFILE
-SdFile msdata;
+PERMACHINE SdFile msdata;
+#endif
+
+#if USE_CKPT || USE_FORK
+PERMACHINE uint32_t dirty[(MS11_PAGES + 31) / 32];
+
+// mark every page as clean, e.g. once a checkpoint has been written
+void clean()
+{
+    for (uint16_t i = 0; i < (MS11_PAGES + 31) / 32; i++)
+        dirty[i] = 0;
+}
+
+// mark every page as dirty, so the next checkpoint is a full one
+void soil()
+{
+    for (uint16_t i = 0; i < (MS11_PAGES + 31) / 32; i++)
+        dirty[i] = 0xFFFFFFFF;
+}
+
+bool is_dirty(uint16_t page)
+{
+    return dirty[page >> 5] & (1UL << (page & 31));
+}
+
+#define mark(a) (dirty[(a) >> (MS11_PAGE_SHIFT + 5)] |= 1UL << (((a) >> MS11_PAGE_SHIFT) & 31))
+#else
+#define mark(a)
 #endif
+
+#if DECODE_CACHE
+// forget the decoded instruction at a, if it's being overwritten
+static inline void snoop(const uint32_t a)
+{
+    procNS::decoded& d = procNS::dcache[(a >> 1) & (DECODE_CACHE - 1)];
+    if (d.pa == (a & ~1))
+        d.pa = 1;
+}
+#else
+#define snoop(a)
+#endif
+
 void clear()
 {
 }
@@ -64,8 +116,95 @@ void clear()
 #include "ram_opts/ram_int.cpp.h"
 #elif RAM_MODE == RAM_SWAPFILE
 #include "ram_opts/ram_swapfile.cpp.h"
+#elif RAM_MODE == RAM_COW
+#include "ram_opts/ram_cow.cpp.h"
 #else
 #include "ram_opts/ram_no_select.cpp.h"  // if there is no ram option, add some dummy functions
 #error NO RAM OPTION SELECTED
 #endif
+
+#if RAM_MODE == RAM_INTERNAL
+// mark and snoop a block that's about to be written in one go
+static void touch(const uint32_t a, const uint16_t words)
+{
+    for (uint32_t p = a; p < a + 2 * words; p += MS11_PAGE_SIZE)
+    {
+        mark(p);
+    }
+    mark(a + 2 * words - 2);
+#if DECODE_CACHE
+    for (uint16_t i = 0; i < words; i++)
+    {
+        snoop(a + 2 * i);
+    }
+#endif
+}
+#endif
+
+// copy words from src to dst, one at a time from the start like a
+// MOV (R0)+,(R1)+ loop, so overlapping blocks come out the same way
+void copy16(uint32_t dst, uint32_t src, uint16_t words)
+{
+#if RAM_MODE == RAM_INTERNAL
+    if (dst <= src || dst >= src + 2 * words)  // memmove does the same
+    {
+        touch(dst, words);
+        memmove(&intptr[dst >> 1], &intptr[src >> 1], 2 * words);
+        return;
+    }
+#endif
+    while (words--)
+    {
+        write16(dst, read16(src));
+        dst += 2;
+        src += 2;
+    }
+}
+
+// copy words from ram at src out to buf, for a device's DMA
+void readblock16(uint32_t src, uint16_t* buf, uint16_t words)
+{
+#if RAM_MODE == RAM_INTERNAL
+    memcpy(buf, &intptr[src >> 1], 2 * words);
+#else
+    while (words--)
+    {
+        *buf++ = read16(src);
+        src += 2;
+    }
+#endif
+}
+
+// copy words from buf into ram at dst, for a device's DMA
+void writeblock16(uint32_t dst, const uint16_t* buf, uint16_t words)
+{
+#if RAM_MODE == RAM_INTERNAL
+    touch(dst, words);
+    memcpy(&intptr[dst >> 1], buf, 2 * words);
+#else
+    while (words--)
+    {
+        write16(dst, *buf++);
+        dst += 2;
+    }
+#endif
+}
+
+// set words from dst to v
+void fill16(uint32_t dst, const uint16_t v, uint16_t words)
+{
+#if RAM_MODE == RAM_INTERNAL
+    if (v == 0)
+    {
+        touch(dst, words);
+        memset(&intptr[dst >> 1], 0, 2 * words);
+        return;
+    }
+#endif
+    while (words--)
+    {
+        write16(dst, v);
+        dst += 2;
+    }
+}
 };  // namespace ms11
@@ -36,6 +36,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <Arduino.h>
 
+#if defined(SAM11_HOST)
+#include "host.h"
+#endif
+
 namespace platform {
 
 // init the platform hardware
@@ -86,6 +90,16 @@ void begin()
     return;
 }
 
+// sleep until the next interrupt, i.e. the systick or usb serial
+void sleep()
+{
+#if defined(__arm__)
+    asm volatile("wfi");
+#elif defined(SAM11_HOST)
+    host::sleep();
+#endif
+}
+
 void writeAddr(uint32_t addr) { }     // write to address pins
 void writeData(uint16_t data) { }     // write to data pins
 void writeDispReg(uint16_t disp) { }  // write display register
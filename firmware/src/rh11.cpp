@@ -46,35 +46,35 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // Other than for the RP03, the RP disk interface was actually called RH11, the UNIX driver is HP for these drives, and RP for those on the actual RP11 controller
 namespace rh11 {
 
-uint16_t RPCS1, RPWC, RPBA, RPCS2, RPDB, RPCS3;
+PERMACHINE uint16_t RPCS1, RPWC, RPBA, RPCS2, RPDB, RPCS3;
 
 // boatload of registers
-uint16_t RPDA[NUM_RP_DRIVES];   // Track|Sector
-uint16_t RPDS[NUM_RP_DRIVES];   // Status
-uint16_t RPER1[NUM_RP_DRIVES];  // Error status 1
-uint16_t RPLA[NUM_RP_DRIVES];   // Look ahead
-uint16_t RPMR1[NUM_RP_DRIVES];  // Maintenance Reg 1
-uint16_t RPMR2[NUM_RP_DRIVES];  // Maintenance Reg 2
-uint16_t RPDT[NUM_RP_DRIVES];   // Drive Type
-uint16_t RPSN[NUM_RP_DRIVES];   // Serial Number
-uint16_t RPOF[NUM_RP_DRIVES];   // Offset
-uint16_t RPDC[NUM_RP_DRIVES];   // Cylinder
-uint16_t RPCC[NUM_RP_DRIVES];   //
-uint16_t RPER2[NUM_RP_DRIVES];  // Error Status 2
-uint16_t RPER3[NUM_RP_DRIVES];  // Error Status 3
-uint16_t RPEC1[NUM_RP_DRIVES];  // Error Correct 1
-uint16_t RPEC2[NUM_RP_DRIVES];  // Error Correct 2
-
-SdFile rpdata[NUM_TM_DRIVES];
-uint16_t attached_drives[NUM_RP_DRIVES];  // doubles as DType register
-
-uint16_t wordspsector[NUM_RP_DRIVES];
-uint16_t sectors[NUM_RP_DRIVES];
-uint16_t surfaces[NUM_RP_DRIVES];
-uint16_t cylinders[NUM_RP_DRIVES];
+PERMACHINE uint16_t RPDA[NUM_RP_DRIVES];   // Track|Sector
+PERMACHINE uint16_t RPDS[NUM_RP_DRIVES];   // Status
+PERMACHINE uint16_t RPER1[NUM_RP_DRIVES];  // Error status 1
+PERMACHINE uint16_t RPLA[NUM_RP_DRIVES];   // Look ahead
+PERMACHINE uint16_t RPMR1[NUM_RP_DRIVES];  // Maintenance Reg 1
+PERMACHINE uint16_t RPMR2[NUM_RP_DRIVES];  // Maintenance Reg 2
+PERMACHINE uint16_t RPDT[NUM_RP_DRIVES];   // Drive Type
+PERMACHINE uint16_t RPSN[NUM_RP_DRIVES];   // Serial Number
+PERMACHINE uint16_t RPOF[NUM_RP_DRIVES];   // Offset
+PERMACHINE uint16_t RPDC[NUM_RP_DRIVES];   // Cylinder
+PERMACHINE uint16_t RPCC[NUM_RP_DRIVES];   //
+PERMACHINE uint16_t RPER2[NUM_RP_DRIVES];  // Error Status 2
+PERMACHINE uint16_t RPER3[NUM_RP_DRIVES];  // Error Status 3
+PERMACHINE uint16_t RPEC1[NUM_RP_DRIVES];  // Error Correct 1
+PERMACHINE uint16_t RPEC2[NUM_RP_DRIVES];  // Error Correct 2
+
+PERMACHINE SdFile rpdata[NUM_TM_DRIVES];
+PERMACHINE uint16_t attached_drives[NUM_RP_DRIVES];  // doubles as DType register
+
+PERMACHINE uint16_t wordspsector[NUM_RP_DRIVES];
+PERMACHINE uint16_t sectors[NUM_RP_DRIVES];
+PERMACHINE uint16_t surfaces[NUM_RP_DRIVES];
+PERMACHINE uint16_t cylinders[NUM_RP_DRIVES];
 
 // current position
-uint16_t sector, syrface, cylinder, drive;
+PERMACHINE uint16_t sector, syrface, cylinder, drive;
 
 // Drive Type register
 /*
@@ -694,44 +694,34 @@ again:
             panic();
         }
 
-        for (i = 0; i < (NUM_WRD_P_SEC / 2) && RPWC != 0; i++)
+        uint16_t buf[NUM_WRD_P_SEC / 2];
+        const uint16_t words = (RPWC == 0) ? 0 : (0200000 - RPWC > NUM_WRD_P_SEC / 2) ? NUM_WRD_P_SEC / 2 : 0200000 - RPWC;
+        uint16_t done = words;
+        // write
+        if (w == 1)
         {
-            // write
-            if (w == 1)
-            {
-                val = dd11::read16(RPBA);
-                rpdata[drive].write(val & 0xFF);
-                rpdata[drive].write((val >> 8) & 0xFF);
-            }
-            // read
-            else if (w == 2)
+            done = dd11::dmaread(RPBA, buf, words);
+            rpdata[drive].write(buf, 2 * done);
+        }
+        // read
+        else if (w == 2)
+        {
+            if (rpdata[drive].read(buf, 2 * words) != 2 * words)
             {
-                int t = rpdata[drive].read();
-                if (t == -1)
-                {
-                    if (PRINTSIMLINES)
-                    {
-                        Serial.println(F("%% rp11 step: failed to read file (low)"));
-                    }
-                    panic();
-                }
-                val = t & 0xFF;
-
-                t = rpdata[drive].read();
-                if (t == -1)
+                if (PRINTSIMLINES)
                 {
-                    if (PRINTSIMLINES)
-                    {
-                        Serial.println(F("%% rp11 step: failed to read file (high)"));
-                    }
-                    panic();
+                    Serial.println(F("%% rp11 step: failed to read file"));
                 }
-                val += ((t & 0xFF) << 8);
-
-                dd11::write16(RPBA, val);
+                panic();
             }
-            RPBA += 2;
-            RPWC = (RPWC + 1) & 0xFFFF;
+            done = dd11::dmawrite(RPBA, buf, words);
+        }
+        RPBA += 2 * done;
+        RPWC = (RPWC + done) & 0xFFFF;
+        if (done < words)  // nothing answered at RPBA
+        {
+            RPCS2 |= 04000;  // NEM
+            RPCS1 |= 0140000;
         }
 
         sector++;
@@ -755,7 +745,7 @@ again:
             }
         }
 
-        if (RPWC == 0)
+        if (RPWC == 0 || done < words)
         {
             RPCS2 &= ~07;
             RPCS2 |= drive & 07;
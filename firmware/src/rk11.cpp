@@ -33,6 +33,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // sam11 software emulation of DEC PDP-11/40 RK11 RK Disk Controller
 #include "rk11.h"
 
+#include "ckpt.h"
 #include "dd11.h"
 #include "kb11.h"  // 11/45
 #include "kd11.h"  // 11/40
@@ -51,11 +52,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace rk11 {
 
-uint32_t RKBA, RKDS, RKER, RKCS, RKWC, RKDA;
-uint32_t drive, sector, surface, cylinder;
+PERMACHINE uint32_t RKBA, RKDS, RKER, RKCS, RKWC, RKDA;
+PERMACHINE uint32_t drive, sector, surface, cylinder;
 
-bool attached_drives[NUM_RK_DRIVES];
-SdFile rkdata[NUM_RK_DRIVES];
+PERMACHINE bool attached_drives[NUM_RK_DRIVES];
+PERMACHINE SdFile rkdata[NUM_RK_DRIVES];
 
 uint16_t read16(uint32_t a)
 {
@@ -196,44 +197,32 @@ again:
         panic();
     }
 
-    uint16_t i;
-    uint16_t val;
-    for (i = 0; i < 256 && RKWC != 0; i++)
+    uint16_t buf[256];
+    const uint16_t words = (RKWC == 0) ? 0 : (0200000 - RKWC > 256) ? 256 : 0200000 - RKWC;
+    uint16_t done;
+    if (w)
     {
-        if (w)
-        {
-            val = dd11::read16(RKBA);
-            rkdata[drive].write(val & 0xFF);
-            rkdata[drive].write((val >> 8) & 0xFF);
-        }
-        else
+        done = dd11::dmaread(RKBA, buf, words);
+        rkdata[drive].write(buf, 2 * done);
+    }
+    else
+    {
+        if (rkdata[drive].read(buf, 2 * words) != 2 * words)
         {
-            int t = rkdata[drive].read();
-            if (t == -1)
+            if (PRINTSIMLINES)
             {
-                if (PRINTSIMLINES)
-                {
-                    Serial.println(F("%% rk11 step: failed to read (low)"));
-                }
-                panic();
+                Serial.println(F("%% rk11 step: failed to read"));
             }
-            val = t & 0xFF;
-
-            t = rkdata[drive].read();
-            if (t == -1)
-            {
-                if (PRINTSIMLINES)
-                {
-                    Serial.println(F("%% rk11 step: failed to read (high)"));
-                }
-                panic();
-            }
-            val += ((t & 0xFF) << 8);
-
-            dd11::write16(RKBA, val);
+            panic();
         }
-        RKBA += 2;
-        RKWC = (RKWC + 1) & 0xFFFF;
+        done = dd11::dmawrite(RKBA, buf, words);
+    }
+    RKBA += 2 * done;
+    RKWC = (RKWC + done) & 0xFFFF;
+    if (done < words)  // nothing answered at RKBA
+    {
+        rkerror(RKNXM);
+        RKCS |= (1 << 15) | (1 << 14);  // error, hard error
     }
     sector++;
     if (sector > 013)
@@ -250,7 +239,7 @@ again:
             }
         }
     }
-    if (RKWC == 0)
+    if (RKWC == 0 || done < words)
     {
         rkready();
         if (RKCS & (1 << 6))
@@ -333,4 +322,21 @@ void reset()
     RKDA = 0;
 }
 
+#if SNAPSHOTS
+// save or load the controller state for a checkpoint or a fork, the disks are not included
+void snapshot(SdFile& f, bool save)
+{
+    ckpt::xfer(f, save, &RKBA, sizeof(RKBA));
+    ckpt::xfer(f, save, &RKDS, sizeof(RKDS));
+    ckpt::xfer(f, save, &RKER, sizeof(RKER));
+    ckpt::xfer(f, save, &RKCS, sizeof(RKCS));
+    ckpt::xfer(f, save, &RKWC, sizeof(RKWC));
+    ckpt::xfer(f, save, &RKDA, sizeof(RKDA));
+    ckpt::xfer(f, save, &drive, sizeof(drive));
+    ckpt::xfer(f, save, &sector, sizeof(sector));
+    ckpt::xfer(f, save, &surface, sizeof(surface));
+    ckpt::xfer(f, save, &cylinder, sizeof(cylinder));
+}
+#endif
+
 };  // namespace rk11
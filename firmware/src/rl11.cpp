@@ -56,10 +56,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace rl11 {
 
-uint32_t RLBA, RLDA, RLMP, RLCS, RLBAE;
-uint32_t drive, status, sectors, tracks, cylinders, m_addr;
+PERMACHINE uint32_t RLBA, RLDA, RLMP, RLCS, RLBAE;
+PERMACHINE uint32_t drive, status, sectors, tracks, cylinders, m_addr;
 
-SdFile rldata;
+PERMACHINE SdFile rldata;
 
 uint16_t read16(uint32_t a)
 {
@@ -197,44 +197,31 @@ again:
         panic();
     }
 
-    uint16_t i;
-    uint16_t val;
-    for (i = 0; i < 256 && RLWC != 0; i++)
+    uint16_t buf[256];
+    const uint16_t words = (RLWC == 0) ? 0 : (0200000 - RLWC > 256) ? 256 : 0200000 - RLWC;
+    uint16_t done;
+    if (w)
     {
-        if (w)
-        {
-            val = dd11::read16(RLBA);
-            rldata.write(val & 0xFF);
-            rldata.write((val >> 8) & 0xFF);
-        }
-        else
+        done = dd11::dmaread(RLBA, buf, words);
+        rldata.write(buf, 2 * done);
+    }
+    else
+    {
+        if (rldata.read(buf, 2 * words) != 2 * words)
         {
-            int t = rldata.read();
-            if (t == -1)
+            if (PRINTSIMLINES)
             {
-                if (PRINTSIMLINES)
-                {
-                    Serial.println(F("%% rlstep: failed to read (low)"));
-                }
-                panic();
+                Serial.println(F("%% rlstep: failed to read"));
             }
-            val = t & 0xFF;
-
-            t = rldata.read();
-            if (t == -1)
-            {
-                if (PRINTSIMLINES)
-                {
-                    Serial.println(F("%% rlstep: failed to read (high)"));
-                }
-                panic();
-            }
-            val += ((t & 0xFF) << 8);
-
-            dd11::write16(RLBA, val);
+            panic();
         }
-        RLBA += 2;
-        RLWC = (RLWC + 1) & 0xFFFF;
+        done = dd11::dmawrite(RLBA, buf, words);
+    }
+    RLBA += 2 * done;
+    RLWC = (RLWC + done) & 0xFFFF;
+    if (done < words)  // nothing answered at RLBA
+    {
+        RLCS |= RLCERR | RLNXM;
     }
     sector++;
     if (sector > 013)
@@ -251,7 +238,7 @@ again:
             }
         }
     }
-    if (RLWC == 0)
+    if (RLWC == 0 || done < words)
     {
         rlready();
         if (RLCS & (1 << 6))
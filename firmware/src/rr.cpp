@@ -0,0 +1,240 @@
+/*
+Modified BSD License
+
+Copyright (c) 2021 Chloe Lunn
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors
+   may be used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// sam11 record and replay of external inputs
+
+#include "rr.h"
+
+#if USE_RR
+
+#include "kb11.h"  // 11/45
+#include "kd11.h"  // 11/40
+#include "platform.h"
+#include "sam11.h"
+
+#include <Arduino.h>
+#include <SdFat.h>
+
+#if USE_11_45 && !STRICT_11_40
+#define procNS kb11
+#else
+#define procNS kd11
+#endif
+
+namespace rr {
+
+PERMACHINE uint64_t steps;
+
+PERMACHINE SdFile file;
+
+#define RR_BUF (512 / sizeof(event))
+
+static PERMACHINE event buf[RR_BUF];
+static PERMACHINE uint16_t pos;  // position in buf
+static PERMACHINE uint16_t len;  // events in buf (replay)
+
+static PERMACHINE uint32_t sync_in;  // steps until the next sync point
+static PERMACHINE uint32_t last_ms;
+static PERMACHINE uint32_t start_ms;
+
+static uint32_t checksum()
+{
+    procNS::flags();
+    uint32_t sum = procNS::PS;
+    for (uint8_t i = 0; i < 8; i++)
+        sum = (sum << 3 | sum >> 29) ^ (uint16_t)procNS::R[i];
+    return sum;
+}
+
+void begin()
+{
+    steps = 0;
+    sync_in = RR_SYNC;
+    pos = 0;
+    len = 0;
+
+#if USE_RR == RR_RECORD
+    if (!file.open(RR_FILE, O_RDWR | O_CREAT | O_TRUNC))
+    {
+        Serial.println(F("%% rr: failed to open " RR_FILE " for recording"));
+        panic();
+    }
+    Serial.println(F("%% Recording inputs to " RR_FILE));
+#else
+    if (!file.open(RR_FILE, O_READ))
+    {
+        Serial.println(F("%% rr: failed to open " RR_FILE " for replay"));
+        panic();
+    }
+    Serial.println(F("%% Replaying inputs from " RR_FILE));
+#endif
+
+    last_ms = start_ms = millis();
+}
+
+#if USE_RR == RR_RECORD
+
+static void flush()
+{
+    if (pos)
+    {
+        file.write(buf, pos * sizeof(event));
+        pos = 0;
+    }
+    file.sync();
+}
+
+void record(uint8_t type, uint8_t data)
+{
+    event& e = buf[pos];
+    e.step = steps;
+    e.sum = checksum();
+    e.pc = procNS::R[7];
+    e.type = type;
+    e.data = data;
+
+    if (++pos == RR_BUF)
+    {
+        file.write(buf, sizeof(buf));
+        pos = 0;
+    }
+}
+
+#else
+
+static void diverged(const event& e, const char* why)
+{
+    _printf("%%%% rr: diverged at step %lu (%s), PC 0%06o expected 0%06o\r\n", (unsigned long)steps, why, (uint16_t)procNS::R[7], e.pc);
+    panic();
+}
+
+// the next event in the log, or 0 if it's run out
+static event* next()
+{
+    if (pos == len)
+    {
+        int n = file.read(buf, sizeof(buf));
+        pos = 0;
+        len = n > 0 ? n / sizeof(event) : 0;
+        if (!len)
+            return 0;
+    }
+    return &buf[pos];
+}
+
+// check the next event is the one the machine is up to, then consume it
+static bool match(uint8_t type)
+{
+    event* e = next();
+    if (!e)
+    {
+        _printf("%%%% rr: replay finished after %lu steps in %lums\r\n", (unsigned long)steps, (unsigned long)(millis() - start_ms));
+        panic();
+    }
+    if (e->step < steps)
+        diverged(*e, "missed event");
+    if (e->step > steps || e->type != type)
+        return false;
+    if (e->pc != (uint16_t)procNS::R[7] || e->sum != checksum())
+        diverged(*e, "registers differ");
+    return true;
+}
+
+bool replay(uint8_t type, char* data)
+{
+    if (!match(type))
+        return false;
+    if (data)
+        *data = buf[pos].data;
+    pos++;
+    return true;
+}
+
+#endif
+
+// done with the log, e.g. halted, so write out the rest of a recording
+void end()
+{
+    if (!file.isOpen())
+        return;
+#if USE_RR == RR_RECORD
+    flush();
+#endif
+    file.close();
+}
+
+// how many more steps until the next sync point, or replayed event
+uint32_t quiet()
+{
+    uint32_t n = sync_in - 1;
+#if USE_RR == RR_REPLAY
+    event* e = next();
+    if (!e || e->step <= steps)
+        return 0;
+    if (e->step - steps - 1 < n)
+        n = e->step - steps - 1;
+#endif
+    return n;
+}
+
+// skip n steps, n must be no more than quiet()
+void skip(uint32_t n)
+{
+    steps += n;
+    sync_in -= n;
+}
+
+// called once per processor step, before the instruction
+void step()
+{
+    steps++;
+    if (--sync_in)
+        return;
+    sync_in = RR_SYNC;
+
+#if USE_RR == RR_RECORD
+    record(EV_SYNC, 0);
+    if (millis() - last_ms >= RR_FLUSH_MS)
+    {
+        flush();
+        last_ms = millis();
+    }
+#else
+    if (!match(EV_SYNC))
+        diverged(*next(), "missed sync");
+    pos++;
+#endif
+}
+
+};  // namespace rr
+
+#endif
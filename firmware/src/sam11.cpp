@@ -32,7 +32,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "sam11.h"
 
+#include "ckpt.h"
 #include "dd11.h"
+#include "dh11.h"
+#include "dl11.h"
 #include "ini.h"
 #include "kb11.h"  // 11/45
 #include "kd11.h"  // 11/40
@@ -44,6 +47,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "pdp1140.h"
 #include "platform.h"
 #include "rk11.h"
+#include "rr.h"
 #include "termopts.h"
 #include "xmem.h"
 
@@ -65,9 +69,9 @@ int serialWrite(char c, FILE* f)
 #endif
 
 #if USE_SDIO && !defined(__IMXRT1062__)  // If SDIO and not a Teensy 4/4.1
-SdFatSdio sd;
+PERMACHINE SdFatSdio sd;
 #else  // SPI or Teensy
-SdFat sd;
+PERMACHINE SdFat sd;
 #endif
 
 #if USE_11_45 && !STRICT_11_40
@@ -109,6 +113,14 @@ void setup(void)
     while (!Serial)
         ;
 
+#if DL_TTYS
+    // Start the serial lines
+    dl11::begin();
+#endif
+#if USE_DH
+    dh11::begin();
+#endif
+
         // init the sd card
 #if !USE_SDIO && !defined(__IMXRT1062__)  // SPI
     if (!sd.begin(PIN_OUT_SD_CS, SD_SCK_MHZ(SD_SPEED_MHZ)))
@@ -194,6 +206,12 @@ void setup(void)
 
     ky11::reset();    // reset the front panel - sets the switches to INST_UNIX_SINGLEUSER (0173030)
     procNS::reset();  // reset the processor
+#if USE_CKPT
+    ckpt::begin();  // pick up from the last checkpoint
+#endif
+#if USE_RR
+    rr::begin();  // start recording or replaying the inputs
+#endif
     Serial.println(F("%% Ready\r\n"));
     Serial.write(7);  // write out a bell.
 
@@ -208,12 +226,143 @@ void setup(void)
 #endif
 }
 
+// the processor is WAITing for an interrupt, so skip the devices forward to
+// their next event, or sleep if there's nothing to do but wait for one
+static void idle()
+{
+    bool quiet = kl11::idle();
+#if USE_LP
+    quiet &= lp11::idle();
+#endif
+    quiet &= kw11::idle();
+#if DL_TTYS
+    quiet &= dl11::idle();
+#endif
+#if USE_DH
+    quiet &= dh11::idle();
+#endif
+
+#if USE_RR != RR_REPLAY  // replays don't wait for anything
+    if (quiet)
+        platform::sleep();
+#endif
+}
+
+// how many more passes of the loop will poll the devices without anything happening
+static uint32_t quiet()
+{
+    uint32_t n = kl11::quiet();
+#if USE_LP
+    if (lp11::quiet() < n)
+        n = lp11::quiet();
+#endif
+    if (kw11::quiet() < n)
+        n = kw11::quiet();
+#if DL_TTYS
+    if (dl11::quiet() < n)
+        n = dl11::quiet();
+#endif
+#if USE_DH
+    if (dh11::quiet() < n)
+        n = dh11::quiet();
+#endif
+#if USE_RR
+    if (rr::quiet() < n)
+        n = rr::quiet();
+#endif
+    return n;
+}
+
+// skip n passes of the loop, n must be no more than quiet()
+static void skip(uint32_t n)
+{
+    kl11::skip(n);
+#if USE_LP
+    lp11::skip(n);
+#endif
+    kw11::skip(n);
+#if DL_TTYS
+    dl11::skip(n);
+#endif
+#if USE_DH
+    dh11::skip(n);
+#endif
+#if USE_RR
+    rr::skip(n);
+#endif
+}
+
+// the processor is polling a device status register in a loop, so skip
+// whole passes of the loop, up to just before the next device event
+static void spin()
+{
+    procNS::spinning = false;
+
+    // an interrupt is about to be taken
+    if ((itab[0].vec) && (itab[0].pri > ((procNS::PS >> 5) & 7)))
+        return;
+
+    uint32_t n = quiet() & ~1;  // whole passes of the loop, 2 instructions each
+    if (!n)
+        return;
+
+    skip(n);
+    procNS::elided += n;
+}
+
+// the processor is in a loop copying or clearing memory a word at a time, so
+// run as many passes of it as there are before the next device event in one go
+static void copy()
+{
+    procNS::copying = false;
+
+    // an interrupt is about to be taken
+    if ((itab[0].vec) && (itab[0].pri > ((procNS::PS >> 5) & 7)))
+        return;
+
+    const uint32_t n = procNS::blockrun(quiet() / 2);  // 2 instructions a pass
+    skip(2 * n);
+}
+
+#if THREADED_CORE
+// run() only goes through the loop once for all the instructions it ran, so
+// catch the devices up with the passes they missed
+static void catchup()
+{
+    if (procNS::ran > 1)
+        skip(procNS::ran - 1);
+    procNS::ran = 0;
+}
+#endif
+
+#if defined(PIN_OUT_USER_MODE) || defined(PIN_OUT_SUPER_MODE) || defined(PIN_OUT_KERNEL_MODE)
+// show the processor mode. It changes on every trap and interrupt, so rather
+// than switchmode() writing the pins each time, the loop samples it here
+static void modeleds()
+{
+    static PERMACHINE uint8_t shown = 0xFF;
+    const uint8_t mode = procNS::curuser;
+    if (mode == shown)
+        return;
+    shown = mode;
+#ifdef PIN_OUT_USER_MODE
+    digitalWrite(PIN_OUT_USER_MODE, (mode == 3) ? LED_ON : LED_OFF);
+#endif
+#ifdef PIN_OUT_SUPER_MODE
+    digitalWrite(PIN_OUT_SUPER_MODE, (mode == 1) ? LED_ON : LED_OFF);
+#endif
+#ifdef PIN_OUT_KERNEL_MODE
+    digitalWrite(PIN_OUT_KERNEL_MODE, (mode == 0) ? LED_ON : LED_OFF);
+#endif
+}
+#endif
+
 static void loop0()
 {
     while (1)
     {
         // Check for interrupts
-        if ((itab[0].vec) && (itab[0].pri >= ((procNS::PS >> 5) & 7)))
+        if ((itab[0].vec) && (itab[0].pri > ((procNS::PS >> 5) & 7)))
         {
             procNS::handleinterrupt();
             return;  // reset the loop to reset interrupt
@@ -231,19 +380,55 @@ static void loop0()
         digitalWrite(PIN_OUT_PROC_STEP, LED_ON);
 #endif
 
+#if USE_RR
+        rr::step();
+#endif
+
+#if THREADED_CORE
+        {
+            uint32_t n = quiet();
+            procNS::run(n < 0xFFFF ? n + 1 : 0xFFFF);  // run instructions up to the next device event
+            catchup();
+        }
+#else
         procNS::step();  // step the instructions
+#endif
 
 #ifdef PIN_OUT_PROC_STEP
         digitalWrite(PIN_OUT_PROC_STEP, LED_OFF);
 #endif
 
+        if (procNS::waiting)
+            idle();
+
         kw11::tick();  // tick the clock
 
+#if defined(PIN_OUT_USER_MODE) || defined(PIN_OUT_SUPER_MODE) || defined(PIN_OUT_KERNEL_MODE)
+        modeleds();
+#endif
+
         kl11::poll();  // check the terminal
+
+#if DL_TTYS
+        dl11::poll();  // and the serial lines
+#endif
+#if USE_DH
+        dh11::poll();
+#endif
+
+        if (procNS::spinning)
+            spin();
+
+        if (procNS::copying)
+            copy();
+
+#if USE_CKPT
+        ckpt::poll();  // checkpoint the machine now and again
+#endif
     }
 }
 
-jmp_buf trapbuf;
+PERMACHINE jmp_buf trapbuf;
 
 void loop()
 {
@@ -251,6 +436,9 @@ void loop()
     uint16_t vec = setjmp(trapbuf);
     if (vec)
     {
+#if THREADED_CORE
+        catchup();
+#endif
         procNS::trapat(vec);
     }
     loop0();  // restart step loop
@@ -270,15 +458,23 @@ void panic()  // aka what it does when halted
         if (rk11::attached_drives[i])
             rk11::rkdata[i].close();  // I corrupted a few UNIX disks working this one out! Whoops!
 
+#if USE_RR
+    rr::end();  // so the recording has everything up to here
+#endif
+
 #ifdef PIN_OUT_DISK_ACT
     digitalWrite(PIN_OUT_DISK_ACT, LED_OFF);
 #endif
 
+    kl11::flush();
     Serial.println("%% Processor halted.");
     if (PRINTSIMLINES)
     {
         printstate();
     }
+#if THREADED_CORE && PAIR_STATS
+    procNS::pairstats();
+#endif
     Serial.write(7);  // write out a bell
     Serial.flush();
     while (1)
@@ -61,17 +61,17 @@ enum
     TMILC = 0100000,
 };
 
-uint16_t TMER;
-uint16_t TMCS;
-uint16_t TMBC;
-uint16_t TMBA;
-uint16_t TMDB;
-uint16_t TMRD;
+PERMACHINE uint16_t TMER;
+PERMACHINE uint16_t TMCS;
+PERMACHINE uint16_t TMBC;
+PERMACHINE uint16_t TMBA;
+PERMACHINE uint16_t TMDB;
+PERMACHINE uint16_t TMRD;
 
-SdFile tmdata[NUM_TM_DRIVES];
-bool attached_drives[NUM_TM_DRIVES];
+PERMACHINE SdFile tmdata[NUM_TM_DRIVES];
+PERMACHINE bool attached_drives[NUM_TM_DRIVES];
 
-int cur_tape_no = -1;
+PERMACHINE int cur_tape_no = -1;
 
 void tmnotready()
 {
@@ -323,7 +323,6 @@ void _read()
     unsigned count;
     unsigned bytes;
     c_addr addr;
-    unsigned t;
 
     TMER &= ~TM_EOF;
     count = (0177777 - TMBC) + 1;
@@ -353,15 +352,12 @@ void _read()
             swab((char*)tm_swab, (char*)tm_buffer,
               sizeof(tm_swab));
 #endif
-            for (t = 0; t < (bytes / 2); ++t)
+            if (dd11::dmawrite(addr, (uint16_t*)tm_buffer, bytes / 2) != bytes / 2)
             {
-                if (sc_word(addr, tm_buffer[t]) != OK)
-                {
-                    TMER |= TM_NXM;
-                    return;
-                }
-                addr += 2;
+                TMER |= TM_NXM;
+                return;
             }
+            addr += bytes;
         }
     }
     TMBC = (0177777 - count) + 1;
@@ -372,7 +368,6 @@ void _write()
     uint count;
     uint bytes;
     uint32_t addr;
-    uint t;
 
     if (TMER & TM_WRL)
     {
@@ -390,12 +385,12 @@ void _write()
         TMER &= ~TM_BOT;
         bytes = (count >= 512) ? 512 : count;
         count -= bytes;
-        for (t = 0; t < (bytes / 2); ++t)
+        if (dd11::dmaread(addr, (uint16_t*)tm_buffer, bytes / 2) != bytes / 2)
         {
-            uint16_t v = tm_buffer[t + 1] + (tm_buffer[t] << 8);
-            dd11::write16(addr, v);
-            addr += 2;
+            TMER |= TM_NXM;
+            return;
         }
+        addr += bytes;
 #ifdef SWAB
         swab((char*)tm_buffer, (char*)tm_swab,
           sizeof(tm_swab));
@@ -0,0 +1,95 @@
+// KE11-E EIS instructions (MUL, DIV, ASH and ASHC) on the step() core, with
+// random operands loaded before each one, against the same code with a MOV
+// in its place. Prints the time each takes over the MOV, per instruction.
+
+#include "cpu.h"
+
+#include <chrono>
+
+#define BLOCKS (512)      // of MOV (R5)+,R2; MOV (R5)+,R3; MOV (R5)+,R4; op R4,R2
+#define TABLE  (020000)   // the operands, three words to a block
+#define ROUNDS (2000)
+
+static uint64_t seed = 88172645463325252ull;
+
+static uint16_t rnd()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+// operands for one block: R2, R3, and the source in R4
+typedef void (*operands)(uint16_t* w);
+
+static void any(uint16_t* w)
+{
+    w[0] = rnd();
+    w[1] = rnd();
+    w[2] = rnd();
+}
+
+static void count(uint16_t* w)  // a shift of -32 to +31
+{
+    any(w);
+    w[2] &= 077;
+}
+
+static void fits(uint16_t* w)  // a dividend whose quotient mostly fits in a word
+{
+    any(w);
+    w[0] = (int16_t)w[2] >> 15;
+}
+
+static double timed(uint16_t op, operands fill)
+{
+    for (uint16_t i = 0; i < BLOCKS; i++)
+    {
+        uint16_t w[3];
+        fill(w);
+        for (uint8_t j = 0; j < 3; j++)
+        {
+            ms11::write16(TABLE + 6 * i + 2 * j, w[j]);
+            ms11::write16(CODE + 8 * i + 2 * j, 012502 + j);  // MOV (R5)+,Rn
+        }
+        ms11::write16(CODE + 8 * i + 6, op);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint16_t r = 0; r < ROUNDS; r++)
+    {
+        procNS::R[7] = CODE;
+        procNS::R[5] = TABLE;
+        for (uint16_t i = 0; i < 4 * BLOCKS; i++)
+            procNS::step();
+    }
+    const std::chrono::duration<double, std::nano> ns = std::chrono::steady_clock::now() - start;
+    return ns.count() / ((double)ROUNDS * BLOCKS);
+}
+
+static void report(const char* name, uint16_t op, operands fill, double base)
+{
+    const double t = timed(op, fill);
+    printf("  %-5s %6.1f ns, %5.1f over MOV\n", name, t, t - base);
+}
+
+int main()
+{
+    boot();
+    if (setjmp(trapbuf))
+    {
+        printf("bench_eis: trapped\n");
+        return 1;
+    }
+
+    const double base = timed(010402, any);  // MOV R4,R2
+    printf("bench_eis: ns per block of three MOVs and the instruction\n");
+    printf("  %-5s %6.1f ns\n", "MOV", base);
+    report("MUL", 070204, any, base);
+    report("DIV", 071204, fits, base);
+    report("DIV/V", 071204, any, base);
+    report("ASH", 072204, count, base);
+    report("ASHC", 073204, count, base);
+    return 0;
+}
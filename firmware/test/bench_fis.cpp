@@ -0,0 +1,129 @@
+// KE11-F FIS instructions on the step() core, against the same code with a MOV
+// in their place, and the integer soft-float of fis.h on the same operands,
+// to show what running them on the host's FPU buys.
+
+#include "cpu.h"
+#include "fis.h"
+
+#include <chrono>
+
+#define BLOCKS (512)     // of MOV R5,R3; ADD #10,R5; op R3
+#define TABLE  (020000)  // the operands, B then A, four words to a block
+#define ROUNDS (2000)
+
+typedef std::chrono::steady_clock clk;
+typedef std::chrono::duration<double, std::nano> ns;
+
+static uint64_t seed = 88172645463325252ull;
+
+static uint16_t rnd()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+// operands that neither overflow nor underflow, whatever the op
+static fis::num any()
+{
+    return {(uint16_t)((rnd() & 0100177) | ((0140 + (rnd() & 077)) << 7)), rnd()};
+}
+
+static fis::num operands[BLOCKS][2];
+
+static void load()
+{
+    for (uint16_t i = 0; i < BLOCKS; i++)
+    {
+        ms11::write16(TABLE + 8 * i, operands[i][1].hi);
+        ms11::write16(TABLE + 8 * i + 2, operands[i][1].lo);
+        ms11::write16(TABLE + 8 * i + 4, operands[i][0].hi);
+        ms11::write16(TABLE + 8 * i + 6, operands[i][0].lo);
+    }
+}
+
+// ns per block; the op replaces A, so the operands are loaded again for each
+// round, outside the time
+static double timed(uint16_t op)
+{
+    for (uint16_t i = 0; i < BLOCKS; i++)
+    {
+        ms11::write16(CODE + 8 * i, 010503);      // MOV R5,R3
+        ms11::write16(CODE + 8 * i + 2, 062705);  // ADD #10,R5
+        ms11::write16(CODE + 8 * i + 4, 010);
+        ms11::write16(CODE + 8 * i + 6, op);
+    }
+
+    ns t(0);
+    for (uint16_t r = 0; r < ROUNDS; r++)
+    {
+        load();
+        procNS::R[7] = CODE;
+        procNS::R[5] = TABLE;
+        const auto start = clk::now();
+        for (uint16_t i = 0; i < 3 * BLOCKS; i++)
+            procNS::step();
+        t += clk::now() - start;
+    }
+    return t.count() / ((double)ROUNDS * BLOCKS);
+}
+
+// ns per op of the soft-float
+static double soft(uint8_t op)
+{
+    uint32_t sum = 0;  // so the work isn't thrown away
+    const auto start = clk::now();
+    for (uint16_t r = 0; r < ROUNDS; r++)
+    {
+        for (uint16_t i = 0; i < BLOCKS; i++)
+        {
+            const fis::num a = operands[i][0], b = operands[i][1];
+            fis::result res;
+            switch (op)
+            {
+            case 0:
+            case 1:
+                res = fis::add(a, b, op);
+                break;
+            case 2:
+                res = fis::mul(a, b);
+                break;
+            default:
+                res = fis::div(a, b);
+                break;
+            }
+            sum += res.n.hi ^ res.n.lo;
+        }
+    }
+    const ns t = clk::now() - start;
+    if (sum == 1)
+        printf("\n");
+    return t.count() / ((double)ROUNDS * BLOCKS);
+}
+
+int main()
+{
+    boot();
+    if (setjmp(trapbuf))
+    {
+        printf("bench_fis: trapped\n");
+        return 1;
+    }
+    for (uint16_t i = 0; i < BLOCKS; i++)
+    {
+        operands[i][0] = any();
+        operands[i][1] = any();
+    }
+
+    static const char* const names[] = {"FADD", "FSUB", "FMUL", "FDIV"};
+    const double base = timed(010303);  // MOV R3,R3
+    printf("bench_fis: ns per block of a MOV, an ADD and the instruction, and per soft-float op\n");
+    printf("  %-4s %6.1f ns\n", "MOV", base);
+    for (uint8_t op = 0; op < 4; op++)
+    {
+        const double t = timed(075003 | (op << 3));
+        printf("  %-4s %6.1f ns, %5.1f over MOV, soft-float %5.1f\n", names[op], t, t - base, soft(op));
+    }
+    return 0;
+}
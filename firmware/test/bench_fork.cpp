@@ -0,0 +1,211 @@
+// UNIX V6 booted once and forked (USE_FORK), then cloned into N machines at
+// once, each on a thread of its own, which each write a file of their own
+// and read it back. Prints how long a clone takes to make, and how much
+// memory and disk each has to itself at the end, against a whole copy of
+// them, and how much the process grew by.
+//
+//   bench_fork [clones, 100 by default] [disk image]
+
+#include "host.h"
+
+#include "pdp1140.h"
+
+#include "ms11.h"
+
+#include <Arduino.h>
+#include <chrono>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DISK  "../../resources/OS Images/unixv6.dsk"
+#define LIMIT (600)  // seconds before a machine's given up on
+
+void setup();
+void loop();
+
+struct machine
+{
+    pthread_t thread;
+    const char* const* steps;  // what to wait for, then what to type or 0, up to a 0
+    char tail[32];             // the end of its console output
+    uint8_t seen;              // how much of it there is
+    char text[16], type[32];   // what a clone writes to its file, and how
+    const char* mine[5];       // a clone's steps
+    double us;                 // how long clone() took
+    size_t footprint;          // at the end
+};
+
+static PERMACHINE machine* me;
+static char card[32] = "/tmp/sam11-bench-XXXXXX";
+static host::image* image;
+static pthread_barrier_t all;
+
+static void put(uint8_t c)
+{
+    if (!*me->steps)
+        return;
+    if (me->seen == sizeof(me->tail))
+        memmove(me->tail, me->tail + 1, --me->seen);
+    me->tail[me->seen++] = c;
+
+    const char* prompt = me->steps[0];
+    const size_t n = strlen(prompt);
+    if (me->seen < n || memcmp(me->tail + me->seen - n, prompt, n))
+        return;
+    if (me->steps[1])
+        host::script(me->steps[1], 0, 0);
+    me->steps += me->steps[1] ? 2 : 1;
+    me->seen = 0;  // so the next prompt has to be a new one
+}
+
+// run until the steps are done
+static bool until(unsigned long end)
+{
+    while (*me->steps && millis() < end)
+        loop();
+    return !*me->steps;
+}
+
+// boot V6 and log in, then fork it as the shell prompts
+static void* boot(void* p)
+{
+    static const char* const steps[] = {"@", "unix\r", "login: ", "root\r", "# ", 0, 0};
+    me = (machine*)p;
+    me->steps = steps;
+    host::card(card);
+    host::console(put);
+    host::script("", 0, 0);
+    host::deadline(LIMIT * 1000);
+
+    setup();
+    if (until(millis() + LIMIT * 1000))
+        image = host::fork();
+    host::scrap();
+    return 0;
+}
+
+// a clone of it, which writes a file of its own and reads it back
+static void* run(void* p)
+{
+    me = (machine*)p;
+    host::console(put);
+    host::deadline(LIMIT * 1000);
+
+    const auto start = std::chrono::steady_clock::now();
+    host::clone(image);
+    const std::chrono::duration<double, std::micro> us = std::chrono::steady_clock::now() - start;
+    me->us = us.count();
+
+    host::script(me->type, 0, 0);
+    until(millis() + LIMIT * 1000);
+    me->footprint = host::footprint();
+
+    pthread_barrier_wait(&all);  // while the process's size is looked at
+    host::scrap();
+    return 0;
+}
+
+static bool copy(const char* from, const char* to)
+{
+    FILE* in = fopen(from, "rb");
+    FILE* out = fopen(to, "wb");
+    bool ok = in && out;
+    char buf[65536];
+    for (size_t n; ok && (n = fread(buf, 1, sizeof(buf), in)) > 0;)
+        ok = fwrite(buf, 1, n, out) == n;
+    if (in)
+        fclose(in);
+    if (out)
+        fclose(out);
+    return ok;
+}
+
+// the process's resident memory in bytes
+static long resident()
+{
+    long size = 0, pages = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f)
+    {
+        if (fscanf(f, "%ld %ld", &size, &pages) != 2)
+            pages = 0;
+        fclose(f);
+    }
+    return pages * sysconf(_SC_PAGESIZE);
+}
+
+int main(int argc, char** argv)
+{
+    const int n = argc > 1 ? atoi(argv[1]) : 100;
+    const char* disk = argc > 2 ? argv[2] : DISK;
+
+    char path[64];
+    if (!mkdtemp(card))
+    {
+        perror("mkdtemp");
+        return 2;
+    }
+    snprintf(path, sizeof(path), "%s/unixv6.dsk", card);
+    if (!copy(disk, path))
+    {
+        fprintf(stderr, "bench_fork: can't copy %s to %s\n", disk, path);
+        return 2;
+    }
+
+    machine* m = new machine[n + 1]();
+    const auto t = std::chrono::steady_clock::now();
+    pthread_create(&m[n].thread, 0, boot, &m[n]);
+    pthread_join(m[n].thread, 0);
+    const std::chrono::duration<double> booted = std::chrono::steady_clock::now() - t;
+    if (!image)
+    {
+        fprintf(stderr, "bench_fork: UNIX V6 didn't boot\n");
+        return 1;
+    }
+    printf("bench_fork: UNIX V6 booted once in %.2f s, then %d clones of it\n", booted.count(), n);
+
+    const long before = resident();
+    pthread_barrier_init(&all, 0, n + 1);
+    for (int i = 0; i < n; i++)
+    {
+        snprintf(m[i].text, sizeof(m[i].text), "clone %d", i);
+        snprintf(m[i].type, sizeof(m[i].type), "cat >f\r%s\r\004", m[i].text);
+        const char* steps[] = {"# ", "cat f\r", m[i].text, 0, 0};
+        memcpy(m[i].mine, steps, sizeof(steps));
+        m[i].steps = m[i].mine;
+        pthread_create(&m[i].thread, 0, run, &m[i]);
+    }
+    pthread_barrier_wait(&all);
+    const long grew = resident() - before;
+
+    double sum = 0, most = 0;
+    size_t own = 0;
+    for (int i = 0; i < n; i++)
+    {
+        pthread_join(m[i].thread, 0);
+        if (*m[i].steps)
+        {
+            fprintf(stderr, "bench_fork: clone %d didn't get its file back, stuck at \"%s\"\n", i, *m[i].steps);
+            return 1;
+        }
+        sum += m[i].us;
+        if (m[i].us > most)
+            most = m[i].us;
+        own += m[i].footprint;
+    }
+    host::drop(image);
+
+    struct stat st;
+    stat(path, &st);
+    printf("  clone()      %7.1f us each, %7.1f us at most\n", sum / n, most);
+    printf("  own memory and disk %6zu KB each, of %ld KB for a whole copy\n", own / n / 1024,
+           (long)(MAX_RAM_ADDRESS + st.st_size) / 1024);
+    printf("  process grew %6ld KB each, threads and all\n", grew / n / 1024);
+
+    delete[] m;
+    char cmd[64];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", card);
+    return system(cmd) ? 2 : 0;
+}
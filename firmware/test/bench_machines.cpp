@@ -0,0 +1,176 @@
+// UNIX V6 on 1 to N machines at once in one process (MULTI_MACHINE), each on
+// a thread of its own with its own copy of the disk and its own console. Each
+// boots, logs in, types in a C program, compiles it and runs it, typing as
+// soon as V6 prompts rather than on a timer, so it's only as slow as the
+// emulator. Prints, for each number of machines, the wall time until they've
+// all got the program's answer, and how many runs a second that makes.
+//
+//   bench_machines [most machines, the CPUs by default] [disk image]
+
+#include "host.h"
+
+#include "pdp1140.h"
+
+#include "rk11.h"
+
+#include <Arduino.h>
+#include <chrono>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DISK  "../../resources/OS Images/unixv6.dsk"
+#define LIMIT (600)  // seconds before a machine's given up on
+
+void setup();
+void loop();
+
+// what to type once V6 has said what
+static const struct
+{
+    const char* prompt;
+    const char* type;
+} steps[] = {
+    {"@", "unix\r"},
+    {"login: ", "root\r"},
+    {"# ", "cat >x.c\rmain(){int i,j,s;s=0;for(j=0;j<10000;j++)for(i=0;i<1000;i++)s=+i*3%7;printf(\"%d\\n\",s);}\r\004"},
+    {"# ", "cc x.c\r"},
+    {"# ", "a.out\r"},
+    {"\n-25488", 0},
+};
+#define STEPS (sizeof(steps) / sizeof(steps[0]))
+
+struct machine
+{
+    char dir[64];  // its card
+    pthread_t thread;
+    uint8_t step;   // the next prompt it's waiting for
+    char tail[16];  // the end of its console output
+    uint8_t seen;   // how much of it there is
+    std::chrono::steady_clock::time_point done;
+};
+
+static PERMACHINE machine* me;
+
+static void put(uint8_t c)
+{
+    if (me->step == STEPS)
+        return;
+    if (me->seen == sizeof(me->tail))
+        memmove(me->tail, me->tail + 1, --me->seen);
+    me->tail[me->seen++] = c;
+
+    const char* prompt = steps[me->step].prompt;
+    const size_t n = strlen(prompt);
+    if (me->seen < n || memcmp(me->tail + me->seen - n, prompt, n))
+        return;
+    if (steps[me->step].type)
+        host::script(steps[me->step].type, 0, 0);
+    else
+        me->done = std::chrono::steady_clock::now();
+    me->step++;
+    me->seen = 0;  // so the next prompt has to be a new one
+}
+
+static void* run(void* p)
+{
+    me = (machine*)p;
+    host::card(me->dir);
+    host::console(put);
+    host::script("", 0, 0);         // nothing typed until V6 asks
+    host::deadline(LIMIT * 1000);  // one that halts stops, rather than hanging
+    const unsigned long end = millis() + LIMIT * 1000;
+
+    setup();
+    while (me->step < STEPS && millis() < end)
+        loop();
+
+    for (int i = 0; i < NUM_RK_DRIVES; i++)
+    {
+        if (rk11::attached_drives[i])
+            rk11::rkdata[i].close();
+    }
+    return 0;
+}
+
+static bool copy(const char* from, const char* to)
+{
+    FILE* in = fopen(from, "rb");
+    FILE* out = fopen(to, "wb");
+    bool ok = in && out;
+    char buf[65536];
+    for (size_t n; ok && (n = fread(buf, 1, sizeof(buf), in)) > 0;)
+        ok = fwrite(buf, 1, n, out) == n;
+    if (in)
+        fclose(in);
+    if (out)
+        fclose(out);
+    return ok;
+}
+
+// n machines from a fresh copy of the disk, the seconds until the last is done
+static double machines(int n, const char* disk, const char* dir)
+{
+    machine* m = new machine[n]();
+    for (int i = 0; i < n; i++)
+    {
+        char path[128];
+        snprintf(m[i].dir, sizeof(m[i].dir), "%s/m%d", dir, i);
+        snprintf(path, sizeof(path), "%s/unixv6.dsk", m[i].dir);
+        mkdir(m[i].dir, 0700);
+        if (!copy(disk, path))
+        {
+            fprintf(stderr, "bench_machines: can't copy %s to %s\n", disk, path);
+            exit(2);
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++)
+        pthread_create(&m[i].thread, 0, run, &m[i]);
+    double secs = 0;
+    for (int i = 0; i < n; i++)
+    {
+        pthread_join(m[i].thread, 0);
+        const std::chrono::duration<double> s = m[i].done - start;
+        if (m[i].step < STEPS)
+        {
+            fprintf(stderr, "bench_machines: machine %d of %d didn't get the answer, stuck at \"%s\"\n", i, n,
+                    steps[m[i].step].prompt);
+            exit(1);
+        }
+        if (s.count() > secs)
+            secs = s.count();
+    }
+    delete[] m;
+    return secs;
+}
+
+int main(int argc, char** argv)
+{
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const int most = argc > 1 ? atoi(argv[1]) : cpus;
+    const char* disk = argc > 2 ? argv[2] : DISK;
+
+    char dir[] = "/tmp/sam11-bench-XXXXXX";
+    if (!mkdtemp(dir))
+    {
+        perror("mkdtemp");
+        return 2;
+    }
+
+    printf("bench_machines: boot UNIX V6, compile and run a program, on %ld CPUs\n", cpus);
+    double one = 0;
+    for (int n = 1; n <= most; n++)
+    {
+        const double secs = machines(n, disk, dir);
+        if (n == 1)
+            one = secs;
+        printf("  %3d machines %7.2f s, %6.2f runs/s, %5.2fx one machine\n", n, secs, n / secs, n * one / secs);
+    }
+
+    char cmd[64];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    return system(cmd) ? 2 : 0;
+}
@@ -0,0 +1,147 @@
+// The same output through a DL11 line, a character and an interrupt at a
+// time, and through a DH11 line, a DMA buffer and an interrupt at a time, to
+// the host build's ptys (host/pty.cpp). A thread reads each pty as a user
+// would. Prints the interrupts the PDP would take, and per byte, the time the
+// emulator's own thread spends and the time until the reader has it.
+
+#include "cpu.h"
+
+#include "dh11.h"
+#include "dl11.h"
+#include "host.h"
+
+#include <Arduino.h>
+#include <chrono>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <termios.h>
+#include <time.h>
+
+#define BYTES  (256 * 1024)  // sent on each line
+#define BUFFER (64)          // bytes in each DH11 buffer, a V6 clist block's worth
+#define TEXT   (010000)      // where the DH11 buffers come from
+
+// a thread reading n bytes from a pty
+struct reader
+{
+    int fd;
+    long n;
+    pthread_t thread;
+};
+
+static void* drain(void* p)
+{
+    reader* r = (reader*)p;
+    char buf[4096];
+    for (long left = r->n; left > 0;)
+    {
+        const ssize_t n = read(r->fd, buf, sizeof(buf));
+        if (n > 0)
+            left -= n;
+    }
+    return 0;
+}
+
+static void start(reader& r, uint8_t port, long n)
+{
+    r.fd = open(host::ptyname(port), O_RDONLY | O_NOCTTY);
+    struct termios tio;
+    tcgetattr(r.fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(r.fd, TCSANOW, &tio);
+    r.n = n;
+    pthread_create(&r.thread, 0, drain, &r);
+}
+
+// take the interrupt at vec if it's waiting, returning 1 if it was
+static long take(uint16_t vec)
+{
+    for (uint8_t i = 0; i < ITABN; i++)
+    {
+        if (itab[i].vec == vec)
+        {
+            memset(itab, 0, sizeof(itab));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// poll the device until done, letting the pty threads run whenever a poll
+// doesn't get there, so waiting for the pty isn't counted as emulating
+template <class T>
+static void until(void (*poll)(), T done)
+{
+    for (poll(); !done(); poll())
+        sched_yield();
+}
+
+// ns of this thread's time
+static double busy()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void report(const char* name, long interrupts, double cpu, std::chrono::steady_clock::time_point start)
+{
+    const std::chrono::duration<double, std::nano> ns = std::chrono::steady_clock::now() - start;
+    printf("  %-5s %7ld interrupts, %6.1f ns emulating, %6.1f ns in all, per byte\n", name, interrupts, cpu / BYTES, ns.count() / BYTES);
+}
+
+int main()
+{
+    boot();
+    dl11::begin();
+    dh11::begin();
+    memset(itab, 0, sizeof(itab));
+    printf("bench_tty: %d bytes out of one line\n", BYTES);
+
+    // DL11 line 0: wait for DONE, take the interrupt, send the next
+    {
+        const uint32_t XCSR = IOPAGE(DEV_DL_1_TTY_OUT_STATUS), XBUF = IOPAGE(DEV_DL_1_TTY_OUT_DATA);
+        reader r;
+        start(r, 0, BYTES);
+        long interrupts = 0;
+        const auto t = std::chrono::steady_clock::now();
+        double cpu = busy();
+        dd11::write16(XCSR, 0100);
+        for (long i = 0; i < BYTES; i++)
+        {
+            dd11::write16(XBUF, ' ' + i % 95);
+            until(dl11::poll, [=] { return dd11::read16(XCSR) & 0200; });
+            interrupts += take(INTFLOAT + 4);
+        }
+        cpu = busy() - cpu;
+        pthread_join(r.thread, 0);
+        report("DL11", interrupts, cpu, t);
+    }
+
+    // DH11 line 0: hand it a buffer, wait for TI, take the interrupt, clear TI
+    {
+        for (uint16_t i = 0; i < BUFFER; i++)
+            ms11::write8(TEXT + i, ' ' + i % 95);
+        const uint32_t SCR = IOPAGE(DEV_DH_SCR);
+        reader r;
+        start(r, DL_LINES, BYTES);
+        long interrupts = 0;
+        const auto t = std::chrono::steady_clock::now();
+        double cpu = busy();
+        dd11::write16(SCR, 020000);  // TIE, line 0
+        for (long i = 0; i < BYTES; i += BUFFER)
+        {
+            dd11::write16(IOPAGE(DEV_DH_CAR), TEXT);
+            dd11::write16(IOPAGE(DEV_DH_BCR), -BUFFER);
+            dd11::write16(IOPAGE(DEV_DH_BAR), 1);
+            until(dh11::poll, [=] { return dd11::read16(SCR) & 0100000; });
+            interrupts += take(INTFLOAT + 010 * DL_LINES + 4);
+            dd11::write16(SCR, 020000);
+        }
+        cpu = busy() - cpu;
+        pthread_join(r.thread, 0);
+        report("DH11", interrupts, cpu, t);
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+// sam11 host tests: running instructions on the real processor
+
+#ifndef H_TEST_CPU
+#define H_TEST_CPU
+
+#include "test.h"
+
+#include "pdp1140.h"
+
+#include "dd11.h"
+#include "kb11.h"
+#include "kd11.h"
+#include "ms11.h"
+
+#include <setjmp.h>
+
+#if USE_11_45 && !STRICT_11_40
+#define procNS kb11
+#else
+#define procNS kd11
+#endif
+
+#define CODE (01000)  // where the instructions go
+
+extern PERMACHINE jmp_buf trapbuf;
+
+// a reset processor, with the MMU off, in kernel mode at priority 7
+static void boot()
+{
+    ms11::begin();
+    procNS::reset();
+    procNS::PS = 0340;
+    procNS::R[6] = CODE;
+}
+
+// load the instructions at CODE and run n of them from there, the way the
+// build runs them: step() by step(), or run() with the threaded core.
+// Returns the vector of a trap, or 0.
+static uint16_t exec(const uint16_t* code, uint8_t words, uint8_t n)
+{
+    for (uint8_t i = 0; i < words; i++)
+        ms11::write16(CODE + 2 * i, code[i]);
+    procNS::R[7] = CODE;
+
+    const uint16_t vec = setjmp(trapbuf);
+    if (vec)
+        return vec;
+#if THREADED_CORE
+    procNS::run(n);
+#else
+    for (volatile uint8_t i = 0; i < n; i++)
+        procNS::step();
+#endif
+    return 0;
+}
+
+// the condition codes, as the processor has them after flags()
+static uint8_t codes()
+{
+    procNS::flags();
+    return procNS::PS & 017;
+}
+
+// set the condition codes to f with a CCC and a SEx, which settles any
+// pending lazy codes first
+static void setcodes(uint8_t f)
+{
+    const uint16_t code[] = {0000257, (uint16_t)(0000260 | f)};
+    exec(code, 2, 2);
+}
+
+#endif
@@ -0,0 +1,129 @@
+// sam11 host tests: KE11-F FIS arithmetic worked exactly in integers, as the
+// reference for the double arithmetic in cpu_instr.cpp.h
+
+#ifndef H_TEST_FIS
+#define H_TEST_FIS
+
+#include <stdint.h>
+
+namespace fis {
+
+enum
+{
+    OK,
+    OVERFLOW,   // V
+    UNDERFLOW,  // N V
+    DIVZERO,    // N V C
+};
+
+// an F format number: high word, low word
+struct num {
+    uint16_t hi, lo;
+};
+
+// the result, or why there isn't one
+struct result {
+    uint8_t status;
+    num n;
+};
+
+// sign, and a value of frac * 2^(exp - 0230), so 0.1f * 2^(exp - 0200) for
+// the 24 bit fractions of F format
+struct parts {
+    bool neg;
+    int32_t exp;
+    unsigned __int128 frac;
+};
+
+static parts unpack(num a)
+{
+    const int32_t exp = (a.hi >> 7) & 0377;
+    if (!exp)
+        return {false, 0, 0};  // anything with a 0 exponent is 0
+    return {(a.hi & 0100000) != 0, exp, ((uint32_t)(a.hi & 0177) << 16) | a.lo | (1u << 23)};
+}
+
+// frac * 2^(exp - 0230) to 24 bits, rounding half away from zero
+static result pack(bool neg, int32_t exp, unsigned __int128 frac)
+{
+    if (!frac)
+        return {OK, {0, 0}};
+    int bits = 0;
+    for (unsigned __int128 f = frac; f; f >>= 1)
+        bits++;
+    if (bits > 24)
+    {
+        const int s = bits - 24;
+        frac = (frac + ((unsigned __int128)1 << (s - 1))) >> s;
+        exp += s;
+        if (frac >> 24)  // rounded up past the top
+        {
+            frac >>= 1;
+            exp++;
+        }
+    }
+    else
+    {
+        frac <<= 24 - bits;
+        exp -= 24 - bits;
+    }
+    if (exp > 0377)
+        return {OVERFLOW, {0, 0}};
+    if (exp <= 0)
+        return {UNDERFLOW, {0, 0}};
+    const uint32_t f = (uint32_t)frac;
+    return {OK, {(uint16_t)((neg ? 0100000 : 0) | (exp << 7) | ((f >> 16) & 0177)), (uint16_t)(f & 0177777)}};
+}
+
+// A + B, or A - B
+static result add(num a, num b, bool sub)
+{
+    parts x = unpack(a), y = unpack(b);
+    y.neg ^= sub;
+    if (!y.frac)
+        return pack(x.neg, x.exp, x.frac);
+    if (!x.frac)
+        return pack(y.neg, y.exp, y.frac);
+    if (x.exp < y.exp)
+    {
+        const parts t = x;
+        x = y;
+        y = t;
+    }
+    // past 60 bits apart the smaller is under a quarter of a unit in the last
+    // place of the larger, and can't move it
+    const int32_t d = x.exp - y.exp;
+    if (d > 60)
+        return pack(x.neg, x.exp, x.frac);
+    const unsigned __int128 xf = x.frac << 62, yf = y.frac << (62 - d);
+    if (x.neg == y.neg)
+        return pack(x.neg, x.exp - 62, xf + yf);
+    if (xf >= yf)
+        return pack(x.neg, x.exp - 62, xf - yf);
+    return pack(y.neg, x.exp - 62, yf - xf);
+}
+
+// A * B
+static result mul(num a, num b)
+{
+    const parts x = unpack(a), y = unpack(b);
+    if (!x.frac || !y.frac)
+        return {OK, {0, 0}};
+    return pack(x.neg != y.neg, x.exp + y.exp - 0230, x.frac * y.frac);
+}
+
+// A / B. The quotient is cut to 60 bits, which can't move it across a half
+// unit in the last place: that boundary is a whole number of the 60
+static result div(num a, num b)
+{
+    const parts x = unpack(a), y = unpack(b);
+    if (!y.frac)
+        return {DIVZERO, {0, 0}};
+    if (!x.frac)
+        return {OK, {0, 0}};
+    return pack(x.neg != y.neg, x.exp - y.exp + 0230 - 60, (x.frac << 60) / y.frac);
+}
+
+}  // namespace fis
+
+#endif
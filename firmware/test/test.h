@@ -0,0 +1,54 @@
+// sam11 host tests: checks that count failures instead of stopping, see
+// host/Makefile for how the tests are built and run
+
+#ifndef H_TEST
+#define H_TEST
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static long checks;
+static long failures;
+
+#define CHECK(c) check((c), #c, __FILE__, __LINE__)
+
+static bool check(bool ok, const char* what, const char* file, int line)
+{
+    checks++;
+    if (!ok && failures++ < 20)
+        printf("%s:%d: failed: %s\n", file, line, what);
+    return ok;
+}
+
+static char scratchdir[] = "/tmp/sam11-test-XXXXXX";
+
+static void unscratch()
+{
+    char cmd[64];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", scratchdir);
+    if (system(cmd))
+        perror(cmd);
+}
+
+// a scratch directory for the "SD card", see host/SdFat.h
+static void scratch()
+{
+    if (!mkdtemp(scratchdir))
+    {
+        perror("mkdtemp");
+        exit(2);
+    }
+    setenv("SAMDIR", scratchdir, 1);
+    atexit(unscratch);
+}
+
+// what main returns
+static int done(const char* name)
+{
+    printf("%s: %ld checks, %ld failed\n", name, checks, failures);
+    return failures ? 1 : 0;
+}
+
+#endif
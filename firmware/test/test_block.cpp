@@ -0,0 +1,166 @@
+// Block copy and clear loops (blockloop() and blockrun() in cpu_core.cpp.h):
+// a MOV (Rx)+,(Ry)+ or CLR (Ry)+ loop closed by a SOB, run with blockrun() as
+// loop0 does, has to leave the registers, the condition codes and memory just
+// as running it an instruction at a time does.
+
+#include "cpu.h"
+
+#include "kt11.h"
+
+#include <string.h>
+
+#define MEM   (0400000)  // bytes of physical memory compared
+#define STEPS (100000)   // most instructions a loop takes
+
+enum
+{
+    C = 1,
+    V = 2,
+    Z = 4,
+    N = 8
+};
+
+struct state
+{
+    uint16_t R[8];
+    uint16_t PS;
+    uint16_t mem[MEM / 2];
+};
+
+static state slow, fast;
+static uint32_t passes;  // run by blockrun()
+
+// kernel pages mapped to themselves, except page 2 which is at 0200000, and
+// page 7 to the I/O page
+static void mmu(bool on)
+{
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        dd11::write16(IOPAGE(DEV_KER_INS_PAR_R0 + 2 * i), i == 7 ? 0177600 : i == 2 ? 02000 : i * 0200);
+        dd11::write16(IOPAGE(DEV_KER_INS_PDR_R0 + 2 * i), 077406);  // 128 blocks, read and write
+    }
+    dd11::write16(IOPAGE(DEV_MMU_SR0), on ? 1 : 0);
+}
+
+struct loop
+{
+    const char* name;
+    uint16_t instr;        // the MOV or CLR, then SOB R2 back to it
+    uint16_t r0, r1, r2;   // source, destination and count
+    uint8_t cc;            // codes before
+    bool mmu;              // with the MMU on
+    const uint16_t* data;  // written at r0 first
+    uint8_t words;         // in data
+};
+
+// run the loop from CODE until it falls through the SOB, stepping every
+// instruction or, if quick, with blockrun() taking the passes it can
+static void run(const loop& l, bool quick, state& s)
+{
+    boot();
+    for (uint32_t a = 0; a < MEM; a += 2)
+        ms11::write16(a, (a * 077) ^ (a >> 5));
+    mmu(l.mmu);
+    setcodes(l.cc);
+
+    ms11::write16(CODE, l.instr);
+    ms11::write16(CODE + 2, 0077202);  // SOB R2, back to the MOV or CLR
+    for (uint8_t i = 0; i < l.words; i++)
+        ms11::write16(l.r0 + 2 * i, l.data[i]);  // MMU pages 0 and 1 are where they look
+    procNS::R[0] = l.r0;
+    procNS::R[1] = l.r1;
+    procNS::R[2] = l.r2;
+    procNS::R[7] = CODE;
+    procNS::copying = false;
+
+    volatile uint32_t i = 0;
+    const uint16_t vec = setjmp(trapbuf);
+    for (; !vec && procNS::R[7] != CODE + 4 && i < STEPS; i++)
+    {
+        procNS::step();
+        if (procNS::copying)
+        {
+            procNS::copying = false;
+            if (quick)
+                passes += procNS::blockrun(STEPS);
+        }
+    }
+    CHECK(!vec && procNS::R[7] == CODE + 4);
+
+    for (uint8_t r = 0; r < 8; r++)
+        s.R[r] = procNS::R[r];
+    procNS::flags();
+    s.PS = procNS::PS;
+    for (uint32_t a = 0; a < MEM; a += 2)
+        s.mem[a / 2] = ms11::read16(a);
+}
+
+// check the loop comes out the same both ways, and that blockrun() took some
+// of it if it should
+static void same(const loop& l, bool used)
+{
+    run(l, false, slow);
+    passes = 0;
+    run(l, true, fast);
+
+    const bool regs = !memcmp(slow.R, fast.R, sizeof(slow.R));
+    const bool mem = !memcmp(slow.mem, fast.mem, sizeof(slow.mem));
+    if (!CHECK(regs && slow.PS == fast.PS && mem && (passes > 0) == used))
+    {
+        printf("  %s: %u passes by blockrun%s%s\n", l.name, passes, regs ? "" : ", registers differ", mem ? "" : ", memory differs");
+        for (uint8_t r = 0; r < 8; r++)
+            printf("    R%u %06o %06o\n", r, slow.R[r], fast.R[r]);
+        printf("    PS %06o %06o\n", slow.PS, fast.PS);
+    }
+}
+
+static const uint16_t negative[] = {1, 2, 0100000};
+static const uint16_t positive[] = {0100000, 0100000, 1};
+static const uint16_t zero[] = {0177777, 0177777, 0};
+
+// copies over the SOB with a NOP, so the loop ends early
+static const uint16_t overloop[] = {1, 2, 3, 4, 0012021, 0000240};
+
+#define DATA(d) d, sizeof(d) / 2
+
+int main()
+{
+    const uint16_t MOV = 0012021;  // MOV (R0)+,(R1)+
+    const uint16_t CLR = 0005021;  // CLR (R1)+
+
+    const loop loops[] = {
+        {"MOV, apart", MOV, 010000, 020000, 100, 0, false},
+        {"MOV, dst = src + 2", MOV, 010000, 010002, 100, 0, false},
+        {"MOV, dst = src - 2", MOV, 010002, 010000, 100, 0, false},
+        {"MOV, across 8KB", MOV, 017760, 057770, 40, 0, false},
+        {"MOV, across MMU pages", MOV, 037760, 057770, 40, 0, true},
+        {"MOV, up to 0170000", MOV, 010000, 0167770, 4, 0, false},
+        {"MOV, onto the loop", MOV, 010000, CODE - 8, 100, 0, false, DATA(overloop)},
+        {"MOV, last word negative", MOV, 010000, 020000, 3, C | V | Z, false, DATA(negative)},
+        {"MOV, last word positive", MOV, 010000, 020000, 3, N | V, false, DATA(positive)},
+        {"MOV, last word zero", MOV, 010000, 020000, 3, C | N, true, DATA(zero)},
+        {"CLR", CLR, 0, 020000, 100, N | V | C, false},
+        {"CLR, up to the loop", CLR, 0, CODE - 2 * 50, 50, N | V | C, false},
+        {"CLR, across MMU pages", CLR, 0, 037000, 1000, N, true},
+        {"CLR, one pass", CLR, 0, 020000, 1, N, false},
+    };
+
+    for (const loop& l : loops)
+        same(l, l.data != overloop && l.r2 > 1);
+
+    // the loop ended early on the NOP it copied in, with the count left over
+    run(loops[6], true, fast);
+    CHECK(fast.R[2] == 100 - 5 && fast.mem[(CODE + 2) / 2] == 0000240);
+
+    // the codes are from the last word moved
+    run(loops[7], true, fast);
+    CHECK((fast.PS & 017) == (N | C));
+    run(loops[8], true, fast);
+    CHECK((fast.PS & 017) == 0);
+    run(loops[9], true, fast);
+    CHECK((fast.PS & 017) == (Z | C));
+    run(loops[10], true, fast);
+    CHECK((fast.PS & 017) == Z);
+
+    return done("test_block");
+}
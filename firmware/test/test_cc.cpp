@@ -0,0 +1,274 @@
+// Lazy condition codes (setcc()/flags() in cpu_core.cpp.h) against eager ones:
+//  - every instruction that notes its result for flags() instead of setting
+//    PS, byte and word, against the handbook, with operands either side of
+//    each sign and carry boundary;
+//  - each of those followed by every instruction that reads or keeps the
+//    codes, including the branches, against the same instruction run after
+//    the codes were set in PS directly.
+
+#include "cpu.h"
+
+struct op {
+    const char* name;
+    uint16_t instr;  // with R1 as the source and R0 as the destination
+};
+
+// the instructions that leave their codes to flags()
+static const op lazy[] = {
+    {"MOV", 0010100},
+    {"MOVB", 0110100},
+    {"CMP", 0020100},
+    {"CMPB", 0120100},
+    {"BIT", 0030100},
+    {"BITB", 0130100},
+    {"BIC", 0040100},
+    {"BICB", 0140100},
+    {"BIS", 0050100},
+    {"BISB", 0150100},
+    {"ADD", 0060100},
+    {"SUB", 0160100},
+    {"XOR", 0074100},
+    {"TST", 0005700},
+    {"TSTB", 0105700},
+    {"INC", 0005200},
+    {"INCB", 0105200},
+    {"DEC", 0005300},
+    {"DECB", 0105300},
+};
+
+// and the ones that come after them: these, and everything else that reads
+// the codes or keeps some of them
+static const op after[] = {
+    {"CLR", 0005000},
+    {"CLRB", 0105000},
+    {"COM", 0005100},
+    {"COMB", 0105100},
+    {"NEG", 0005400},
+    {"NEGB", 0105400},
+    {"ADC", 0005500},
+    {"ADCB", 0105500},
+    {"SBC", 0005600},
+    {"SBCB", 0105600},
+    {"ROR", 0006000},
+    {"RORB", 0106000},
+    {"ROL", 0006100},
+    {"ROLB", 0106100},
+    {"ASR", 0006200},
+    {"ASRB", 0106200},
+    {"ASL", 0006300},
+    {"ASLB", 0106300},
+    {"SWAB", 0000300},
+    {"SXT", 0006700},
+    {"CLC", 0000241},
+    {"SEV", 0000262},
+    {"BNE", 0001001},
+    {"BEQ", 0001401},
+    {"BGE", 0002001},
+    {"BLT", 0002401},
+    {"BGT", 0003001},
+    {"BLE", 0003401},
+    {"BPL", 0100001},
+    {"BMI", 0100401},
+    {"BHI", 0101001},
+    {"BLOS", 0101401},
+    {"BVC", 0102001},
+    {"BVS", 0102401},
+    {"BCC", 0103001},
+    {"BCS", 0103401},
+};
+
+// either side of the byte and word sign and carry boundaries
+static const uint16_t edges[] = {
+    0000000, 0000001, 0000002, 0000176, 0000177, 0000200, 0000201, 0000376, 0000377,
+    0000400, 0000577, 0000600, 0037777, 0040000, 0077776, 0077777, 0100000, 0100001,
+    0100177, 0100200, 0137777, 0140000, 0177400, 0177577, 0177600, 0177776, 0177777,
+};
+#define EDGES (sizeof(edges) / sizeof(edges[0]))
+
+enum
+{
+    N = 8,
+    Z = 4,
+    V = 2,
+    C = 1
+};
+
+// the result in R0 and the codes, as the handbook has them
+struct result {
+    uint16_t r0;
+    uint8_t cc;
+};
+
+static result handbook(uint16_t instr, uint16_t r0, uint16_t r1, uint8_t cc)
+{
+    const bool byte = (instr & 0100000) && (instr & 0170000) != 0160000;
+    const uint16_t mask = byte ? 0377 : 0177777;
+    const uint16_t sign = byte ? 0200 : 0100000;
+    const uint16_t src = r1 & mask;
+    const uint16_t dst = r0 & mask;
+    uint16_t res;
+    bool store = true;
+    uint8_t v = 0;
+    uint8_t c = cc & C;
+
+    switch (instr & ~0100000)
+    {
+    case 0010100:  // MOV
+        res = src;
+        break;
+    case 0020100:  // CMP
+        res = (src - dst) & mask;
+        store = false;
+        v = ((src ^ dst) & (src ^ res) & sign) ? V : 0;
+        c = src < dst ? C : 0;
+        break;
+    case 0030100:  // BIT
+        res = src & dst;
+        store = false;
+        break;
+    case 0040100:  // BIC
+        res = ~src & dst & mask;
+        break;
+    case 0050100:  // BIS
+        res = src | dst;
+        break;
+    case 0060100:  // ADD and SUB
+        if (instr & 0100000)
+        {
+            res = dst - src;
+            v = ((src ^ dst) & (dst ^ res) & sign) ? V : 0;
+            c = dst < src ? C : 0;
+        }
+        else
+        {
+            res = dst + src;
+            v = (~(src ^ dst) & (dst ^ res) & sign) ? V : 0;
+            c = (uint32_t)src + dst > 0177777 ? C : 0;
+        }
+        break;
+    case 0074100:  // XOR
+        res = src ^ dst;
+        break;
+    case 0005700:  // TST
+        res = dst;
+        store = false;
+        c = 0;
+        break;
+    case 0005200:  // INC
+        res = (dst + 1) & mask;
+        v = dst == sign - 1 ? V : 0;
+        break;
+    case 0005300:  // DEC
+        res = (dst - 1) & mask;
+        v = dst == sign ? V : 0;
+        break;
+    default:
+        CHECK(!"no handbook entry");
+        return {r0, cc};
+    }
+
+    const uint8_t f = ((res & sign) ? N : 0) | (res == 0 ? Z : 0) | v | c;
+    if (!store)
+        return {r0, f};
+    if ((instr & 0170000) == 0110000)  // MOVB to a register sign extends
+        return {(uint16_t)((res & 0200) ? res | 0177400 : res), f};
+    if (byte)
+        return {(uint16_t)((r0 & 0177400) | res), f};
+    return {res, f};
+}
+
+static uint64_t seed = 88172645463325252ull;
+
+static uint16_t rnd()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+// one lazy instruction against the handbook, through N() and Z() as the
+// branches see them, then flags()
+static void single(const op& o, uint16_t r0, uint16_t r1, uint8_t cc)
+{
+    setcodes(cc);
+    procNS::R[0] = r0;
+    procNS::R[1] = r1;
+    exec(&o.instr, 1, 1);
+
+    const result want = handbook(o.instr, r0, r1, cc);
+    const bool n = procNS::N(), z = procNS::Z();
+    const uint8_t got = codes();
+    if (!CHECK(procNS::R[0] == want.r0 && got == want.cc && n == !!(want.cc & N) && z == !!(want.cc & Z)))
+    {
+        printf("  %s R0=%06o R1=%06o cc=%02o: R0 %06o cc %02o (N %d Z %d), want %06o cc %02o\n", o.name, r0, r1,
+               cc, (uint16_t)procNS::R[0], got, n, z, want.r0, want.cc);
+    }
+}
+
+// a lazy instruction followed by another, against the second run on its own
+// with the handbook's codes for the first put in PS
+static void pair(const op& first, const op& second, uint16_t r0, uint16_t r1, uint8_t cc)
+{
+    const result mid = handbook(first.instr, r0, r1, cc);
+
+    setcodes(mid.cc);
+    procNS::R[0] = mid.r0;
+    procNS::R[1] = r1;
+    exec(&second.instr, 1, 1);
+    const uint16_t want_r0 = procNS::R[0];
+    const uint16_t want_jump = procNS::R[7] - CODE;
+    const uint8_t want = codes();
+
+    const uint16_t code[] = {first.instr, second.instr};
+    setcodes(cc);
+    procNS::R[0] = r0;
+    procNS::R[1] = r1;
+    exec(code, 2, 2);
+    const uint16_t jump = procNS::R[7] - (CODE + 2);
+    const uint8_t got = codes();
+
+    if (!CHECK(procNS::R[0] == want_r0 && jump == want_jump && got == want))
+    {
+        printf("  %s; %s R0=%06o R1=%06o cc=%02o: R0 %06o +%o cc %02o, want %06o +%o cc %02o\n", first.name,
+               second.name, r0, r1, cc, (uint16_t)procNS::R[0], jump, got, want_r0, want_jump, want);
+    }
+}
+
+static void pairs(const op& first, const op& second)
+{
+    for (uint8_t i = 0; i < EDGES; i++)
+    {
+        for (uint8_t j = 0; j < EDGES; j++)
+            pair(first, second, edges[i], edges[j], (i * EDGES + j) & 017);
+    }
+}
+
+int main()
+{
+    boot();
+
+    for (const op& o : lazy)
+    {
+        for (uint8_t i = 0; i < EDGES; i++)
+        {
+            for (uint8_t j = 0; j < EDGES; j++)
+            {
+                for (uint8_t cc = 0; cc < 16; cc++)
+                    single(o, edges[i], edges[j], cc);
+            }
+        }
+        for (uint32_t i = 0; i < 0200000; i++)  // every pair of bytes, and as many random words
+            single(o, (i & 0377) | (rnd() & 0177400), (i >> 8) | (rnd() & 0177400), rnd() & 017);
+    }
+
+    for (const op& first : lazy)
+    {
+        for (const op& second : lazy)
+            pairs(first, second);
+        for (const op& second : after)
+            pairs(first, second);
+    }
+
+    return done("test_cc");
+}
@@ -0,0 +1,184 @@
+// Checkpoints: a chain cut short restores to its last whole checkpoint, a
+// long chain is merged a slice at a time rather than inside take(), and a
+// merge that fails doesn't lose the checkpoints taken after it
+
+#include "test.h"
+
+#include "ckpt.h"
+#include "kd11.h"
+#include "ms11.h"
+#include "sam11.h"
+
+#include <SdFat.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static uint16_t ram[MAX_RAM_ADDRESS / 2];
+
+static const char* name(uint16_t n)
+{
+    static char fn[16];
+    snprintf(fn, sizeof(fn), "ckpt.%03u", n);
+    return fn;
+}
+
+// write a pattern over one page of ram, or all of it for page < 0
+static void scribble(int page, uint16_t seed)
+{
+    const uint32_t from = page < 0 ? 0 : (uint32_t)page << MS11_PAGE_SHIFT;
+    const uint32_t to = page < 0 ? MAX_RAM_ADDRESS : from + MS11_PAGE_SIZE;
+    for (uint32_t a = from; a < to; a += 2)
+        ms11::write16(a, (uint16_t)(a * 7 + seed * 40503));
+}
+
+static void remember()
+{
+    for (uint32_t a = 0; a < MAX_RAM_ADDRESS; a += 2)
+        ram[a / 2] = ms11::read16(a);
+}
+
+static bool same()
+{
+    for (uint32_t a = 0; a < MAX_RAM_ADDRESS; a += 2)
+    {
+        if (ram[a / 2] != ms11::read16(a))
+            return false;
+    }
+    return true;
+}
+
+// run poll() until what's on the card is done with, one slice at a time
+static uint32_t slices(bool (*busy)())
+{
+    uint32_t n = 0;
+    while (busy() && n < 1000)
+    {
+        for (uint16_t i = 0; i < CKPT_CHECK; i++)
+            ckpt::poll();
+        n++;
+    }
+    return n;
+}
+
+static bool merging()
+{
+    return sd.exists(name(1)) || sd.exists("ckpt.tmp");
+}
+
+// take checkpoints, each with a page changed, until the chain is full
+static void fill(uint16_t from)
+{
+    for (uint16_t n = from; n <= CKPT_MAX_CHAIN; n++)
+    {
+        scribble(n % MS11_PAGES, n + 20);
+        CHECK(ckpt::take());
+    }
+}
+
+int main()
+{
+    scratch();
+    ms11::begin();
+    kd11::reset();
+    ms11::soil();
+
+    // a full checkpoint, and two more on top, the last of which is cut short
+    scribble(-1, 1);
+    kd11::R[1] = 0111;
+    CHECK(ckpt::take());
+    scribble(3, 2);
+    kd11::R[1] = 0222;
+    CHECK(ckpt::take());
+    remember();
+    scribble(5, 3);
+    scribble(6, 3);
+    kd11::R[1] = 0333;
+    CHECK(ckpt::take());
+    SdFile f;
+    CHECK(f.open(name(2), O_READ));
+    const uint32_t size = f.fileSize();
+    f.close();
+    CHECK(truncate(sdpath(name(2)), size - 1) == 0);
+
+    scribble(-1, 9);
+    kd11::R[1] = 0;
+    CHECK(ckpt::restore());
+    CHECK(same());
+    CHECK(kd11::R[1] == 0222);
+    CHECK(!sd.exists(name(2)));  // so the next one can't follow on from it
+
+    // a bad header on the full checkpoint is no chain at all
+    scribble(4, 4);
+    CHECK(ckpt::take());
+    CHECK(f.open(name(0), O_RDWR));
+    f.seekSet(0);
+    f.write((uint8_t)'X');
+    f.close();
+    CHECK(!ckpt::restore());
+    CHECK(!sd.exists(name(2)));
+
+    // start again, and grow the chain until it has to be merged
+    ckpt::begin();
+    CHECK(!sd.exists(name(0)));
+    for (uint16_t n = 0; n <= CKPT_MAX_CHAIN; n++)
+    {
+        scribble(n % MS11_PAGES, n + 10);
+        kd11::R[2] = n;
+        CHECK(ckpt::take());
+    }
+    remember();
+    CHECK(sd.exists(name(CKPT_MAX_CHAIN)));  // take() left the merge to poll()
+
+    CHECK(slices(merging) > CKPT_MAX_CHAIN);
+    CHECK(sd.exists(name(0)));
+    CHECK(!sd.exists(name(1)));
+
+    scribble(-1, 99);
+    kd11::R[2] = 0;
+    CHECK(ckpt::restore());
+    CHECK(same());
+    CHECK(kd11::R[2] == CKPT_MAX_CHAIN);
+
+    // and the chain carries on from the merged checkpoint
+    scribble(7, 5);
+    CHECK(ckpt::take());
+    CHECK(sd.exists(name(1)));
+    remember();
+    scribble(-1, 98);
+    CHECK(ckpt::restore());
+    CHECK(same());
+
+    // a merge that can't write ckpt.tmp (here it's a directory) leaves the
+    // chain alone, and nothing is added to it until a merge works
+    fill(2);
+    CHECK(mkdir(sdpath("ckpt.tmp"), 0700) == 0);
+    slices([] { return sd.exists("ckpt.tmp"); });  // merge_fail() removes it
+    CHECK(sd.exists(name(CKPT_MAX_CHAIN)));
+    scribble(2, 6);
+    kd11::R[3] = 0444;
+    CHECK(!ckpt::take());
+    CHECK(!sd.exists(name(CKPT_MAX_CHAIN + 1)));
+    slices(merging);  // take() started it again
+    CHECK(!sd.exists(name(1)));
+    CHECK(ckpt::take());  // with page 2, which was still dirty
+    remember();
+    scribble(-1, 97);
+    kd11::R[3] = 0;
+    CHECK(ckpt::restore());
+    CHECK(same());
+    CHECK(kd11::R[3] == 0444);
+
+    // one of take()'s checkpoints that can't be read back starts a new chain
+    // rather than being merged without
+    fill(2);
+    CHECK(truncate(sdpath(name(5)), 100) == 0);
+    slices([] { return sd.exists(name(CKPT_MAX_CHAIN)); });
+    CHECK(!sd.exists(name(0)));
+    CHECK(ckpt::take());
+    remember();
+    scribble(-1, 96);
+    CHECK(ckpt::restore());
+    CHECK(same());
+
+    return done("test_ckpt");
+}
@@ -0,0 +1,152 @@
+// The decoded instruction cache (DECODE_CACHE): an instruction that's been
+// run, so it's in the cache, and is then overwritten has to run as the new
+// instruction. The write can come from the processor, a word or either byte,
+// through another virtual address for the same ram, or from a disk transfer.
+
+#include "cpu.h"
+
+#include "rk11.h"
+
+#include <string.h>
+
+#define MODIFY (02000)  // where the instruction doing the overwriting goes
+
+enum
+{
+    INC_R0 = 0005200,
+    DEC_R0 = 0005300,
+    ASR_R0 = 0006200,
+    INC_R1 = 0005201,
+    DEC_R1 = 0005301,
+};
+
+// run n instructions from CODE again, without loading them
+static uint16_t again(uint8_t n)
+{
+    procNS::R[7] = CODE;
+    const uint16_t vec = setjmp(trapbuf);
+    if (vec)
+        return vec;
+#if THREADED_CORE
+    procNS::run(n);
+#else
+    for (volatile uint8_t i = 0; i < n; i++)
+        procNS::step();
+#endif
+    return 0;
+}
+
+// run one instruction of three words at MODIFY, e.g. a MOV #x,@#a
+static void modify(uint16_t instr, uint16_t src, uint16_t dst)
+{
+    ms11::write16(MODIFY, instr);
+    ms11::write16(MODIFY + 2, src);
+    ms11::write16(MODIFY + 4, dst);
+    procNS::R[7] = MODIFY;
+    const uint16_t vec = setjmp(trapbuf);
+    if (!vec)
+        procNS::step();
+    CHECK(!vec && procNS::R[7] == MODIFY + 6);
+}
+
+// run INC R0 at CODE so it's cached, overwrite it with the MOV or MOVB at
+// MODIFY, and check the next run sees r0 after the new instruction
+static void overwrite(const char* name, uint16_t instr, uint16_t src, uint16_t dst, uint16_t r0)
+{
+    const uint16_t code[] = {INC_R0};
+    procNS::R[0] = 4;
+    exec(code, 1, 1);
+    CHECK(procNS::R[0] == 5);
+
+    modify(instr, src, dst);
+    procNS::R[0] = 4;
+    again(1);
+    if (!CHECK(procNS::R[0] == r0))
+        printf("  %s: R0 %06o, want %06o\n", name, (uint16_t)procNS::R[0], r0);
+}
+
+// kernel page 0 mapped to itself and again as page 1, and page 7 to the I/O
+// page
+static void mmu(bool on)
+{
+    dd11::write16(IOPAGE(DEV_KER_INS_PAR_R0), 0);
+    dd11::write16(IOPAGE(DEV_KER_INS_PDR_R0), 077406);  // 128 blocks, read and write
+    dd11::write16(IOPAGE(DEV_KER_INS_PAR_R0 + 2), 0);
+    dd11::write16(IOPAGE(DEV_KER_INS_PDR_R0 + 2), 077406);
+    dd11::write16(IOPAGE(DEV_KER_INS_PAR_R0 + 14), 0177600);
+    dd11::write16(IOPAGE(DEV_KER_INS_PDR_R0 + 14), 077406);
+    dd11::write16(IOPAGE(DEV_MMU_SR0), on ? 1 : 0);
+}
+
+// a one sector RK05 image with DEC R0 at the start, as drive 0
+static void disk()
+{
+    scratch();
+    char path[64];
+    snprintf(path, sizeof(path), "%s/unixv6.dsk", scratchdir);
+    uint16_t sector[256] = {DEC_R0};
+    FILE* f = fopen(path, "wb");
+    CHECK(f && fwrite(sector, sizeof(sector), 1, f) == 1);
+    if (f)
+        fclose(f);
+    CHECK(rk11::rkdata[0].open("unixv6.dsk", O_RDWR));
+    rk11::attached_drives[0] = true;
+}
+
+int main()
+{
+    boot();
+
+    // word and byte writes
+    overwrite("MOV", 0012737, DEC_R0, CODE, 3);
+    overwrite("MOVB, low byte", 0112737, DEC_R0 & 0377, CODE, 3);
+    overwrite("MOVB, high byte", 0112737, ASR_R0 >> 8, CODE + 1, 2);
+
+    // through another virtual address for the same ram
+    mmu(true);
+    overwrite("MOV, through page 1", 0012737, DEC_R0, 020000 + CODE, 3);
+    mmu(false);
+
+    // the second of two instructions, which the threaded core may have run
+    // as a pair
+    {
+        const uint16_t code[] = {INC_R0, INC_R1};
+        procNS::R[0] = procNS::R[1] = 4;
+        exec(code, 2, 2);
+        modify(0012737, DEC_R1, CODE + 2);
+        procNS::R[0] = procNS::R[1] = 4;
+        again(2);
+        CHECK(procNS::R[0] == 5 && procNS::R[1] == 3);
+    }
+
+    // a disk transfer into ram, the way a bootstrap or an overlay is loaded
+    disk();
+    {
+        const uint16_t code[] = {INC_R0};
+        procNS::R[0] = 4;
+        exec(code, 1, 1);
+        dd11::write16(IOPAGE(DEV_RK_DA), 0);
+        dd11::write16(IOPAGE(DEV_RK_BA), CODE);
+        dd11::write16(IOPAGE(DEV_RK_WC), -256);
+        dd11::write16(IOPAGE(DEV_RK_CS), 05);  // read, go
+        CHECK((dd11::read16(IOPAGE(DEV_RK_CS)) & 0100200) == 0200);  // ready, no error
+        CHECK(ms11::read16(CODE) == DEC_R0);
+        procNS::R[0] = 4;
+        again(1);
+        CHECK(procNS::R[0] == 3);
+    }
+
+    // and a block transfer straight through the bus
+    {
+        const uint16_t code[] = {INC_R0};
+        procNS::R[0] = 4;
+        exec(code, 1, 1);
+        const uint16_t dec[] = {DEC_R0};
+        CHECK(dd11::dmawrite(CODE, dec, 1) == 1);
+        procNS::R[0] = 4;
+        again(1);
+        CHECK(procNS::R[0] == 3);
+    }
+
+    return done("test_dcache");
+}
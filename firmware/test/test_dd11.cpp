@@ -0,0 +1,109 @@
+// The UNIBUS (dd11.cpp): block transfers stop at the exact word where nothing
+// answers, and byte writes to the I/O page reach the register's own byte
+// without reading it, so they neither trap nor clear anything.
+
+#include "cpu.h"
+
+#include "host.h"
+#include "kl11.h"
+#include "kt11.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+#define N 16  // words in a transfer
+
+static uint16_t buf[N];
+
+// fill ram below a with a pattern, and buf with another
+static void patterns(uint32_t a)
+{
+    for (uint16_t i = 0; i < N; i++)
+    {
+        ms11::write16(a - 2 * N + 2 * i, 0100000 | i);
+        buf[i] = 0125000 | i;
+    }
+}
+
+// N words from the UNIBUS address a, n of them in ram below the physical
+// address top, and nothing answering at top
+static void nxm(const char* name, uint32_t a, uint32_t top, uint16_t n)
+{
+    patterns(top);
+    memset(buf, 0, sizeof(buf));
+    uint16_t got = dd11::dmaread(a, buf, N);
+    bool ok = got == n;
+    for (uint16_t i = 0; i < N; i++)
+        ok &= buf[i] == (i < n ? (0100000 | (N - n + i)) : 0);
+    if (!CHECK(ok))
+        printf("  %s: dmaread moved %u words, want %u\n", name, got, n);
+
+    patterns(top);
+    got = dd11::dmawrite(a, buf, N);
+    ok = got == n;
+    for (uint16_t i = 0; i < N; i++)
+        ok &= ms11::read16(top - 2 * N + 2 * i) == (i < N - n ? (0100000 | i) : (0125000 | (i - N + n)));
+    if (!CHECK(ok))
+        printf("  %s: dmawrite moved %u words, want %u\n", name, got, n);
+}
+
+// what the CPU sees at the I/O page register at UNIBUS address a
+static uint16_t reg(uint32_t a)
+{
+    return dd11::read16(IOPAGE(a));
+}
+
+// a console character waiting in TKB
+static void typed(const char* c)
+{
+    host::script(c, 0, 0);
+    for (uint32_t i = 0; i < 100000 && !(reg(DEV_CONSOLE_TTY_IN_STATUS) & 0200); i++)
+        kl11::poll();
+    CHECK(reg(DEV_CONSOLE_TTY_IN_STATUS) & 0200);
+}
+
+int main()
+{
+    boot();
+
+    // the end of ram, where nothing answers at the start of the I/O page
+    nxm("end of ram", 0760000 - 2 * 5, 0760000, 5);
+    nxm("up to the end of ram", 0760000 - 2 * N, 0760000, N);
+    nxm("I/O page", 0760000, 0760000, 0);
+
+#if USE_22BIT
+    // through the UNIBUS map, onto the top of ram and into the I/O page
+    kt11::SR3 = SR3_UBMAP;
+    kt11::ubmap[1] = MAX_RAM_ADDRESS - 020000 + 2 * 6;
+    nxm("UNIBUS map", 040000 - 2 * 2 * 6, MAX_RAM_ADDRESS, 6);
+    kt11::SR3 = 0;
+#endif
+
+    // byte writes to TKB leave the character there, and DONE set
+    typed("x");
+    dd11::write8(IOPAGE(DEV_CONSOLE_TTY_IN_DATA), 0);
+    dd11::write8(IOPAGE(DEV_CONSOLE_TTY_IN_DATA) + 1, 0);
+    CHECK(reg(DEV_CONSOLE_TTY_IN_STATUS) & 0200);
+    CHECK(kl11::peek16(DEV_CONSOLE_TTY_IN_DATA) == 'x');
+    CHECK(reg(DEV_CONSOLE_TTY_IN_STATUS) & 0200);  // peek16 didn't take it
+    CHECK(reg(DEV_CONSOLE_TTY_IN_DATA) == 'x');
+    CHECK(!(reg(DEV_CONSOLE_TTY_IN_STATUS) & 0200));  // read16 did
+
+    // a byte of a register without byte handling is merged into the word
+    dd11::write16(IOPAGE(DEV_KER_INS_PAR_R0 + 2), 01234);
+    dd11::write8(IOPAGE(DEV_KER_INS_PAR_R0 + 2), 0377);
+    CHECK(reg(DEV_KER_INS_PAR_R0 + 2) == 01377);
+    dd11::write8(IOPAGE(DEV_KER_INS_PAR_R0 + 2) + 1, 0);
+    CHECK(reg(DEV_KER_INS_PAR_R0 + 2) == 0377);
+
+    // MOVB to either byte of the PS, from the processor
+    procNS::R[0] = 0;
+    const uint16_t high[] = {0110037, 0177777};  // MOVB R0, @#177777
+    CHECK(exec(high, 2, 1) == 0);
+    CHECK((reg(DEV_CPU_STAT) & 0177740) == 0340);
+    const uint16_t low[] = {0110037, 0177776};  // MOVB R0, @#177776
+    CHECK(exec(low, 2, 1) == 0);
+    CHECK((reg(DEV_CPU_STAT) & 0177740) == 0);
+
+    return done("test_dd11");
+}
@@ -0,0 +1,269 @@
+// The DH11 (dh11.cpp) on the host build's ptys (host/pty.cpp): a buffer at
+// any address, odd or not, goes out of its own line's pty with one interrupt,
+// a buffer running into non-existent memory stops at the word that didn't
+// answer, received characters wait in the silo tagged with their line until
+// there are more than the alarm level, and master clear resets the lot.
+
+#include "cpu.h"
+
+#include "dh11.h"
+#include "host.h"
+
+#include <Arduino.h>
+#include <fcntl.h>
+#include <termios.h>
+
+#if DL_TTYS
+#define VEC   (INTFLOAT + 010 * DL_LINES)  // after the DL11 lines', as dh11.cpp has them
+#define FIRST DL_LINES
+#else
+#define VEC   INTFLOAT
+#define FIRST 0
+#endif
+
+#define LINES 16
+#define BULK  20000  // bytes sent on a line in one go, several times the buffers
+
+enum
+{
+    SCR_RIE = 0100,
+    SCR_RI = 0200,
+    SCR_CNXM = 0400,
+    SCR_NXM = 02000,
+    SCR_MCLR = 04000,
+    SCR_SIE = 010000,
+    SCR_TIE = 020000,
+    SCR_TI = 0100000,
+};
+
+static int user[LINES];  // the other end of each line's pty
+
+static uint16_t reg(uint32_t a)
+{
+    return dd11::read16(IOPAGE(a));
+}
+
+static void set(uint32_t a, uint16_t v)
+{
+    dd11::write16(IOPAGE(a), v);
+}
+
+// poll the multiplexer until c is true, or a second's gone. idle() looks for
+// input every time, as it does while the PDP WAITs
+template <class T>
+static bool until(T c)
+{
+    const unsigned long end = millis() + 1000;
+    while (!c())
+    {
+        if (millis() > end)
+            return false;
+        dh11::poll();
+        dh11::idle();
+        usleep(10);
+    }
+    return true;
+}
+
+// read n bytes from a pty, waiting up to a second for them
+static int got(int fd, char* buf, int n)
+{
+    const unsigned long end = millis() + 1000;
+    int have = 0;
+    while (have < n && millis() < end)
+    {
+        const ssize_t r = read(fd, buf + have, n - have);
+        if (r > 0)
+            have += r;
+        else
+            usleep(100);
+    }
+    return have;
+}
+
+// is the interrupt at vec waiting to be taken
+static bool asking(uint16_t vec)
+{
+    for (uint8_t i = 0; i < ITABN; i++)
+    {
+        if (itab[i].vec == vec)
+            return true;
+    }
+    return false;
+}
+
+// a reset machine, with no interrupts waiting from the last case
+static void reboot()
+{
+    boot();
+    memset(itab, 0, sizeof(itab));
+}
+
+// bytes into ram at a, which can be odd
+static void put(uint32_t a, const char* s, uint16_t n)
+{
+    for (uint16_t i = 0; i < n; i++)
+        ms11::write8(a + i, (uint8_t)s[i]);
+}
+
+// start line t sending n bytes from a, an 18-bit UNIBUS address
+static void send(uint8_t t, uint32_t a, uint16_t n)
+{
+    set(DEV_DH_SCR, SCR_TIE | ((a >> 12) & 060) | t);
+    set(DEV_DH_CAR, a);
+    set(DEV_DH_BCR, -n);
+    set(DEV_DH_BAR, reg(DEV_DH_BAR) | 1 << t);
+}
+
+static uint8_t fill()
+{
+    return reg(DEV_DH_SSR) >> 8;
+}
+
+int main()
+{
+    boot();
+    dh11::begin();
+
+    for (uint8_t t = 0; t < LINES; t++)
+    {
+        const char* name = host::ptyname(FIRST + t);
+        CHECK(name);
+        user[t] = name ? open(name, O_RDWR | O_NOCTTY | O_NONBLOCK) : -1;
+        struct termios tio;
+        CHECK(user[t] >= 0 && !tcgetattr(user[t], &tio));
+        cfmakeraw(&tio);
+        tcsetattr(user[t], TCSANOW, &tio);
+    }
+
+    // a buffer at an odd address, with the parity bit dropped, and one
+    // interrupt at the end of it
+    {
+        put(010001, "\350ello, world", 12);
+        send(2, 010001, 12);
+        CHECK(!asking(VEC + 4));
+        CHECK(until([] { return !(reg(DEV_DH_BAR) & 1 << 2); }));
+        CHECK((reg(DEV_DH_SCR) & SCR_TI) && asking(VEC + 4));
+        CHECK(reg(DEV_DH_CAR) == 010015 && reg(DEV_DH_BCR) == 0);
+        char back[13];
+        CHECK(got(user[2], back, 13) == 12 && !memcmp(back, "hello, world", 12));
+        set(DEV_DH_SCR, 0);  // clear TI
+        CHECK(!(reg(DEV_DH_SCR) & SCR_TI));
+    }
+
+    // two lines at once, more than the buffers hold, each out of its own pty
+    {
+        static char sent[2][BULK], back[2][BULK];
+        for (uint8_t l = 0; l < 2; l++)
+        {
+            for (int i = 0; i < BULK; i++)
+                sent[l][i] = l ? 'a' + i % 26 : '0' + i % 10;
+            put(020000 + 050000 * l, sent[l], BULK);
+            send(5 + l, 020000 + 050000 * l, BULK);
+        }
+        int n[2] = {0, 0};
+        CHECK(until([&] {
+            for (uint8_t l = 0; l < 2; l++)
+            {
+                const ssize_t r = read(user[5 + l], back[l] + n[l], BULK - n[l]);
+                if (r > 0)
+                    n[l] += r;
+            }
+            return n[0] == BULK && n[1] == BULK;
+        }));
+        CHECK(!memcmp(sent, back, sizeof(sent)) && !reg(DEV_DH_BAR));
+    }
+
+    // non-existent memory: the bytes up to the word that didn't answer go,
+    // CAR is left at it, and NXM stays until it's cleared
+    reboot();
+    put(0757774, "abcd", 4);
+    send(3, 0757774, 8);
+    CHECK(until([] { return !reg(DEV_DH_BAR); }));
+    CHECK((reg(DEV_DH_SCR) & (SCR_NXM | SCR_TI)) == (SCR_NXM | SCR_TI) && asking(VEC + 4));
+    CHECK(reg(DEV_DH_CAR) == 0160000 && (reg(DEV_DH_SCR) & 060) == 060 && reg(DEV_DH_BCR) == (uint16_t)-4);
+    {
+        char back[5];
+        CHECK(got(user[3], back, 5) == 4 && !memcmp(back, "abcd", 4));
+    }
+    set(DEV_DH_SCR, 3);
+    CHECK(reg(DEV_DH_SCR) & SCR_NXM);
+    set(DEV_DH_SCR, SCR_CNXM | 3);
+    CHECK(!(reg(DEV_DH_SCR) & SCR_NXM));
+
+    // and from an odd address
+    send(3, 0757775, 8);
+    CHECK(until([] { return !reg(DEV_DH_BAR); }));
+    CHECK((reg(DEV_DH_SCR) & SCR_NXM) && reg(DEV_DH_CAR) == 0160000 && reg(DEV_DH_BCR) == (uint16_t)-5);
+    {
+        char back[4];
+        CHECK(got(user[3], back, 4) == 3 && !memcmp(back, "bcd", 3));
+    }
+
+    // received characters go into the silo tagged with their line, as many
+    // bits of them as LPR says
+    reboot();
+    set(DEV_DH_SCR, 7);
+    set(DEV_DH_LPR, 3);  // 8 bits
+    CHECK(write(user[7], "a\341", 2) == 2);
+    CHECK(until([] { return fill() == 2; }));
+    CHECK(write(user[8], "a", 1) == 1);  // 5 bits
+    CHECK(until([] { return fill() == 3; }));
+    CHECK(!asking(VEC));  // RIE isn't set
+
+    // a byte written to NRCR is merged without taking a character out
+    dd11::write8(IOPAGE(DEV_DH_NRCR), 0);
+    dd11::write8(IOPAGE(DEV_DH_NRCR) + 1, 0);
+    CHECK(fill() == 3);
+    CHECK(dh11::peek16(DEV_DH_NRCR) == (0100000 | 7 << 8 | 'a') && fill() == 3);
+
+    CHECK(reg(DEV_DH_NRCR) == (0100000 | 7 << 8 | 'a'));
+    CHECK(reg(DEV_DH_NRCR) == (0100000 | 7 << 8 | 0341));
+    CHECK(reg(DEV_DH_NRCR) == (0100000 | 8 << 8 | ('a' & 037)));
+    CHECK(reg(DEV_DH_NRCR) == 0 && fill() == 0);
+
+    // with the silo interrupt enabled, the interrupt only comes once there
+    // are more characters than the alarm level
+    reboot();
+    set(DEV_DH_SSR, 3);
+    set(DEV_DH_SCR, SCR_RIE | SCR_SIE | 9);
+    set(DEV_DH_LPR, 3);
+    CHECK(write(user[9], "xyz", 3) == 3);
+    CHECK(until([] { return fill() == 3; }));
+    for (uint16_t i = 0; i < 1000; i++)
+        dh11::poll();
+    CHECK(!(reg(DEV_DH_SCR) & SCR_RI) && !asking(VEC));
+    CHECK(write(user[9], "!", 1) == 1);
+    CHECK(until([] { return fill() == 4; }));
+    CHECK((reg(DEV_DH_SCR) & SCR_RI) && asking(VEC));
+    CHECK((reg(DEV_DH_SSR) & 077) == 3);
+
+    // and without it, as soon as there's anything
+    reboot();
+    set(DEV_DH_SCR, SCR_RIE | 9);
+    CHECK(write(user[9], "x", 1) == 1);
+    CHECK(until([] { return fill() == 1; }));
+    CHECK((reg(DEV_DH_SCR) & SCR_RI) && asking(VEC));
+
+    // master clear, with a character in the silo and a line about to send
+    put(030000, "lost", 4);
+    send(10, 030000, 4);
+    set(DEV_DH_SSR, 5);
+    set(DEV_DH_SCR, SCR_MCLR);
+    CHECK(reg(DEV_DH_SCR) == 0 && reg(DEV_DH_BAR) == 0 && reg(DEV_DH_SSR) == 0);
+    CHECK(reg(DEV_DH_NRCR) == 0);
+    set(DEV_DH_SCR, 10);
+    CHECK(reg(DEV_DH_CAR) == 0 && reg(DEV_DH_BCR) == 0);
+    for (uint16_t i = 0; i < 1000; i++)
+        dh11::poll();
+    {
+        char c;
+        CHECK(got(user[10], &c, 1) == 0);
+    }
+
+    // nothing left to do
+    CHECK(dh11::quiet() > 0);
+    CHECK(dh11::idle());
+
+    return done("test_dh11");
+}
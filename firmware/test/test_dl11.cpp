@@ -0,0 +1,193 @@
+// The DL11 lines (dl11.cpp) on the host build's ptys (host/pty.cpp): what the
+// PDP sends on a line comes out of that line's pty and no other, what's typed
+// at a pty turns up in that line's receiver in order, the interrupts come when
+// they're enabled, and the lines are quiet once there's nothing to do.
+
+#include "cpu.h"
+
+#include "dl11.h"
+#include "host.h"
+
+#include <Arduino.h>
+#include <fcntl.h>
+#include <termios.h>
+
+#define BULK 20000  // bytes sent each way in one go, several times the buffers
+
+enum
+{
+    RCSR = 0,
+    RBUF = 2,
+    XCSR = 4,
+    XBUF = 6
+};
+
+static int user[DL_LINES];  // the other end of each line's pty
+
+// line t's register r
+static uint32_t dl(uint8_t t, uint8_t r)
+{
+    return IOPAGE(DEV_DL_1_TTY_IN_STATUS + 010 * t + r);
+}
+
+static bool ready(uint8_t t, uint8_t r)
+{
+    return dd11::read16(dl(t, r)) & 0200;
+}
+
+// poll the lines until line t's register r has DONE set, or a second's gone.
+// idle() looks for input every time, as it does while the PDP WAITs
+static bool wait(uint8_t t, uint8_t r)
+{
+    const unsigned long end = millis() + 1000;
+    while (!ready(t, r))
+    {
+        if (millis() > end)
+            return false;
+        dl11::poll();
+        dl11::idle();
+        usleep(10);
+    }
+    return true;
+}
+
+// read n bytes from a pty, waiting up to a second for them
+static int got(int fd, char* buf, int n)
+{
+    const unsigned long end = millis() + 1000;
+    int have = 0;
+    while (have < n && millis() < end)
+    {
+        const ssize_t r = read(fd, buf + have, n - have);
+        if (r > 0)
+            have += r;
+        else
+            usleep(100);
+    }
+    return have;
+}
+
+// is the interrupt at vec waiting to be taken
+static bool asking(uint16_t vec)
+{
+    for (uint8_t i = 0; i < ITABN; i++)
+    {
+        if (itab[i].vec == vec)
+            return true;
+    }
+    return false;
+}
+
+// a reset machine, with no interrupts waiting from the last case
+static void reboot()
+{
+    boot();
+    memset(itab, 0, sizeof(itab));
+}
+
+int main()
+{
+    boot();
+    dl11::begin();
+
+    for (uint8_t t = 0; t < DL_LINES; t++)
+    {
+        const char* name = host::ptyname(t);
+        CHECK(name);
+        user[t] = name ? open(name, O_RDWR | O_NOCTTY | O_NONBLOCK) : -1;
+        struct termios tio;
+        CHECK(user[t] >= 0 && !tcgetattr(user[t], &tio));
+        cfmakeraw(&tio);
+        tcsetattr(user[t], TCSANOW, &tio);
+    }
+    CHECK(!host::ptyname(DL_LINES));  // only the DL11's ports are begun
+
+    // a character out of each line, and only that line
+    for (uint8_t t = 0; t < DL_LINES; t++)
+    {
+        dd11::write16(dl(t, XBUF), 'a' + t);
+        CHECK(!ready(t, XCSR));
+        CHECK(wait(t, XCSR));
+    }
+    for (uint8_t t = 0; t < DL_LINES; t++)
+    {
+        char c;
+        CHECK(got(user[t], &c, 1) == 1 && c == 'a' + t);
+        CHECK(read(user[t], &c, 1) < 0);
+    }
+
+    // a character in on line 2, and nowhere else
+    CHECK(write(user[2], "hi", 2) == 2);
+    CHECK(wait(2, RCSR));
+    CHECK(dd11::read16(dl(2, RBUF)) == 'h');
+    CHECK(!ready(2, RCSR));  // reading RBUF took it
+    CHECK(wait(2, RCSR));
+    CHECK(dl11::peek16(DEV_DL_1_TTY_IN_STATUS + 020 + RBUF) == 'i');
+    CHECK(ready(2, RCSR));  // peek16 didn't
+    CHECK(dd11::read16(dl(2, RBUF)) == 'i');
+    for (uint8_t t = 0; t < DL_LINES; t++)
+        CHECK(!ready(t, RCSR));
+
+    // the parity bit is dropped
+    const char parity = 0341;
+    CHECK(write(user[1], &parity, 1) == 1);
+    CHECK(wait(1, RCSR) && dd11::read16(dl(1, RBUF)) == 'a');
+
+    // the interrupts, when they're enabled
+    reboot();
+    dd11::write16(dl(3, XCSR), 0100);
+    dd11::write16(dl(3, XBUF), 'x');
+    CHECK(!asking(INTFLOAT + 010 * 3 + 4));
+    CHECK(wait(3, XCSR) && asking(INTFLOAT + 010 * 3 + 4));
+    dd11::write16(dl(0, RCSR), 0100);
+    CHECK(write(user[0], "y", 1) == 1);
+    CHECK(wait(0, RCSR) && asking(INTFLOAT));
+    CHECK(!asking(INTFLOAT + 010 * 1));
+    dd11::read16(dl(0, RBUF));
+    char c;
+    CHECK(got(user[3], &c, 1) == 1 && c == 'x');
+
+    // more out than the buffers hold, with the pty read in bursts
+    {
+        static char sent[BULK], back[BULK];
+        int n = 0;
+        bool ok = true;
+        for (int i = 0; i < BULK && ok; i++)
+        {
+            sent[i] = ' ' + i % 95;
+            dd11::write16(dl(1, XBUF), sent[i]);
+            ok = wait(1, XCSR);
+            if (i % 3000 == 2999)
+                n += got(user[1], back + n, i + 1 - n);
+        }
+        CHECK(ok);
+        n += got(user[1], back + n, BULK - n);
+        CHECK(n == BULK && !memcmp(sent, back, BULK));
+    }
+
+    // and a lot in, faster than the PDP reads it
+    {
+        static char sent[BULK], back[BULK];
+        for (int i = 0; i < BULK; i++)
+            sent[i] = ' ' + i % 95;
+        int in = 0, n = 0;
+        while (n < BULK)
+        {
+            const ssize_t w = in < BULK ? write(user[3], sent + in, BULK - in) : 0;
+            if (w > 0)
+                in += w;
+            if (!wait(3, RCSR))
+                break;
+            back[n++] = dd11::read16(dl(3, RBUF));
+        }
+        CHECK(n == BULK && !memcmp(sent, back, BULK));
+    }
+
+    // nothing left to do
+    for (uint16_t i = 0; i < 1000; i++)
+        dl11::poll();
+    CHECK(dl11::quiet() > 0);
+    CHECK(dl11::idle());
+
+    return done("test_dl11");
+}
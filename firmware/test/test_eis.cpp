@@ -0,0 +1,258 @@
+// KE11-E EIS instructions (MUL, DIV, ASH and ASHC, eis_shift() in
+// cpu_instr.cpp.h) against a reference written the long way round, after
+// simh's pdp11_cpu.c. Covers DIV by zero and overflow, shifts by every count
+// including +31 and -31/-32, odd register forms, and the sign boundaries.
+
+#include "cpu.h"
+
+enum
+{
+    N = 8,
+    Z = 4,
+    V = 2,
+    C = 1
+};
+
+struct regs {
+    uint16_t r[8];
+    uint8_t cc;
+};
+
+static int32_t sext16(uint16_t v)
+{
+    return (int16_t)v;
+}
+
+static void ref_mul(regs& m, uint8_t s, uint16_t src)
+{
+    const int32_t d = sext16(m.r[s]) * sext16(src);
+    m.r[s] = (d >> 16) & 0177777;
+    m.r[s | 1] = d & 0177777;
+    m.cc = (d < 0 ? N : 0) | (d == 0 ? Z : 0) | (d > 077777 || d < -0100000 ? C : 0);
+}
+
+static void ref_div(regs& m, uint8_t s, uint16_t src)
+{
+    const uint32_t dividend = ((uint32_t)m.r[s] << 16) | m.r[s | 1];
+    if (src == 0)
+    {
+        m.cc = V | C;
+        return;
+    }
+    if (dividend == 020000000000u && src == 0177777)
+    {
+        m.cc = V;
+        return;
+    }
+    // in magnitudes, then signed
+    const bool dneg = dividend >> 31, sneg = src >> 15;
+    const uint32_t a = dneg ? -dividend : dividend;
+    const uint32_t b = sneg ? (uint16_t)-src : src;
+    int64_t q = a / b, r = a % b;
+    if (dneg != sneg)
+        q = -q;
+    if (dneg)
+        r = -r;
+    if (q > 077777 || q < -0100000)
+    {
+        m.cc = V;
+        return;
+    }
+    m.r[s] = q & 0177777;
+    m.r[s | 1] = r & 0177777;
+    m.cc = (q < 0 ? N : 0) | (q == 0 ? Z : 0);
+}
+
+static void ref_ash(regs& m, uint8_t s, uint16_t src)
+{
+    const uint16_t n = src & 077;
+    const int sign = m.r[s] >> 15;
+    const int32_t v = sext16(m.r[s]);
+    int32_t d;
+    bool ov, c;
+    if (n == 0)
+    {
+        d = v;
+        ov = c = false;
+    }
+    else if (n <= 15)
+    {
+        d = v << n;
+        const int32_t out = (v >> (16 - n)) & 0177777;  // the bits shifted out, and the new sign
+        ov = out != ((d & 0100000) ? 0177777 : 0);
+        c = out & 1;
+    }
+    else if (n <= 31)
+    {
+        d = 0;
+        ov = v != 0;
+        c = (v << (n - 16)) & 1;
+    }
+    else if (n == 32)  // right 32
+    {
+        d = -sign;
+        ov = false;
+        c = sign;
+    }
+    else  // right 1 to 31
+    {
+        d = v >> (64 - n);
+        ov = false;
+        c = (v >> (63 - n)) & 1;
+    }
+    d &= 0177777;
+    m.r[s] = d;
+    m.cc = ((d & 0100000) ? N : 0) | (d == 0 ? Z : 0) | (ov ? V : 0) | (c ? C : 0);
+}
+
+static void ref_ashc(regs& m, uint8_t s, uint16_t src)
+{
+    const uint16_t n = src & 077;
+    const int64_t v = (int32_t)(((uint32_t)m.r[s] << 16) | m.r[s | 1]);
+    int64_t d;
+    bool ov, c;
+    if (n == 0)
+    {
+        d = v;
+        ov = c = false;
+    }
+    else if (n <= 31)
+    {
+        d = v << n;
+        const int64_t out = d >> 31;  // the bits shifted out, and the new sign
+        ov = out != 0 && out != -1;
+        c = (v >> (32 - n)) & 1;
+    }
+    else  // right 1 to 32
+    {
+        d = v >> (64 - n);
+        ov = false;
+        c = (v >> (63 - n)) & 1;
+    }
+    const uint32_t r = d & 0xFFFFFFFF;
+    m.r[s] = r >> 16;
+    m.r[s | 1] = r & 0177777;
+    m.cc = ((r & 0x80000000u) ? N : 0) | (r == 0 ? Z : 0) | (ov ? V : 0) | (c ? C : 0);
+}
+
+typedef void (*reference)(regs& m, uint8_t s, uint16_t src);
+
+static uint64_t seed = 88172645463325252ull;
+
+static uint16_t rnd()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+// instr is op R4,Rs: the operands are in Rs (and Rs|1) and R4
+static void check_eis(const char* name, uint16_t op, reference ref, uint8_t s, uint16_t hi, uint16_t lo,
+                      uint16_t src)
+{
+    regs want = {{0, 0, 0, 0, src, 0, 0, 0}, 0};
+    want.r[2] = s == 2 ? hi : 0;
+    want.r[3] = s == 3 ? hi : lo;
+    procNS::R[2] = want.r[2];
+    procNS::R[3] = want.r[3];
+    procNS::R[4] = src;
+    ref(want, s, src);
+
+    setcodes(017);
+    const uint16_t instr = op | (s << 6) | 4;
+    exec(&instr, 1, 1);
+    const uint8_t got = codes();
+
+    if (!CHECK(procNS::R[2] == want.r[2] && procNS::R[3] == want.r[3] && got == want.cc))
+    {
+        printf("  %s R%d=%06o %06o src %06o: %06o %06o cc %02o, want %06o %06o cc %02o\n", name, s, hi, lo, src,
+               (uint16_t)procNS::R[2], (uint16_t)procNS::R[3], got, want.r[2], want.r[3], want.cc);
+    }
+}
+
+// either side of the sign boundaries
+static const uint16_t edges[] = {
+    0000000, 0000001, 0000002, 0000377, 0000400, 0077776, 0077777, 0100000,
+    0100001, 0100002, 0177400, 0177776, 0177777, 0052525, 0125252,
+};
+#define EDGES (sizeof(edges) / sizeof(edges[0]))
+
+static const uint16_t counts[] = {037, 040, 041, 001, 077};  // +31, -32, -31, +1, -1
+static const int32_t quotients[] = {077777, 0100000, -0100000, -0100001, 0, 1, -1};
+
+int main()
+{
+    boot();
+
+    // MUL, every multiplicand against the edges and some random multipliers
+    for (uint8_t s = 2; s <= 3; s++)
+    {
+        for (uint32_t a = 0; a < 0200000; a++)
+        {
+            for (uint8_t i = 0; i < EDGES; i++)
+                check_eis("MUL", 070000, ref_mul, s, a, 0, edges[i]);
+            check_eis("MUL", 070000, ref_mul, s, a, 0, rnd());
+        }
+    }
+
+    // ASH by every count, of every value
+    for (uint8_t s = 2; s <= 3; s++)
+    {
+        for (uint32_t a = 0; a < 0200000; a++)
+        {
+            for (uint16_t n = 0; n < 64; n += (a & 0377) ? 7 : 1)
+                check_eis("ASH", 072000, ref_ash, s, a, 0, n | (rnd() & 0177700));
+        }
+    }
+    for (uint8_t i = 0; i < EDGES; i++)
+    {
+        for (uint16_t n : counts)
+            check_eis("ASH", 072000, ref_ash, 2, edges[i], 0, n);
+    }
+
+    // ASHC by every count, in both the even and odd (rotate the one word) forms
+    for (uint8_t s = 2; s <= 3; s++)
+    {
+        for (uint8_t i = 0; i < EDGES; i++)
+        {
+            for (uint8_t j = 0; j < EDGES; j++)
+            {
+                for (uint16_t n = 0; n < 64; n++)
+                    check_eis("ASHC", 073000, ref_ashc, s, edges[i], edges[j], n);
+            }
+        }
+        for (uint32_t k = 0; k < 1000000; k++)
+            check_eis("ASHC", 073000, ref_ashc, s, rnd(), rnd(), rnd());
+    }
+
+    // DIV: by zero, the one case that overflows 32 bits, quotients either
+    // side of the word limits, and random ones
+    for (uint8_t i = 0; i < EDGES; i++)
+    {
+        for (uint8_t j = 0; j < EDGES; j++)
+        {
+            for (uint8_t k = 0; k < EDGES; k++)
+                check_eis("DIV", 071000, ref_div, 2, edges[i], edges[j], edges[k]);
+        }
+    }
+    check_eis("DIV", 071000, ref_div, 2, 0100000, 0, 0177777);
+    for (int32_t q : quotients)
+    {
+        for (uint32_t k = 0; k < 20000; k++)
+        {
+            const int16_t d = rnd() | 1;
+            const int32_t r = (int32_t)(rnd() % (d < 0 ? -d : d)) * ((q < 0) ? -1 : 1);
+            const uint32_t dividend = (uint32_t)((int64_t)q * d + r);
+            check_eis("DIV", 071000, ref_div, 2, dividend >> 16, dividend & 0177777, d);
+        }
+    }
+    for (uint32_t k = 0; k < 2000000; k++)
+    {
+        const uint16_t d = rnd();
+        const uint16_t hi = (k & 1) ? rnd() : (uint16_t)(sext16(d) >> 15);  // half of them can fit
+        check_eis("DIV", 071000, ref_div, 2, hi, rnd(), (k % 3) ? d : (d & 0377) | ((d & 0200) ? 0177400 : 0));
+    }
+
+    return done("test_eis");
+}
@@ -0,0 +1,160 @@
+// KE11-F FIS instructions (FADD, FSUB, FMUL and FDIV, fis_get()/fis_put()/
+// fis_fail() in cpu_instr.cpp.h) against the same arithmetic done exactly in
+// integers (fis.h): every result bit exact, rounding half away from zero,
+// FSUB's signs, and the overflow, underflow and divide by zero traps, which
+// leave the stack as it was.
+
+#include "cpu.h"
+#include "fis.h"
+
+#define STACK (02000)  // R3, with B at (R3) and A at 4(R3)
+
+enum
+{
+    N = 8,
+    Z = 4,
+    V = 2,
+    C = 1
+};
+
+static const char* const names[] = {"FADD", "FSUB", "FMUL", "FDIV"};
+
+static long seen[4];  // of each fis:: status
+
+static uint64_t seed = 88172645463325252ull;
+
+static uint16_t rnd()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+static fis::result reference(uint8_t op, fis::num a, fis::num b)
+{
+    switch (op)
+    {
+    case 0:
+        return fis::add(a, b, false);
+    case 1:
+        return fis::add(a, b, true);
+    case 2:
+        return fis::mul(a, b);
+    default:
+        return fis::div(a, b);
+    }
+}
+
+// A op B, where op is 0 to 3 for FADD to FDIV
+static void check_fis(uint8_t op, fis::num a, fis::num b)
+{
+    const fis::result want = reference(op, a, b);
+    seen[want.status]++;
+
+    ms11::write16(STACK, b.hi);
+    ms11::write16(STACK + 2, b.lo);
+    ms11::write16(STACK + 4, a.hi);
+    ms11::write16(STACK + 6, a.lo);
+    procNS::R[3] = STACK;
+    setcodes(017);
+    const uint16_t instr = 075003 | (op << 3);
+    const uint16_t vec = exec(&instr, 1, 1);
+    const uint8_t got = codes();
+    const fis::num res = {ms11::read16(STACK + 4), ms11::read16(STACK + 6)};
+    const bool kept = ms11::read16(STACK) == b.hi && ms11::read16(STACK + 2) == b.lo;
+
+    bool ok;
+    uint8_t cc;
+    if (want.status == fis::OK)
+    {
+        cc = ((want.n.hi & 0100000) ? N : 0) | (want.n.hi ? 0 : Z);
+        ok = !vec && procNS::R[3] == STACK + 4 && res.hi == want.n.hi && res.lo == want.n.lo && got == cc;
+    }
+    else
+    {
+        static const uint8_t trapped[] = {0, V, N | V, N | V | C};
+        cc = trapped[want.status];
+        ok = vec == INTFPUERR && procNS::R[3] == STACK && res.hi == a.hi && res.lo == a.lo && got == cc;
+    }
+    if (!CHECK(ok && kept))
+    {
+        printf("  %s %06o %06o, %06o %06o: trap %03o R3 %06o %06o %06o cc %02o, want status %d %06o %06o cc %02o\n",
+               names[op], a.hi, a.lo, b.hi, b.lo, vec, (uint16_t)procNS::R[3], res.hi, res.lo, got, want.status,
+               want.n.hi, want.n.lo, cc);
+    }
+}
+
+// exponents at and either side of the ends and the middle, with fractions
+// at and either side of theirs
+static const uint16_t exps[] = {0, 1, 2, 3, 0177, 0200, 0201, 0375, 0376, 0377};
+static const uint32_t fracs[] = {0, 1, 2, 0100000, 0177777, 0200000, 07777777, 07777776, 04000000, 03777777};
+#define EXPS (sizeof(exps) / sizeof(exps[0]))
+#define FRACS (sizeof(fracs) / sizeof(fracs[0]))
+
+static fis::num make(bool neg, uint16_t exp, uint32_t frac)
+{
+    return {(uint16_t)((neg ? 0100000 : 0) | (exp << 7) | ((frac >> 16) & 0177)), (uint16_t)(frac & 0177777)};
+}
+
+// mostly any number, some of them near the ends of the exponent range or 0
+static fis::num any()
+{
+    const uint16_t r = rnd() & 0377;
+    uint16_t exp;
+    if (r < 12)
+        exp = 0;
+    else if (r < 40)
+        exp = exps[r % EXPS];
+    else
+        exp = rnd() & 0377;
+    static const uint16_t lows[] = {0, 0177777, 0100000};
+    const uint16_t lo = (r & 3) ? rnd() : lows[r % 3];
+    return make(rnd() & 1, exp, ((uint32_t)(rnd() & 0177) << 16) | lo);
+}
+
+int main()
+{
+    boot();
+
+    // every pair of the edges, either sign
+    for (uint8_t op = 0; op < 4; op++)
+    {
+        for (uint8_t i = 0; i < EXPS * FRACS * 2; i++)
+        {
+            for (uint8_t j = 0; j < EXPS * FRACS * 2; j++)
+            {
+                const fis::num a = make(i & 1, exps[(i >> 1) % EXPS], fracs[(i >> 1) / EXPS]);
+                const fis::num b = make(j & 1, exps[(j >> 1) % EXPS], fracs[(j >> 1) / EXPS]);
+                check_fis(op, a, b);
+            }
+        }
+    }
+
+    // FSUB's signs: A - A is +0, 0 - B is -B, and A - -A is 2A
+    for (uint32_t k = 0; k < 100000; k++)
+    {
+        const fis::num a = any();
+        const fis::num neg = {(uint16_t)(a.hi ^ 0100000), a.lo};
+        check_fis(1, a, a);
+        check_fis(1, {0, 0}, a);
+        check_fis(1, {0100000, 0}, a);
+        check_fis(1, a, neg);
+        check_fis(0, a, neg);
+    }
+
+    // random operands, a third with exponents close enough to cancel or tie
+    for (uint32_t k = 0; k < 2000000; k++)
+    {
+        const fis::num a = any();
+        fis::num b = any();
+        if (k % 3 == 0)
+            b.hi = (b.hi & 0100177) | (uint16_t)((a.hi + ((rnd() % 5) << 7) - (2 << 7)) & 077600);
+        check_fis(k & 3, a, b);
+    }
+
+    // and all of those reached each trap
+    CHECK(seen[fis::OVERFLOW] && seen[fis::UNDERFLOW] && seen[fis::DIVZERO]);
+
+    return done("test_fis");
+}
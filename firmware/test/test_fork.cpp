@@ -0,0 +1,224 @@
+// USE_FORK: a machine forked, and the fork cloned into machines on threads
+// of their own. Each clone starts with the registers, MMU, interrupts waiting,
+// memory and disk the machine had when it was forked, and none of them, or
+// the machine, sees what the others write afterwards, or writes to the card.
+// Memory and disk are only copied a page or block at a time, as written.
+
+#include "cpu.h"
+
+#include "host.h"
+#include "kt11.h"
+#include "rk11.h"
+
+#include <Arduino.h>
+#include <SdFat.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#define CLONES 3
+#define LOOPS  1000
+#define SUM    (02000)    // where each one's loop adds up, in the same page as CODE
+#define UPPER  (0200000)  // a page only the machine writes to
+#define BLOCK  (512)
+
+struct machine
+{
+    uint16_t k;
+    host::image* from;
+    pthread_t thread;
+
+    // what it found as it was cloned, after it wrote, and at the end
+    uint16_t r0, par, sum, high;
+    bool asking;
+    uint8_t blocks[3];
+    size_t cloned, wrote;
+    uint16_t sum2;
+    uint8_t block1;
+};
+
+static machine machines[CLONES + 2];
+static host::image* image;
+static pthread_barrier_t all;
+
+// the first byte of disk block n, as the calling thread's machine has it
+static uint8_t block(uint32_t n)
+{
+    rk11::rkdata[0].seekSet(n * BLOCK);
+    return rk11::rkdata[0].read();
+}
+
+static void fill(uint32_t n, uint8_t c)
+{
+    uint8_t buf[BLOCK];
+    memset(buf, c, sizeof(buf));
+    rk11::rkdata[0].seekSet(n * BLOCK);
+    rk11::rkdata[0].write(buf, sizeof(buf));
+}
+
+// the first byte of block n of the disk on the card
+static uint8_t card(uint32_t n)
+{
+    SdFile f;
+    f.open("rk0.dsk", O_READ);
+    f.seekSet(n * BLOCK);
+    const int c = f.read();
+    f.close();
+    return c;
+}
+
+static bool waiting(uint16_t vec)
+{
+    for (uint8_t i = 0; i < ITABN; i++)
+    {
+        if (itab[i].vec == vec)
+            return true;
+    }
+    return false;
+}
+
+// what each clone saw as it was cloned
+static void look(machine* me)
+{
+    me->r0 = procNS::R[0];
+    me->par = dd11::read16(IOPAGE(DEV_KER_INS_PAR_R0));
+    me->sum = ms11::read16(SUM);
+    me->high = ms11::read16(UPPER);
+    me->asking = waiting(INTFLOAT);
+    for (uint8_t n = 0; n < 3; n++)
+        me->blocks[n] = block(n);
+    me->cloned = host::footprint();
+}
+
+static void* run(void* p)
+{
+    machine* me = (machine*)p;
+    host::clone(me->from);
+    look(me);
+    pthread_barrier_wait(&all);
+
+    // a loop adding k up, a few instructions at a time so the threads take
+    // turns, and a disk block of its own
+    const uint16_t code[] = {012700, me->k, 012701, LOOPS, 060037, SUM, 077103};
+    for (uint8_t i = 0; i < sizeof(code) / 2; i++)
+        ms11::write16(CODE + 2 * i, code[i]);
+    ms11::write16(SUM, 0);
+    procNS::R[7] = CODE;
+    procNS::PS = 0340;
+    if (!setjmp(trapbuf))
+    {
+        for (uint32_t i = 0; i < 2 + 2 * LOOPS; i++)
+        {
+            procNS::step();
+            if (i % 16 == 0)
+                sched_yield();
+        }
+    }
+    fill(1, me->k);
+    me->wrote = host::footprint();
+    pthread_barrier_wait(&all);
+
+    me->sum2 = ms11::read16(SUM);
+    me->block1 = block(1);
+    host::scrap();
+    return 0;
+}
+
+// one that's cloned after the machine it was forked from has gone
+static void* late(void* p)
+{
+    machine* me = (machine*)p;
+    host::clone(me->from);
+    look(me);
+    host::scrap();
+    return 0;
+}
+
+int main()
+{
+    scratch();
+    {
+        SdFile f;
+        f.open("rk0.dsk", O_RDWR | O_CREAT | O_TRUNC);
+        f.close();
+    }
+
+    // the machine, with a disk that's written to before and after the fork
+    boot();
+    CHECK(rk11::rkdata[0].open("rk0.dsk", O_RDWR));
+    rk11::attached_drives[0] = true;
+    fill(0, 'A');
+    fill(1, 'B');
+    fill(2, 'C');
+    procNS::R[0] = 0123456;
+    dd11::write16(IOPAGE(DEV_KER_INS_PAR_R0), 07700);
+    procNS::interrupt(INTFLOAT, 4);
+    ms11::write16(SUM, 0111);
+    ms11::write16(UPPER, 0222);
+
+    image = host::fork();
+    CHECK(image);
+    CHECK(host::footprint() == 0);
+
+    // the machine carries on, with copies of what it writes
+    ms11::write16(SUM, 0333);
+    fill(0, 'P');
+    CHECK(host::footprint() == MS11_PAGE_SIZE + BLOCK);
+    CHECK(block(0) == 'P' && block(1) == 'B');
+    CHECK(card(0) == 'A' && card(1) == 'B' && card(2) == 'C');
+
+    pthread_barrier_init(&all, 0, CLONES);
+    for (uint16_t k = 0; k < CLONES; k++)
+    {
+        machines[k].k = k + 1;
+        machines[k].from = image;
+        CHECK(!pthread_create(&machines[k].thread, 0, run, &machines[k]));
+    }
+    for (uint16_t k = 0; k < CLONES; k++)
+        pthread_join(machines[k].thread, 0);
+
+    for (uint16_t k = 0; k < CLONES; k++)
+    {
+        const machine& m = machines[k];
+        if (!CHECK(m.r0 == 0123456 && m.par == 07700 && m.sum == 0111 && m.high == 0222 && m.asking))
+            printf("  clone %u: R0 %06o PAR0 %06o sum %06o high %06o\n", m.k, m.r0, m.par, m.sum, m.high);
+        CHECK(m.blocks[0] == 'A' && m.blocks[1] == 'B' && m.blocks[2] == 'C');
+
+        // nothing copied until it's written, and then only that page and block
+        CHECK(m.cloned == 0);
+        if (!CHECK(m.wrote == MS11_PAGE_SIZE + BLOCK))
+            printf("  clone %u: %zu bytes of its own\n", m.k, m.wrote);
+        CHECK(m.sum2 == (uint16_t)(m.k * LOOPS) && m.block1 == m.k);
+    }
+
+    // the machine is as it was, and the card as it was at the fork
+    CHECK(procNS::R[0] == 0123456 && ms11::read16(SUM) == 0333 && ms11::read16(UPPER) == 0222);
+    CHECK(block(0) == 'P' && block(1) == 'B');
+    CHECK(card(0) == 'A' && card(1) == 'B' && card(2) == 'C');
+
+    // a second fork shares the page and block the machine copied, which it
+    // copies again to write to
+    host::image* again = host::fork();
+    CHECK(again && host::footprint() == 0);
+    ms11::write16(SUM, 0444);
+    fill(0, 'Q');
+    CHECK(host::footprint() == MS11_PAGE_SIZE + BLOCK);
+
+    // and the forks keep what they share once the machine's gone
+    host::scrap();
+    for (uint16_t k = CLONES; k < CLONES + 2; k++)
+    {
+        machine& m = machines[k];
+        m.from = k == CLONES ? image : again;
+        CHECK(!pthread_create(&m.thread, 0, late, &m));
+        pthread_join(m.thread, 0);
+    }
+    const machine &first = machines[CLONES], &second = machines[CLONES + 1];
+    CHECK(first.r0 == 0123456 && first.sum == 0111 && first.high == 0222 && first.blocks[0] == 'A');
+    CHECK(second.r0 == 0123456 && second.sum == 0333 && second.high == 0222 && second.blocks[0] == 'P');
+    CHECK(second.blocks[1] == 'B' && second.cloned == 0);
+    host::drop(image);
+    host::drop(again);
+
+    return done("test_fork");
+}
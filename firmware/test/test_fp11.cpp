@@ -0,0 +1,504 @@
+// FP11 floating point (fp11.cpp) against the same arithmetic done exactly in
+// integers: every result bit exact in F and D modes, rounded and truncated
+// (FT), with the overflow, underflow, divide by zero, conversion and -0
+// (FIUV) errors, trapping or not (FID). Random operands, weighted towards
+// the ends of the exponent range, short and all ones fractions, and equal
+// ones, through ADDF, SUBF, MULF, DIVF, MODF, CMPF, LDF, TSTF, NEGF, LDCIF,
+// STCFI, STEXP, LDEXP, STCFD and LDCDF.
+
+#include "cpu.h"
+
+#include "fp11.h"
+
+#define DATA (02000)  // R1, for the operands in memory
+
+using namespace fp11;
+
+typedef unsigned __int128 u128;
+
+static const uint64_t M55 = (1ull << 55) - 1;
+static const uint64_t FMASK = 0xFFFFFFFF00000000ull;  // the F format part
+
+// a value of mag * 2^exp
+struct exact {
+    bool neg;
+    int32_t exp;
+    u128 mag;
+};
+
+static int bitlen(u128 m)
+{
+    int n = 0;
+    for (; m; m >>= 1)
+        n++;
+    return n;
+}
+
+static exact val(uint64_t v)
+{
+    const int32_t e = (v >> 55) & 0377;
+    if (!e)
+        return {false, 0, 0};  // anything with a 0 exponent is 0
+    return {(v >> 63) != 0, e - 0200 - 56, (v & M55) | (1ull << 55)};
+}
+
+static exact integer(int64_t i)
+{
+    return {i < 0, 0, (u128)(i < 0 ? -i : i)};
+}
+
+// 2^(e - 1) <= |x| < 2^e
+static int32_t expof(exact x)
+{
+    return bitlen(x.mag) + x.exp;
+}
+
+// errors, as pack() finds them
+struct errors {
+    bool v;
+    uint8_t pending;  // FEC to trap with, if any
+};
+
+// x to p bits of fraction, rounded or truncated as the FPS says, and packed
+static uint64_t pack(exact x, int p, uint16_t fps, errors& st)
+{
+    if (!x.mag)
+        return 0;
+    int32_t e = expof(x);
+    const int s = bitlen(x.mag) - p;
+    u128 m;
+    if (s > 0)
+        m = (fps & FT) ? x.mag >> s : (x.mag + ((u128)1 << (s - 1))) >> s;
+    else
+        m = x.mag << -s;
+    if (m == (u128)1 << p)
+    {
+        m >>= 1;
+        e++;
+    }
+    const int32_t E = e + 0200;
+    if (E > 0377)
+    {
+        st.v = true;
+        if (!(fps & FIV))
+            return 0;
+        st.pending = ERROVER;
+    }
+    else if (E <= 0)
+    {
+        if (!(fps & FIU))
+            return 0;
+        st.pending = ERRUNDER;
+    }
+    const uint64_t frac = (uint64_t)(m << (56 - p)) & M55;
+    return ((uint64_t)x.neg << 63) | ((uint64_t)(E & 0377) << 55) | frac;
+}
+
+// x + y, for values with 56 bit fractions. Past 64 bits apart the smaller one is kept as a single bit below the
+// larger, which rounds and truncates as it would whole
+static exact add(exact x, exact y)
+{
+    if (!y.mag)
+        return x;
+    if (!x.mag)
+        return y;
+    if (expof(x) < expof(y))
+    {
+        const exact t = x;
+        x = y;
+        y = t;
+    }
+    const int32_t d = x.exp - y.exp;
+    const u128 xf = x.mag << 64;
+    const u128 yf = d <= 64 ? y.mag << (64 - d) : 1;
+    if (x.neg == y.neg)
+        return {x.neg, x.exp - 64, xf + yf};
+    if (xf >= yf)
+        return {x.neg, x.exp - 64, xf - yf};
+    return {y.neg, x.exp - 64, yf - xf};
+}
+
+static exact negate(exact x)
+{
+    x.neg = !x.neg;
+    return x;
+}
+
+static exact mul(exact x, exact y)
+{
+    if (!x.mag || !y.mag)
+        return {false, 0, 0};
+    return {x.neg != y.neg, x.exp + y.exp, x.mag * y.mag};
+}
+
+// x / y, with the quotient cut to 64 bits or so: rounding and truncating
+// boundaries are whole numbers of those, so it goes the same way
+static exact quo(exact x, exact y)
+{
+    if (!x.mag)
+        return {false, 0, 0};
+    return {x.neg != y.neg, x.exp - y.exp - 64, (x.mag << 64) / y.mag};
+}
+
+// cut to 64 bits, as MODF keeps its product
+static exact trunc64(exact x)
+{
+    const int s = bitlen(x.mag) - 64;
+    if (s > 0)
+    {
+        x.mag >>= s;
+        x.exp += s;
+    }
+    return x;
+}
+
+// the whole part, towards zero
+static exact whole(exact x)
+{
+    if (x.exp >= 0)
+        return x;
+    if (-x.exp >= 128)
+        return {false, 0, 0};
+    x.mag = (x.mag >> -x.exp) << -x.exp;
+    return x;
+}
+
+static int sign(exact x)
+{
+    return x.mag ? (x.neg ? -1 : 1) : 0;
+}
+
+static uint8_t cc(uint64_t v)
+{
+    return ((v >> 63) ? FN : 0) | (((v >> 55) & 0377) ? 0 : FZ);
+}
+
+static uint64_t setac(uint64_t old, uint8_t len, uint64_t v)
+{
+    return len == 8 ? v : (old & 0xFFFFFFFF) | (v & FMASK);
+}
+
+// the machine after an instruction
+struct state {
+    uint64_t ac0, ac1, mem;
+    uint16_t fps;
+    uint8_t fec;
+    bool trap;
+};
+
+// what the handbook says op does, from AC0 = a0, AC1 and the four words at
+// DATA both a1, and FPS fps
+static state model(uint16_t op, uint16_t fps, uint64_t a0, uint64_t a1)
+{
+    const uint8_t len = (fps & FD) ? 8 : 4;
+    const int p = len == 8 ? 56 : 24;
+    const uint64_t mask = len == 8 ? ~0ull : FMASK;
+    const uint16_t kind = op & 07400;
+    const exact x = val(a0 & mask), y = val(a1 & mask);
+    errors st = {false, 0};
+    state w = {a0, a1, a1, (uint16_t)(fps & ~017), 0, false};
+
+    // -0 as a source
+    const uint64_t smask = kind == 07400 ? (len == 4 ? ~0ull : FMASK) : mask;
+    const bool uv = (fps & FIUV) && ((a1 & smask) >> 63) && !((a1 >> 55) & 0377);
+    const bool fsrc = kind == 01000 || kind == 02000 || kind == 03000 || kind == 04400 || kind == 01400 ||
+                      kind == 03400 || kind == 02400 || kind == 07400 || (kind == 0400 && (op & 0300));
+    if (fsrc && uv)
+    {
+        w.fec = ERRUNDEF;
+        if (!(fps & FID))
+        {
+            w.fps = fps | FER;
+            w.trap = true;
+            return w;
+        }
+        w.fps = (fps | FER) & ~017;
+    }
+
+    switch (kind)
+    {
+    case 01000:  // MULF
+    case 02000:  // ADDF
+    case 03000:  // SUBF
+    case 04400:  // DIVF
+        if (kind == 04400 && !y.mag)
+        {
+            w.fps = fps | FER;
+            w.fec = ERRDIV;
+            w.trap = !(fps & FID);
+        }
+        else
+        {
+            const exact r = kind == 01000 ? mul(x, y) : kind == 02000 ? add(x, y) : kind == 03000 ? add(x, negate(y))
+                                                                                                   : quo(x, y);
+            const uint64_t v = pack(r, p, fps, st);
+            w.ac0 = setac(a0, len, v);
+            w.fps |= cc(v) | (st.v ? FV : 0);
+        }
+        break;
+    case 01400:  // MODF, the whole part to AC1 and the fraction to AC0
+    {
+        const exact prod = trunc64(mul(x, y));
+        const int32_t n = prod.mag ? expof(prod) : 0;
+        exact i, f;
+        if (!prod.mag || n <= 0)
+        {
+            i = {false, 0, 0};
+            f = prod;
+        }
+        else if (n >= p)
+        {
+            i = prod;
+            f = {false, 0, 0};
+        }
+        else
+        {
+            i = whole(prod);
+            f = {prod.neg, prod.exp, prod.mag - i.mag};
+        }
+        const uint64_t vi = pack(i, p, fps, st), vf = pack(f, p, fps, st);
+        w.ac1 = setac(a1, len, vi);
+        w.ac0 = setac(a0, len, vf);
+        w.fps |= cc(vf) | (st.v ? FV : 0);
+        break;
+    }
+    case 03400:  // CMPF
+    {
+        const int s = sign(add(y, negate(x)));
+        w.fps |= (s < 0 ? FN : 0) | (s == 0 ? FZ : 0);
+        break;
+    }
+    case 07000:  // LDCIF
+    {
+        const int64_t i = (fps & FL) ? (int64_t)(int32_t)(a1 >> 32) : (int64_t)(int16_t)(a1 >> 48);
+        const uint64_t v = pack(integer(i), p, fps, st);
+        w.ac0 = setac(a0, len, v);
+        w.fps |= cc(v);
+        break;
+    }
+    case 05400:  // STCFI
+    {
+        const int bits = (fps & FL) ? 32 : 16;
+        const exact t = whole(x);
+        int64_t i = 0;
+        bool err = expof(t) > bits;
+        if (!err && t.mag)
+        {
+            i = (int64_t)(t.exp < 0 ? t.mag >> -t.exp : t.mag << t.exp);
+            i = t.neg ? -i : i;
+            err = i < -(1ll << (bits - 1)) || i >= (1ll << (bits - 1));
+        }
+        if (err)
+        {
+            i = 0;
+            if (fps & FIC)
+                st.pending = ERRCONV;
+        }
+        const uint64_t u = (uint64_t)i & ((1ull << bits) - 1);
+        w.mem = bits == 32 ? (u << 32) | (a1 & 0xFFFFFFFF) : (u << 48) | (a1 & 0xFFFFFFFFFFFF);
+        w.fps |= (i < 0 ? FN : 0) | (i == 0 ? FZ : 0) | (err ? FC : 0);
+        break;
+    }
+    case 05000:  // STEXP
+    {
+        const int16_t ex = (int16_t)((a0 >> 55) & 0377) - 0200;
+        w.mem = (a1 & 0xFFFFFFFFFFFF) | ((uint64_t)(uint16_t)ex << 48);
+        w.fps |= (ex < 0 ? FN : 0) | (ex == 0 ? FZ : 0);
+        break;
+    }
+    case 06000:  // STCFD, to the other precision
+    {
+        const uint8_t olen = 12 - len;
+        const uint64_t v = pack(x, olen == 8 ? 56 : 24, fps, st);
+        w.mem = olen == 8 ? v : (a1 & 0xFFFFFFFF) | (v & FMASK);
+        w.fps |= cc(v) | (st.v ? FV : 0);
+        break;
+    }
+    case 07400:  // LDCDF, from the other precision
+    {
+        const uint64_t v = pack(val(a1 & (len == 4 ? ~0ull : FMASK)), p, fps, st);
+        w.ac0 = setac(a0, len, v);
+        w.fps |= cc(v) | (st.v ? FV : 0);
+        break;
+    }
+    case 06400:  // LDEXP
+    {
+        const int32_t E = (int16_t)(a1 >> 48) + 0200;
+        const uint64_t f = (a0 & mask) & M55;
+        const uint64_t s = a0 >> 63;
+        uint64_t v = (s << 63) | ((uint64_t)(E & 0377) << 55) | f;
+        if (E > 0377)
+        {
+            st.v = true;
+            if (fps & FIV)
+                st.pending = ERROVER;
+            else
+                v = 0;
+        }
+        else if (E <= 0)
+        {
+            if (fps & FIU)
+                st.pending = ERRUNDER;
+            else
+                v = 0;
+        }
+        v &= mask;
+        w.ac0 = setac(a0, len, v);
+        w.fps |= cc(v) | (st.v ? FV : 0);
+        break;
+    }
+    case 0400:  // TSTF and NEGF
+    {
+        uint64_t v = a1 & mask;
+        if ((op & 0300) == 0300)
+        {
+            v = ((v >> 55) & 0377) ? v ^ (1ull << 63) : 0;
+            w.mem = len == 8 ? v : (a1 & 0xFFFFFFFF) | v;
+        }
+        w.fps |= cc(v);
+        break;
+    }
+    case 02400:  // LDF
+    {
+        const uint64_t v = a1 & mask;
+        w.ac0 = setac(a0, len, v);
+        w.fps |= cc(v);
+        break;
+    }
+    }
+
+    if (st.pending)
+    {
+        w.fps |= FER;
+        w.fec = st.pending;
+        w.trap = !(fps & FID);
+    }
+    return w;
+}
+
+static uint64_t seed = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rnd()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+// mostly middling exponents, some at the ends and some 0
+static uint64_t any(bool dbl)
+{
+    uint64_t v = rnd();
+    int e;
+    switch (rnd() % 8)
+    {
+    case 0:
+        e = 1 + rnd() % 4;
+        break;
+    case 1:
+        e = 0374 + rnd() % 4;
+        break;
+    case 2:
+        e = 0;
+        break;
+    default:
+        e = 0144 + rnd() % 070;
+        break;
+    }
+    if (rnd() % 6 == 0)
+        v &= ~0xFFFFFFull;  // short fractions
+    if (rnd() % 10 == 0)
+        v |= 0x7FFFFFFFFFull;
+    v = (v & ~(0377ull << 55)) | ((uint64_t)e << 55);
+    return dbl ? v : v & FMASK;
+}
+
+// with AC 0 as the destination, and AC 1 or the words at (R1) as the source
+static const uint16_t ops[] = {
+    0172001,  // ADDF AC1,AC0
+    0173001,  // SUBF AC1,AC0
+    0171001,  // MULF AC1,AC0
+    0174401,  // DIVF AC1,AC0
+    0171401,  // MODF AC1,AC0
+    0173401,  // CMPF AC1,AC0
+    0172401,  // LDF AC1,AC0
+    0170511,  // TSTF (R1)
+    0170711,  // NEGF (R1)
+    0177011,  // LDCIF (R1),AC0
+    0175411,  // STCFI AC0,(R1)
+    0175011,  // STEXP AC0,(R1)
+    0176411,  // LDEXP (R1),AC0
+    0176011,  // STCFD AC0,(R1)
+    0177411,  // LDCDF (R1),AC0
+};
+#define OPS (sizeof(ops) / sizeof(ops[0]))
+
+static void check_fp(uint16_t op, uint16_t fps, uint64_t a0, uint64_t a1)
+{
+    const state want = model(op, fps, a0, a1);
+
+    FPS = fps;
+    FEC = 0;
+    AC[0] = a0;
+    AC[1] = a1;
+    for (uint8_t k = 0; k < 4; k++)
+    {
+        ms11::write16(DATA + 2 * k, a1 >> (48 - 16 * k));
+        ms11::write16(DATA + 8 + 2 * k, 0);
+    }
+    procNS::R[1] = DATA;
+    const uint16_t vec = exec(&op, 1, 1);
+    uint64_t mem = 0;
+    for (uint8_t k = 0; k < 4; k++)
+        mem = (mem << 16) | ms11::read16(DATA + 2 * k);
+
+    if (!CHECK(AC[0] == want.ac0 && AC[1] == want.ac1 && mem == want.mem && FPS == want.fps && FEC == want.fec &&
+               (vec == INTFPUERR) == want.trap && (!vec || want.trap)))
+    {
+        printf("  %06o FPS %06o AC0 %016llx AC1 %016llx:\n"
+               "    AC0 %016llx AC1 %016llx mem %016llx FPS %06o FEC %02o trap %03o\n"
+               "    want  %016llx     %016llx     %016llx     %06o     %02o      %d\n",
+               op, fps, (unsigned long long)a0, (unsigned long long)a1, (unsigned long long)AC[0],
+               (unsigned long long)AC[1], (unsigned long long)mem, FPS, FEC, vec, (unsigned long long)want.ac0,
+               (unsigned long long)want.ac1, (unsigned long long)want.mem, want.fps, want.fec, want.trap);
+    }
+}
+
+int main()
+{
+    boot();
+
+    for (uint32_t i = 0; i < 1000000; i++)
+    {
+        const uint16_t op = ops[rnd() % OPS];
+        uint16_t fps = rnd() & (FD | FL | FT);
+        if (rnd() % 4 == 0)
+            fps |= ((rnd() % 2) ? FID : 0) | (rnd() & (FIUV | FIU | FIV | FIC));
+        const bool dbl = fps & FD;
+        const uint64_t a0 = any(true);
+        uint64_t a1 = any(dbl);
+        switch (op & 07400)
+        {
+        case 03400:  // CMPF, equal a third of the time
+            if (rnd() % 3 == 0)
+                a1 = a0;
+            break;
+        case 06400:  // LDEXP, either side of the exponent range
+            a1 = (uint64_t)(int64_t)(int16_t)((rnd() % 600) - 300) << 48;
+            break;
+        case 07000:  // LDCIF, any integer or a short one
+            a1 = rnd();
+            if (rnd() % 2)
+                a1 = (uint64_t)(int64_t)(int32_t)(a1 >> 40) << 32;
+            a1 &= FMASK;
+            break;
+        case 07400:  // LDCDF, from the other precision
+            a1 = any(!dbl);
+            break;
+        }
+        check_fp(op, fps, a0, a1);
+    }
+
+    return done("test_fp11");
+}
@@ -0,0 +1,178 @@
+// The threaded core's fused pairs (FUSED_OPS, from cpu_fused.h): each pair
+// run by run() with both instructions already in the decode cache, so that
+// the fused op runs the second itself, against the same two run one step()
+// at a time, with random registers, codes and stack. Also checks the pair
+// really was fused, by its op in the decode cache.
+
+#include "cpu.h"
+
+#include "cpu/cpu_fused.h"
+
+#include <string.h>
+
+#define STACK (0700)  // R6, with room either side for pushes and pops
+
+// an instruction for each op, on registers where it takes any, and with
+// (R1) where it needs an address
+struct op {
+    const char* name;
+    uint16_t instr;
+};
+
+static const op ops[] = {
+    {"MOV", 0010102},  {"CMP", 0020102},  {"BIT", 0030102},  {"BIC", 0040102},  {"BIS", 0050102},
+    {"ADD", 0060102},  {"SUB", 0160102},  {"MUL", 0070201},  {"DIV", 0071201},  {"ASH", 0072201},
+    {"ASHC", 0073201}, {"XOR", 0074102},  {"CLR", 0005002},  {"COM", 0005102},  {"INC", 0005202},
+    {"_DEC", 0005302}, {"NEG", 0005402},  {"_ADC", 0005502}, {"SBC", 0005602},  {"TST", 0005702},
+    {"ROR", 0006002},  {"ROL", 0006102},  {"ASR", 0006202},  {"ASL", 0006302},  {"SWAB", 0000302},
+    {"SXT", 0006702},  {"CCOP", 0000261}, {"NOP", 0000240},  {"MFPI", 0006501}, {"MTPI", 0006601},
+    {"MFPD", 0106501}, {"MTPD", 0106601}, {"BR", 0000401},   {"BNE", 0001001},  {"BEQ", 0001401},
+    {"BGE", 0002001},  {"BLT", 0002401},  {"BGT", 0003001},  {"BLE", 0003401},  {"BPL", 0100001},
+    {"BMI", 0100401},  {"BHI", 0101001},  {"BLOS", 0101401}, {"BVC", 0102001},  {"BVS", 0102401},
+    {"BCC", 0103001},  {"BCS", 0103401},  {"SOB", 0077201},  {"JMP", 0000111},  {"JSR", 0004711},
+    {"RTS", 0000207},  {"MARK", 0006400}, {"EMTX", 0104000}, {"RTT", 0000006},  {"SPL", 0000230},
+};
+
+#define PAIR(first, second) {#first, #second},
+static const char* const pairs[][2] = {FUSED_OPS(PAIR)};
+#undef PAIR
+
+static bool encode(const char* name, uint16_t& instr)
+{
+    for (const op& o : ops)
+    {
+        if (!strcmp(o.name, name))
+        {
+            instr = o.instr;
+            return true;
+        }
+    }
+    printf("  no instruction for %s, add one to ops[]\n", name);
+    return false;
+}
+
+// what the two instructions leave behind
+struct machine {
+    uint16_t r[8];
+    uint16_t ps;
+    uint16_t stack[16];
+    uint16_t vec;
+};
+
+static uint64_t seed = 88172645463325252ull;
+
+static uint16_t rnd()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+static machine start;
+
+// the state in start, without touching the code, so what's in the decode
+// cache stays there
+static void setup()
+{
+    procNS::flags();
+    procNS::PS = 0340 | (start.ps & 017);
+    for (uint8_t i = 0; i < 6; i++)
+        procNS::R[i] = start.r[i];
+    procNS::R[6] = STACK;
+    for (uint8_t i = 0; i < 16; i++)
+        ms11::write16(STACK - 16 + 2 * i, start.stack[i]);
+}
+
+static machine finish(uint16_t vec)
+{
+    machine m;
+    for (uint8_t i = 0; i < 8; i++)
+        m.r[i] = procNS::R[i];
+    m.ps = (procNS::flags(), procNS::PS);
+    for (uint8_t i = 0; i < 16; i++)
+        m.stack[i] = ms11::read16(STACK - 16 + 2 * i);
+    m.vec = vec;
+    return m;
+}
+
+// the two, one step() at a time
+static machine stepped(const uint16_t* code)
+{
+    setup();
+    for (uint8_t i = 0; i < 2; i++)
+        ms11::write16(CODE + 2 * i, code[i]);
+    procNS::R[7] = CODE;
+    const uint16_t vec = setjmp(trapbuf);
+    if (!vec)
+    {
+        procNS::step();
+        procNS::step();
+    }
+    return finish(vec);
+}
+
+// the two, by run(), the second time through
+static machine threaded(const uint16_t* code)
+{
+    setup();
+    exec(code, 2, 2);
+    setup();
+    procNS::R[7] = CODE;
+    const uint16_t vec = setjmp(trapbuf);
+    if (!vec)
+        procNS::run(2);
+    return finish(vec);
+}
+
+static uint8_t cached_op()
+{
+    return procNS::dcache[(CODE >> 1) & (DECODE_CACHE - 1)].op;
+}
+
+int main()
+{
+    boot();
+
+    for (const auto& p : pairs)
+    {
+        uint16_t code[2];
+        if (!CHECK(encode(p[0], code[0]) && encode(p[1], code[1])))
+            continue;
+
+        for (uint32_t k = 0; k < 20000; k++)
+        {
+            for (uint8_t i = 0; i < 6; i++)
+                start.r[i] = rnd();
+            if (k & 1)
+                start.r[1] &= 0177776;  // a word address for JMP and JSR
+            start.ps = rnd() & 017;
+            for (uint8_t i = 0; i < 16; i++)
+                start.stack[i] = rnd();
+
+            const machine want = stepped(code);
+            const machine got = threaded(code);
+            if (!CHECK(!memcmp(&got, &want, sizeof(got))))
+            {
+                printf("  %s; %s R0-5 %06o %06o %06o %06o %06o %06o cc %02o:\n", p[0], p[1], start.r[0], start.r[1],
+                       start.r[2], start.r[3], start.r[4], start.r[5], start.ps);
+                printf("    R0-7 %06o %06o %06o %06o %06o %06o %06o %06o PS %06o trap %03o\n", got.r[0], got.r[1],
+                       got.r[2], got.r[3], got.r[4], got.r[5], got.r[6], got.r[7], got.ps, got.vec);
+                printf("    want %06o %06o %06o %06o %06o %06o %06o %06o    %06o      %03o\n", want.r[0], want.r[1],
+                       want.r[2], want.r[3], want.r[4], want.r[5], want.r[6], want.r[7], want.ps, want.vec);
+            }
+        }
+
+        // fused, as the first followed by a HALT isn't
+        start = machine();
+        threaded(code);
+        const uint8_t fused = cached_op();
+        const uint16_t alone[] = {code[0], 0000000};
+        setup();
+        exec(alone, 2, 1);
+        if (!CHECK(fused != cached_op()))
+            printf("  %s; %s wasn't fused\n", p[0], p[1]);
+    }
+
+    return done("test_fused");
+}
@@ -0,0 +1,166 @@
+// MULTI_MACHINE: machines on threads of their own in one process, each with
+// its own registers, memory, MMU, condition codes, interrupts waiting, traps,
+// console and card (host.h), and none of them seeing another's or the main
+// thread's, however their instructions are interleaved.
+
+#include "cpu.h"
+
+#include "host.h"
+#include "kt11.h"
+
+#include <Arduino.h>
+#include <SdFat.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+
+#define MACHINES 4
+#define LOOPS    1000
+#define SUM      (02000)  // where each one's loop adds up
+
+struct machine
+{
+    uint16_t k;  // what this one's loop adds, 1 up
+    pthread_t thread;
+    char dir[64];  // its card
+    char out[8];   // its console output
+    uint8_t outn;
+
+    // what it found at the end
+    uint16_t sum, r0, par, vec;
+    uint8_t codes;
+    bool asking, others, card;
+};
+
+static machine machines[MACHINES];
+
+// an ADD for each that leaves Z, N, Z and C, or N and V waiting to be worked out
+static const uint16_t adds[MACHINES][2] = {{0, 0}, {0100000, 0}, {0177777, 1}, {077777, 1}};
+static const uint8_t added[MACHINES] = {04, 010, 05, 012};
+
+static pthread_barrier_t all;
+static PERMACHINE machine* me;
+
+static void put(uint8_t c)
+{
+    if (me->outn < sizeof(me->out) - 1)
+        me->out[me->outn++] = c;
+}
+
+// the interrupts waiting: is vec one of them, and are there any others
+static void waiting(uint16_t vec, bool& asking, bool& others)
+{
+    asking = others = false;
+    for (uint8_t i = 0; i < ITABN; i++)
+    {
+        if (itab[i].vec == vec)
+            asking = true;
+        else if (itab[i].vec)
+            others = true;
+    }
+}
+
+static void* run(void* p)
+{
+    me = (machine*)p;
+    host::card(me->dir);
+    host::console(put);
+
+    // the same registers and addresses in each, with values of their own
+    boot();
+    dd11::write16(IOPAGE(DEV_KER_INS_PAR_R0), 0100 * me->k);
+    procNS::interrupt(INTFLOAT + 4 * me->k, 4);
+    Serial.print((char)('a' + me->k));
+    {
+        SdFile f;
+        f.open("card", O_RDWR | O_CREAT | O_TRUNC);
+        f.write((uint8_t)me->k);
+        f.close();
+    }
+    pthread_barrier_wait(&all);
+
+    // a loop adding k up in memory, a few instructions at a time so the
+    // threads take turns
+    const uint16_t code[] = {012700, me->k, 012701, LOOPS, 060037, SUM, 077103};
+    for (uint8_t i = 0; i < sizeof(code) / 2; i++)
+        ms11::write16(CODE + 2 * i, code[i]);
+    ms11::write16(SUM, 0);
+    procNS::R[7] = CODE;
+    if (!setjmp(trapbuf))
+    {
+        for (uint32_t i = 0; i < 2 + 2 * LOOPS; i++)
+        {
+            procNS::step();
+            if (i % 16 == 0)
+                sched_yield();
+        }
+    }
+    pthread_barrier_wait(&all);
+
+    // the condition codes from the last instruction, not worked out until
+    // the others have all run theirs
+    procNS::R[3] = adds[me->k - 1][0];
+    procNS::R[4] = adds[me->k - 1][1];
+    const uint16_t add[] = {060304};  // ADD R3,R4
+    exec(add, 1, 1);
+    pthread_barrier_wait(&all);
+    me->codes = codes();
+
+    // all of them trapping at once, each back to its own setjmp
+    const uint16_t odd[] = {013702, 1};  // MOV @#1,R2
+    me->vec = exec(odd, 2, 1);
+
+    me->sum = ms11::read16(SUM);
+    me->r0 = procNS::R[0];
+    me->par = dd11::read16(IOPAGE(DEV_KER_INS_PAR_R0));
+    waiting(INTFLOAT + 4 * me->k, me->asking, me->others);
+    {
+        SdFile f;
+        me->card = f.open("card", O_RDONLY) && f.read() == me->k;
+        f.close();
+    }
+    return 0;
+}
+
+int main()
+{
+    scratch();
+
+    // the main thread's machine, which the others mustn't touch
+    boot();
+    procNS::R[0] = 0123456;
+    ms11::write16(SUM, 0777);
+    dd11::write16(IOPAGE(DEV_KER_INS_PAR_R0), 07700);
+
+    pthread_barrier_init(&all, 0, MACHINES);
+    for (uint16_t k = 0; k < MACHINES; k++)
+    {
+        machine& m = machines[k];
+        m.k = k + 1;
+        snprintf(m.dir, sizeof(m.dir), "%s/m%u", scratchdir, k);
+        CHECK(!mkdir(m.dir, 0700));
+        CHECK(!pthread_create(&m.thread, 0, run, &m));
+    }
+    for (uint16_t k = 0; k < MACHINES; k++)
+        pthread_join(machines[k].thread, 0);
+
+    for (uint16_t k = 0; k < MACHINES; k++)
+    {
+        const machine& m = machines[k];
+        const char out[2] = {(char)('a' + m.k), 0};
+        if (!CHECK(m.sum == (uint16_t)(m.k * LOOPS) && m.r0 == m.k && m.par == 0100 * m.k && m.vec == INTBUS))
+            printf("  machine %u: sum %06o R0 %06o PAR0 %06o trap %03o\n", m.k, m.sum, m.r0, m.par, m.vec);
+        CHECK(m.codes == added[k]);
+        CHECK(m.asking && !m.others);
+        CHECK(!strcmp(m.out, out));
+        CHECK(m.card);
+    }
+
+    // and the main thread's is as it was
+    CHECK(procNS::R[0] == 0123456 && ms11::read16(SUM) == 0777);
+    CHECK(dd11::read16(IOPAGE(DEV_KER_INS_PAR_R0)) == 07700);
+    for (uint8_t i = 0; i < ITABN; i++)
+        CHECK(!itab[i].vec);
+
+    return done("test_machines");
+}
@@ -0,0 +1,80 @@
+// Spin loop detection (spinloop() in cpu_core.cpp.h): a loop polling a device
+// status register is flagged, and looking ahead at one whose operand is in a
+// page the MMU won't map neither traps nor touches SR0 and SR2, as the branch
+// itself doesn't read anything.
+
+#include "cpu.h"
+
+#include "kt11.h"
+
+enum
+{
+    Z = 4
+};
+
+// kernel page 0 mapped to itself, page 1 not mapped at all, and page 7 to the
+// I/O page
+static void mmu(bool on)
+{
+    dd11::write16(IOPAGE(DEV_KER_INS_PAR_R0), 0);
+    dd11::write16(IOPAGE(DEV_KER_INS_PDR_R0), 077406);  // 128 blocks, read and write
+    dd11::write16(IOPAGE(DEV_KER_INS_PAR_R0 + 2), 0200);
+    dd11::write16(IOPAGE(DEV_KER_INS_PDR_R0 + 2), 0);  // not resident
+    dd11::write16(IOPAGE(DEV_KER_INS_PAR_R0 + 14), 0177600);
+    dd11::write16(IOPAGE(DEV_KER_INS_PDR_R0 + 14), 077406);
+    dd11::write16(IOPAGE(DEV_MMU_SR0), on ? 1 : 0);
+}
+
+// with the codes set to cc, take the branch after the test at CODE back to
+// it, and check what spinloop() made of it
+static void loop(const char* name, uint16_t test, uint16_t operand, uint16_t branch, uint16_t r1, uint8_t cc,
+                 bool spin)
+{
+    setcodes(cc);
+    uint16_t pc = CODE;
+    ms11::write16(pc, test);
+    pc += 2;
+    if ((test & 070) == 030 || (test & 070) == 060)  // @#a and X(Rn) take a word
+    {
+        ms11::write16(pc, operand);
+        pc += 2;
+    }
+    ms11::write16(pc, branch);
+
+    procNS::R[1] = r1;
+    procNS::R[7] = pc;
+    procNS::spinning = false;
+    const uint16_t sr0 = kt11::SR0, sr2 = kt11::SR2;
+
+    const uint16_t vec = setjmp(trapbuf);
+    if (!vec)
+        procNS::step();
+
+    if (!CHECK(!vec && procNS::R[7] == CODE && procNS::spinning == spin && kt11::SR0 == sr0 && kt11::SR2 == sr2))
+    {
+        printf("  %s: trap %03o PC %06o spinning %d SR0 %06o SR2 %06o, want PC %06o spinning %d SR0 %06o SR2 %06o\n",
+               name, vec, (uint16_t)procNS::R[7], procNS::spinning, kt11::SR0, kt11::SR2, CODE, spin, sr0, sr2);
+    }
+}
+
+int main()
+{
+    boot();
+
+    for (uint8_t on = 0; on < 2; on++)
+    {
+        mmu(on);
+        loop("TSTB @#177560; BPL", 0105737, 0177560, 0100375, 0, 0, true);
+        loop("TST (R1); BEQ, console", 0005711, 0, 0001776, 0177560, Z, true);
+        loop("TST 4(R1); BEQ, console", 0005761, 4, 0001775, 0177554, Z, true);
+        loop("TST (R1); BEQ, ram", 0005711, 0, 0001776, 02000, Z, false);
+    }
+
+    // operands in page 1, which would abort a read
+    mmu(true);
+    loop("TST (R1); BEQ, unmapped", 0005711, 0, 0001776, 020000, Z, false);
+    loop("TST 2(R1); BEQ, unmapped", 0005761, 2, 0001775, 020000, Z, false);
+    loop("TSTB @#20000; BPL, unmapped", 0105737, 020000, 0100375, 0, 0, false);
+
+    return done("test_spin");
+}
@@ -0,0 +1,189 @@
+/*
+ * A Whetstone style floating point benchmark for UNIX V6 on sam11, in V6 C
+ * with its own maths routines, so it needs no library. Build with cc -f,
+ * which adds the simulator V6 falls back on without an FP11 (USE_FP off),
+ * and run as "a.out loops" (2 by default); it prints each module's result
+ * times 10000. host/v6bench.sh runs it.
+ */
+
+double x1, x2, x3, x4, x, y, z, t, t1, t2;
+double e1[4];
+int j, k, l;
+double sin(), cos(), atan(), sqrt(), exp(), log();
+
+double sqrt(a)
+double a;
+{
+	double r;
+	int n;
+	if (a <= 0.0)
+		return(0.0);
+	r = a;
+	if (r < 1.0)
+		r = 1.0;
+	for (n = 0; n < 30; n++)
+		r = (r + a / r) / 2.0;
+	return(r);
+}
+
+double exp(a)
+double a;
+{
+	double s, u;
+	int n;
+	s = 1.0;
+	u = 1.0;
+	for (n = 1; n < 20; n++) {
+		u = u * a / n;
+		s = s + u;
+	}
+	return(s);
+}
+
+double log(a)
+double a;
+{
+	double s, u, v;
+	int n;
+	u = (a - 1.0) / (a + 1.0);
+	v = u * u;
+	s = 0.0;
+	for (n = 1; n < 40; n = n + 2) {
+		s = s + u / n;
+		u = u * v;
+	}
+	return(s * 2.0);
+}
+
+double sin(a)
+double a;
+{
+	double s, u;
+	int n;
+	s = a;
+	u = a;
+	for (n = 2; n < 20; n = n + 2) {
+		u = -u * a * a / (n * (n + 1));
+		s = s + u;
+	}
+	return(s);
+}
+
+double cos(a)
+double a;
+{
+	return(sin(a + 1.5707963267948966));
+}
+
+double atan(a)
+double a;
+{
+	double s, u, v;
+	int n;
+	if (a > 1.0)
+		return(1.5707963267948966 - atan(1.0 / a));
+	if (a < -1.0)
+		return(-1.5707963267948966 - atan(1.0 / a));
+	u = a / (1.0 + sqrt(1.0 + a * a));
+	v = u * u;
+	s = 0.0;
+	for (n = 1; n < 40; n = n + 2) {
+		s = s + u / n;
+		u = -u * v;
+	}
+	return(s * 2.0);
+}
+
+pa(e)
+double e[];
+{
+	int n;
+	n = 0;
+	while (n < 6) {
+		e[0] = (e[0] + e[1] + e[2] - e[3]) * t;
+		e[1] = (e[0] + e[1] - e[2] + e[3]) * t;
+		e[2] = (e[0] - e[1] + e[2] + e[3]) * t;
+		e[3] = (-e[0] + e[1] + e[2] + e[3]) / t2;
+		n = n + 1;
+	}
+}
+
+p3(a, b)
+double a, b;
+{
+	a = t * (a + b);
+	b = t * (a + b);
+	z = (a + b) / t2;
+}
+
+p0()
+{
+	e1[j] = e1[k];
+	e1[k] = e1[l];
+	e1[l] = e1[j];
+}
+
+pout(s, a)
+double a;
+{
+	int n;
+	n = a * 10000.;
+	printf("%s %d\n", s, n);
+}
+
+main(argc, argv)
+char **argv;
+{
+	int i, loop;
+	t = 0.499975;
+	t1 = 0.50025;
+	t2 = 2.0;
+	loop = 2;
+	if (argc > 1)
+		loop = atoi(argv[1]);
+
+	x1 = 1.0; x2 = -1.0; x3 = -1.0; x4 = -1.0;
+	for (i = 0; i < 12 * loop; i++) {
+		x1 = (x1 + x2 + x3 - x4) * t;
+		x2 = (x1 + x2 - x3 + x4) * t;
+		x3 = (x1 - x2 + x3 + x4) * t;
+		x4 = (-x1 + x2 + x3 + x4) * t;
+	}
+	pout("m1", x1 + x2 + x3 + x4);
+
+	e1[0] = 1.0; e1[1] = -1.0; e1[2] = -1.0; e1[3] = -1.0;
+	for (i = 0; i < 14 * loop; i++) {
+		e1[0] = (e1[0] + e1[1] + e1[2] - e1[3]) * t;
+		e1[1] = (e1[0] + e1[1] - e1[2] + e1[3]) * t;
+		e1[2] = (e1[0] - e1[1] + e1[2] + e1[3]) * t;
+		e1[3] = (-e1[0] + e1[1] + e1[2] + e1[3]) * t;
+	}
+	pout("m2", e1[3]);
+
+	for (i = 0; i < 345 * loop; i++)
+		pa(e1);
+	pout("m3", e1[3]);
+
+	x = 0.5; y = 0.5;
+	for (i = 0; i < 32 * loop; i++) {
+		x = t * atan(t2 * sin(x) * cos(x) / (cos(x + y) + cos(x - y) - 1.0));
+		y = t * atan(t2 * sin(y) * cos(y) / (cos(x + y) + cos(x - y) - 1.0));
+	}
+	pout("m7", x + y);
+
+	x = 1.0; y = 1.0; z = 1.0;
+	for (i = 0; i < 899 * loop; i++)
+		p3(x, y);
+	pout("m8", z);
+
+	j = 1; k = 2; l = 3;
+	e1[0] = 1.0; e1[1] = 2.0; e1[2] = 3.0;
+	for (i = 0; i < 616 * loop; i++)
+		p0();
+	pout("m9", e1[2]);
+
+	x = 0.75;
+	for (i = 0; i < 93 * loop; i++)
+		x = sqrt(exp(log(x) / t1));
+	pout("m11", x);
+}